@@ -0,0 +1,64 @@
+#include <stdio.h>
+#include <string.h>
+#include "analyzer.h"
+#include "file.h"
+#include "reader.h"
+#include "dict.h"
+
+int analyzer_api_version(void) {
+    return ANALYZER_API_VERSION;
+}
+
+int analyzer_open(LogCallback log, void* log_data) {
+    set_log_callback(log, log_data);
+    set_interactive_mode(0);
+    dictionaries_init();
+
+    AnalyzerDictionaries* dicts = dictionaries_acquire();
+    int count = dicts ? dicts->toxic.count : 0;
+    dictionaries_release(dicts);
+    return count;
+}
+
+int analyzer_analyze_buffer(const char* text, size_t len, AnalysisResult* result) {
+    if (text == NULL || result == NULL) return 0;
+
+    AnalysisStream stream;
+    analysis_stream_init(&stream);
+    analysis_stream_feed(&stream, text, len);
+    *result = analysis_stream_finish(&stream);
+    return 1;
+}
+
+int analyzer_analyze_file(const char* filename, AnalysisResult* result) {
+    if (filename == NULL || result == NULL) return 0;
+
+    memset(result, 0, sizeof(AnalysisResult));
+    if (!file_exists(filename)) {
+        log_message(LOG_LEVEL_ERROR, "Error: Cannot open file %s\n", filename);
+        return 0;
+    }
+    *result = analyze_file_streamed(filename);
+    // an empty file is a valid (empty) result, anything else produced text
+    return result->char_count > 0 || is_file_empty(filename);
+}
+
+static void feed_analyzer_chunk(const char* chunk, size_t len, void* data) {
+    analysis_stream_feed((AnalysisStream*)data, chunk, len);
+}
+
+int analyzer_analyze_stream(FILE* stream, AnalysisResult* result) {
+    if (stream == NULL || result == NULL) return 0;
+
+    AnalysisStream analysis;
+    analysis_stream_init(&analysis);
+    long long total = read_file_ahead(stream, feed_analyzer_chunk, &analysis);
+    *result = analysis_stream_finish(&analysis);
+    return total >= 0;
+}
+
+void analyzer_free_result(AnalysisResult* result) {
+    if (result == NULL) return;
+    cleanup_analyzer(result);
+    memset(result, 0, sizeof(AnalysisResult));
+}
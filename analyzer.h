@@ -0,0 +1,39 @@
+#ifndef ANALYZER_H
+#define ANALYZER_H
+
+// libanalyzer: the analysis core without the menu, for programs that embed it.
+// Link with -L. -lanalyzer -pthread (see run.bat). Nothing reads stdin and
+// nothing is printed unless a log callback is given.
+
+#include <stdio.h>
+#include <stddef.h>
+#include "content.h"
+#include "error.h"
+
+// AnalysisResult is the struct from content.h, so the ABI is not stable: a
+// program must be rebuilt against the header of the library it links. The
+// version goes up with every change to AnalysisResult or these functions
+// (2: spilled words, 3: word sketch, 4: detected phrases as dictionary ids,
+// 5: 64-bit word and character counts)
+#define ANALYZER_API_VERSION 5
+
+// ANALYZER_API_VERSION the library was built with, compare it to the one
+// the program was compiled against before using any result
+int analyzer_api_version(void);
+
+// Call once before anything else. log may be NULL for a silent library.
+// Returns the number of toxic phrases loaded, 0 if toxicwords.txt is missing
+int analyzer_open(LogCallback log, void* log_data);
+
+// Each returns 1 and fills result, or 0 on failure. Calls are independent,
+// they can run at the same time on different threads
+int analyzer_analyze_buffer(const char* text, size_t len, AnalysisResult* result);
+int analyzer_analyze_file(const char* filename, AnalysisResult* result);
+int analyzer_analyze_stream(FILE* stream, AnalysisResult* result);
+
+// For data that arrives piece by piece use analysis_stream_init, _feed and
+// _finish from content.h directly
+
+void analyzer_free_result(AnalysisResult* result);
+
+#endif
@@ -0,0 +1,435 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "batch.h"
+#include "content.h"
+#include "file.h"
+#include "cache.h"
+#include "reader.h"
+#include "dict.h"
+#include "tool.h"
+#include "json.h"
+#include "report.h"
+#include "spill.h"
+#include "timeline.h"
+#include "hits.h"
+
+#ifdef _WIN32
+#include <io.h>
+#include <fcntl.h>
+#endif
+
+// shared by the worker threads
+typedef struct {
+    const BatchOptions* options;
+    int next_file;
+    int failed_files;
+    FILE* ndjson;               // results.ndjson, written under the lock
+    pthread_mutex_t lock;
+} BatchQueue;
+
+void print_usage(const char* program) {
+    printf("Usage: %s [options] file...   (use - to read text from stdin)\n", program);
+    printf("       %s --follow [--window N] [--threshold N] file...\n", program);
+    printf("       %s --corpus [-o DIR] [-j N] [--shard-mb N] [--memory-mb N] [--approx] [--all-words] [--min-freq N] file|dir|pattern...\n", program);
+    printf("       %s --serve [--port N | --socket PATH] [-j N]\n", program);
+    printf("       %s --rows [-o FILE] [--column N] [--header | --no-header] file\n", program);
+    printf("       %s --rows-dump FILE [--limit N]\n", program);
+    printf("       %s --hits-query FILE [--phrase P] [--severity S] [--lines A-B] [--limit N]\n", program);
+    printf("       %s compile-dictionary [toxicwords.txt] [%s]\n", program, COMPILED_DICT_FILE);
+    printf("Without arguments the interactive menu is started.\n\n");
+    printf("Options:\n");
+    printf("  -o, --output DIR     directory for reports (default: current)\n");
+    printf("  -f, --format LIST    text, csv, json, ndjson or both (default: both = text,csv)\n");
+    printf("  -j, --threads N      files analyzed in parallel (default: 1)\n");
+    printf("  -n, --top N          top words printed per file (default: %d)\n", BATCH_DEFAULT_TOP);
+    printf("      --incremental    only analyze data appended since the last run\n");
+    printf("      --no-cache       do not read or write the result cache\n");
+    printf("      --all-words      every word in _words.csv, not only the top %d\n", REPORT_TOP_WORDS);
+    printf("      --min-freq N     leave words seen fewer than N times out of _words.csv\n");
+    printf("      --memory-mb N    spill word counts to temporary files past N MB per file\n");
+    printf("      --approx         approximate word counts in fixed memory (Count-Min Sketch)\n");
+    printf("      --approx-error E overcount at most E of all words (default: %g)\n", SKETCH_DEFAULT_ERROR);
+    printf("      --approx-delta D chance a count is further off (default: %g)\n", SKETCH_DEFAULT_DELTA);
+    printf("      --approx-k K     most frequent words tracked (default: %d)\n", SKETCH_DEFAULT_K);
+    printf("      --timeline N     toxicity per N lines in _timeline.csv\n");
+    printf("      --timeline-words N  the same per window of about N words\n");
+    printf("      --threshold N    timeline windows scoring N are hot spots (default: %d)\n", TIMELINE_DEFAULT_THRESHOLD);
+    printf("      --hits           every toxic phrase match with its offset in _hits.thit\n");
+    printf("      --timing         time spent reading and analyzing each file\n");
+    printf("  -h, --help           show this help\n");
+    printf("\nExit status: 0 ok, 1 usage error, 2 some files failed\n");
+}
+
+static int parse_formats(const char* list) {
+    int formats = 0;
+    int count = 0;
+    char** names = split_string(list, ",", &count);
+
+    for (int i = 0; i < count; i++) {
+        if (strcmp(names[i], "text") == 0 || strcmp(names[i], "txt") == 0) {
+            formats |= REPORT_TEXT;
+        } else if (strcmp(names[i], "csv") == 0) {
+            formats |= REPORT_CSV;
+        } else if (strcmp(names[i], "json") == 0) {
+            formats |= REPORT_JSON;
+        } else if (strcmp(names[i], "ndjson") == 0) {
+            formats |= REPORT_NDJSON;
+        } else if (strcmp(names[i], "both") == 0) {
+            formats |= REPORT_TEXT | REPORT_CSV;
+        } else {
+            printf("Error: Unknown format '%s'\n", names[i]);
+            formats = -1;
+            break;
+        }
+    }
+    free_split_string(names, count);
+    return formats;
+}
+
+// Returns 1 if the options are usable, 0 on a usage error
+int parse_batch_options(int argc, char** argv, BatchOptions* options) {
+    memset(options, 0, sizeof(BatchOptions));
+    options->output_dir = ".";
+    options->formats = REPORT_TEXT | REPORT_CSV;
+    options->threads = 1;
+    options->top_n = BATCH_DEFAULT_TOP;
+    options->use_cache = 1;
+    options->min_frequency = 1;
+    options->approx = (SketchOptions)SKETCH_OPTIONS_OFF;
+    options->hot_threshold = TIMELINE_DEFAULT_THRESHOLD;
+    options->files = malloc(argc * sizeof(char*));
+    if (options->files == NULL) {
+        return 0;
+    }
+
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        int has_value = (i + 1 < argc);
+
+        if ((strcmp(arg, "-o") == 0 || strcmp(arg, "--output") == 0) && has_value) {
+            options->output_dir = argv[++i];
+        } else if ((strcmp(arg, "-f") == 0 || strcmp(arg, "--format") == 0) && has_value) {
+            options->formats = parse_formats(argv[++i]);
+            if (options->formats <= 0) return 0;
+        } else if ((strcmp(arg, "-j") == 0 || strcmp(arg, "--threads") == 0) && has_value) {
+            options->threads = atoi(argv[++i]);
+            if (options->threads < 1) options->threads = 1;
+            if (options->threads > BATCH_MAX_THREADS) options->threads = BATCH_MAX_THREADS;
+        } else if ((strcmp(arg, "-n") == 0 || strcmp(arg, "--top") == 0) && has_value) {
+            options->top_n = atoi(argv[++i]);
+        } else if (strcmp(arg, "--incremental") == 0) {
+            options->incremental = 1;
+        } else if (strcmp(arg, "--no-cache") == 0) {
+            options->use_cache = 0;
+        } else if (strcmp(arg, "--all-words") == 0) {
+            options->all_words = 1;
+        } else if (strcmp(arg, "--min-freq") == 0 && has_value) {
+            options->min_frequency = atoi(argv[++i]);
+        } else if (strcmp(arg, "--memory-mb") == 0 && has_value) {
+            options->memory_mb = atoi(argv[++i]);
+        } else if (strcmp(arg, "--approx") == 0) {
+            options->approx.enabled = 1;
+        } else if (strcmp(arg, "--approx-error") == 0 && has_value) {
+            options->approx.enabled = 1;
+            options->approx.error = atof(argv[++i]);
+        } else if (strcmp(arg, "--approx-delta") == 0 && has_value) {
+            options->approx.enabled = 1;
+            options->approx.delta = atof(argv[++i]);
+        } else if (strcmp(arg, "--approx-k") == 0 && has_value) {
+            options->approx.enabled = 1;
+            options->approx.k = atoi(argv[++i]);
+        } else if (strcmp(arg, "--timeline") == 0 && has_value) {
+            options->timeline_size = atoi(argv[++i]);
+            options->timeline_unit = TIMELINE_LINES;
+        } else if (strcmp(arg, "--timeline-words") == 0 && has_value) {
+            options->timeline_size = atoi(argv[++i]);
+            options->timeline_unit = TIMELINE_WORDS;
+        } else if (strcmp(arg, "--threshold") == 0 && has_value) {
+            options->hot_threshold = atoi(argv[++i]);
+        } else if (strcmp(arg, "--hits") == 0) {
+            options->hit_index = 1;
+        } else if (strcmp(arg, "--timing") == 0) {
+            options->timing = 1;
+        } else if (arg[0] == '-' && arg[1] != '\0') {
+            printf("Error: Unknown or incomplete option '%s'\n", arg);
+            return 0;
+        } else if (strcmp(arg, "-") == 0 && options->reads_stdin) {
+            printf("Error: stdin can only be given once\n");
+            return 0;
+        } else {
+            options->reads_stdin |= (strcmp(arg, "-") == 0);
+            options->files[options->file_count++] = arg;
+        }
+    }
+
+    if (options->file_count == 0) {
+        printf("Error: No input files given\n");
+        return 0;
+    }
+    return 1;
+}
+
+void free_batch_options(BatchOptions* options) {
+    free(options->files);
+    options->files = NULL;
+}
+
+// "dir/name.txt" -> "out/name"
+static void make_report_base(const char* output_dir, const char* filename, char* base, int size) {
+    const char* name = filename;
+    for (const char* p = filename; *p; p++) {
+        if (*p == '/' || *p == '\\') name = p + 1;
+    }
+
+    char stem[200];
+    strncpy(stem, name, sizeof(stem) - 1);
+    stem[sizeof(stem) - 1] = '\0';
+    char* dot = strrchr(stem, '.');
+    if (dot != NULL && dot != stem) *dot = '\0';
+
+    snprintf(base, size, "%s/%s", output_dir, stem);
+}
+
+// every requested format rendered at once from one snapshot
+static void save_batch_reports(const BatchOptions* options, const char* base, AnalysisResult* result) {
+    ReportSnapshot snapshot;
+    ReportJob jobs[REPORT_MAX_JOBS];
+    int count = 0;
+
+    if (options->formats & REPORT_TEXT) {
+        add_report_job(jobs, &count, REPORT_FILE_ANALYSIS_TXT, base);
+        add_report_job(jobs, &count, REPORT_FILE_TOXICITY_TXT, base);
+    }
+    if (options->formats & REPORT_CSV) {
+        add_report_job(jobs, &count, REPORT_FILE_ANALYSIS_CSV, base);
+        add_report_job(jobs, &count, REPORT_FILE_WORDS_CSV, base);
+        if (result->toxic_phrase_count > 0) {
+            add_report_job(jobs, &count, REPORT_FILE_TOXICITY_CSV, base);
+        }
+    }
+    if (options->formats & REPORT_JSON) {
+        add_report_job(jobs, &count, REPORT_FILE_ANALYSIS_JSON, base);
+    }
+    if (count == 0) return;
+    report_snapshot_init(&snapshot, result, base);
+    if (options->all_words) snapshot.word_limit = 0;
+    snapshot.min_frequency = options->min_frequency;
+    write_reports(&snapshot, jobs, count);
+}
+
+static void feed_stdin_chunk(const char* chunk, size_t len, void* data) {
+    analysis_stream_feed((AnalysisStream*)data, chunk, len);
+}
+
+// Analyze stdin chunk by chunk as it arrives, a pipe has no size to probe
+static AnalysisResult analyze_standard_input(AnalysisStream* stream) {
+#ifdef _WIN32
+    // the piped bytes as sent, no CRLF translation or stop at Ctrl+Z
+    _setmode(_fileno(stdin), _O_BINARY);
+#endif
+    char* buffer = (char*)malloc(STDIN_CHUNK_SIZE);
+    if (buffer != NULL) {
+        read_file_chunks(stdin, buffer, STDIN_CHUNK_SIZE, feed_stdin_chunk, stream);
+        free(buffer);
+    }
+    return analysis_stream_finish(stream);
+}
+
+// Analyze and save one file, returns 1 on success. record is the worker's
+// reusable buffer for its results.ndjson line
+static int process_batch_file(BatchQueue* queue, JsonWriter* record, const char* filename) {
+    const BatchOptions* options = queue->options;
+    pthread_mutex_t* lock = &queue->lock;
+    int from_stdin = (strcmp(filename, "-") == 0);
+    if (!from_stdin && (!file_exists(filename) || is_file_empty(filename))) {
+        printf("  Warning: %s is missing or empty, skipping\n", filename);
+        return 0;
+    }
+
+    // the timeline and the hit index need every line, so they always take a full pass
+    Timeline timeline;
+    HitList hits;
+    Timeline* windows = NULL;
+    HitList* hit_list = NULL;
+    if (options->timeline_size > 0) {
+        timeline_init(&timeline, (TimelineUnit)options->timeline_unit, options->timeline_size);
+        windows = &timeline;
+    }
+    if (options->hit_index) {
+        hit_list_init(&hits);
+        hit_list = &hits;
+    }
+
+    AnalysisResult result;
+    const char* extension = get_file_extension(filename);
+    if (from_stdin || windows != NULL || hit_list != NULL) {
+        AnalysisStream stream;
+        analysis_stream_init(&stream);
+        if (windows != NULL) timeline_attach(windows, &stream);
+        if (hit_list != NULL) hit_list_attach(hit_list, &stream);
+        if (from_stdin) {
+            filename = "stdin";
+            result = analyze_standard_input(&stream);
+        } else {
+            result = analyze_file_into_stream(filename, &stream);
+        }
+    } else if (options->incremental && strcmp(extension, ".csv") != 0 && !is_compressed_file(filename)) {
+        result = analyze_file_incremental(filename, NULL);
+    } else if (options->use_cache) {
+        result = analyze_file_cached(filename, NULL);
+    } else {
+        result = analyze_file_streamed(filename);
+    }
+
+    if (result.char_count == 0) {
+        printf("  Warning: Failed to analyze %s\n", filename);
+        cleanup_analyzer(&result);
+        if (windows != NULL) timeline_free(windows);
+        if (hit_list != NULL) hit_list_free(hit_list);
+        return 0;
+    }
+
+    char base[256];
+    make_report_base(options->output_dir, filename, base, sizeof(base));
+    save_batch_reports(options, base, &result);
+    if (windows != NULL) {
+        char path[300];
+        timeline_finish(windows);
+        snprintf(path, sizeof(path), "%s_timeline.csv", base);
+        save_timeline_csv(path, windows, options->hot_threshold);
+    }
+    if (hit_list != NULL) {
+        char path[300];
+        snprintf(path, sizeof(path), "%s_hits.thit", base);
+        save_hit_index(path, hit_list);
+    }
+
+    // formatted outside the lock, only the write is serialized
+    if (queue->ndjson != NULL) {
+        json_writer_reset(record);
+        json_write_result(record, filename, &result, options->top_n);
+        json_end_record(record);
+    }
+
+    // one summary block per file, kept together under the lock
+    int score = calculate_toxicity_score(&result);
+    pthread_mutex_lock(lock);
+    if (queue->ndjson != NULL && !record->failed) {
+        fwrite(record->data, 1, record->len, queue->ndjson);
+    }
+    printf("RESULT %s words=%lld unique=%d sentences=%d toxic_phrases=%d score=%d level=%s\n",
+           filename, result.word_count, result.unique_words, result.sentence_count,
+           result.toxic_phrase_count, score, get_toxicity_level(score));
+    if (options->top_n > 0 && result.ranked_words > 0) {
+        int top_n = (options->top_n < result.ranked_words) ? options->top_n : result.ranked_words;
+        printf("TOP %s", filename);
+        for (int i = 0; i < top_n; i++) {
+            printf(" %s(%d)", result.word_freq[i]->word, result.word_freq[i]->frequency);
+        }
+        printf("\n");
+    }
+    if (windows != NULL && windows->peak >= 0) {
+        const TimelineWindow* peak = &windows->windows[windows->peak];
+        int hot = 0;
+        for (int i = 0; i < windows->count; i++) {
+            if (timeline_window_score(&windows->windows[i]) >= options->hot_threshold) hot++;
+        }
+        printf("PEAK %s lines=%lld-%lld score=%d hot_windows=%d/%d\n", filename, peak->first_line,
+               peak->first_line + peak->lines - 1, windows->peak_score, hot, windows->count);
+    }
+    fflush(stdout);
+    pthread_mutex_unlock(lock);
+
+    cleanup_analyzer(&result);
+    if (windows != NULL) timeline_free(windows);
+    if (hit_list != NULL) hit_list_free(hit_list);
+    return 1;
+}
+
+static void* batch_worker(void* arg) {
+    BatchQueue* queue = (BatchQueue*)arg;
+    JsonWriter record;
+    json_writer_init(&record, NULL);
+
+    while (1) {
+        pthread_mutex_lock(&queue->lock);
+        int index = queue->next_file++;
+        pthread_mutex_unlock(&queue->lock);
+        if (index >= queue->options->file_count) break;
+        dictionaries_reload_if_changed();
+
+        if (!process_batch_file(queue, &record, queue->options->files[index])) {
+            pthread_mutex_lock(&queue->lock);
+            queue->failed_files++;
+            pthread_mutex_unlock(&queue->lock);
+        }
+    }
+    json_writer_free(&record);
+    return NULL;
+}
+
+// Analyze every file and save its reports without any prompt
+int run_batch(const BatchOptions* options) {
+    double start = (options->start_ms > 0) ? options->start_ms : get_time_ms();
+    set_word_memory_limit((long long)options->memory_mb * 1024 * 1024);
+    set_sketch_options(&options->approx);
+    set_reader_timing(options->timing);
+
+    if (!make_directory(options->output_dir)) {
+        printf("Error: Cannot create output directory %s\n", options->output_dir);
+        return BATCH_USAGE_ERROR;
+    }
+
+    BatchQueue queue;
+    queue.options = options;
+    queue.next_file = 0;
+    queue.failed_files = 0;
+    queue.ndjson = NULL;
+    pthread_mutex_init(&queue.lock, NULL);
+
+    char ndjson_path[300];
+    if (options->formats & REPORT_NDJSON) {
+        snprintf(ndjson_path, sizeof(ndjson_path), "%s/results.ndjson", options->output_dir);
+        queue.ndjson = fopen(ndjson_path, "wb");
+        if (queue.ndjson == NULL) {
+            printf("Error: Cannot create %s\n", ndjson_path);
+            pthread_mutex_destroy(&queue.lock);
+            return BATCH_USAGE_ERROR;
+        }
+        setvbuf(queue.ndjson, NULL, _IOFBF, JSON_BUFFER_SIZE);
+    }
+
+    int thread_count = (options->threads < options->file_count) ? options->threads : options->file_count;
+    if (thread_count <= 1) {
+        batch_worker(&queue);
+    } else {
+        pthread_t threads[BATCH_MAX_THREADS];
+        int started[BATCH_MAX_THREADS];
+        for (int i = 0; i < thread_count; i++) {
+            started[i] = (pthread_create(&threads[i], NULL, batch_worker, &queue) == 0);
+        }
+        // files left by threads that did not start are analyzed here
+        for (int i = 0; i < thread_count; i++) {
+            if (started[i]) {
+                pthread_join(threads[i], NULL);
+            } else {
+                batch_worker(&queue);
+            }
+        }
+    }
+    pthread_mutex_destroy(&queue.lock);
+    if (queue.ndjson != NULL) {
+        fclose(queue.ndjson);
+        printf("Results saved to: %s\n", ndjson_path);
+    }
+
+    if (options->use_cache) {
+        cache_flush();
+    }
+
+    int succeeded = options->file_count - queue.failed_files;
+    printf("DONE %d/%d files in %.1f ms\n", succeeded, options->file_count, get_time_ms() - start);
+    return (queue.failed_files > 0) ? BATCH_FILES_FAILED : BATCH_OK;
+}
@@ -0,0 +1,49 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include "sketch.h"
+
+// report formats, can be combined
+#define REPORT_TEXT 1
+#define REPORT_CSV 2
+#define REPORT_JSON 4       // <name>_analysis.json per file
+#define REPORT_NDJSON 8     // one line per file in results.ndjson
+
+#define BATCH_DEFAULT_TOP 10
+#define BATCH_MAX_THREADS 64
+#define STDIN_CHUNK_SIZE 65536
+
+// command line options for a non-interactive run
+typedef struct {
+    const char** files;
+    int file_count;
+    const char* output_dir;
+    int formats;
+    int threads;
+    int top_n;
+    int use_cache;
+    int incremental;
+    int all_words;          // whole vocabulary in _words.csv, not just the top 100
+    int min_frequency;      // leave rarer words out of _words.csv
+    int memory_mb;          // word table budget per file, 0 for no limit
+    SketchOptions approx;   // approximate word counts in fixed memory
+    int timeline_size;      // lines or words per timeline window, 0 for no timeline
+    int timeline_unit;      // TimelineUnit
+    int hot_threshold;      // timeline windows scoring this much are hot spots
+    int hit_index;          // every phrase match in _hits.thit
+    int timing;             // print read and analysis time of each read-ahead
+    int reads_stdin;        // "-" was given as a file
+    double start_ms;        // process start, for startup-to-result timing
+} BatchOptions;
+
+// exit codes
+#define BATCH_OK 0
+#define BATCH_USAGE_ERROR 1
+#define BATCH_FILES_FAILED 2
+
+void print_usage(const char* program);
+int parse_batch_options(int argc, char** argv, BatchOptions* options);
+int run_batch(const BatchOptions* options);
+void free_batch_options(BatchOptions* options);
+
+#endif
@@ -0,0 +1,774 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "cache.h"
+#include "content.h"
+#include "file.h"
+#include "tool.h"
+#include "error.h"
+#include "reader.h"
+#include "dict.h"
+#include "spill.h"
+#include "sketch.h"
+
+#define FNV_OFFSET 14695981039346656037ULL
+#define FNV_PRIME 1099511628211ULL
+
+// one line of the index file
+typedef struct {
+    char key[CACHE_KEY_LEN];
+    long size;
+    long last_used;
+} CacheEntry;
+
+static CacheEntry* cache_entries = NULL;
+static int cache_entry_count = 0;
+static int cache_entry_capacity = 0;
+static long cache_total_bytes = 0;
+static long cache_clock = 0;
+static int cache_loaded = 0;
+static int cache_dirty = 0;
+static long cache_temp_counter = 0;
+
+// batch workers share the index
+static pthread_mutex_t cache_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// FNV-1a over a block of bytes
+static unsigned long long fnv1a_update(unsigned long long hash, const unsigned char* data, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        hash ^= data[i];
+        hash *= FNV_PRIME;
+    }
+    return hash;
+}
+
+// Hash the raw bytes of a file
+int hash_file_content(const char* filename, unsigned long long* hash) {
+    FILE* file = fopen(filename, "rb");
+    if (file == NULL) {
+        return 0;
+    }
+
+    unsigned char buffer[65536];
+    unsigned long long h = FNV_OFFSET;
+    size_t bytes_read;
+    while ((bytes_read = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+        h = fnv1a_update(h, buffer, bytes_read);
+    }
+    fclose(file);
+
+    *hash = h;
+    return 1;
+}
+
+// Results depend on the dictionaries too, so they are part of every key.
+// A reload publishes a set with a new hash, old entries are simply not hit
+static unsigned long long get_dictionary_hash(void) {
+    AnalyzerDictionaries* dicts = dictionaries_acquire();
+    unsigned long long hash = dicts ? dicts->hash : 0;
+    dictionaries_release(dicts);
+    return hash;
+}
+
+int cache_make_key(const char* filename, char* key) {
+    unsigned long long content;
+    if (!hash_file_content(filename, &content)) {
+        return 0;
+    }
+
+    // CSV and TXT files are loaded differently, keep them apart
+    const char* extension = get_file_extension(filename);
+    content = fnv1a_update(content, (const unsigned char*)extension, strlen(extension));
+
+    snprintf(key, CACHE_KEY_LEN, "%016llx%016llx", content, get_dictionary_hash());
+    return 1;
+}
+
+//  INDEX MANAGEMENT
+
+static void cache_entry_path(const char* key, char* path, size_t size) {
+    snprintf(path, size, "%s/%s.res", CACHE_DIR, key);
+}
+
+static void add_entry(const char* key, long size, long last_used) {
+    if (cache_entry_count >= cache_entry_capacity) {
+        int new_capacity = (cache_entry_capacity == 0) ? 64 : cache_entry_capacity * 2;
+        CacheEntry* grown = realloc(cache_entries, new_capacity * sizeof(CacheEntry));
+        if (grown == NULL) {
+            log_message(LOG_LEVEL_WARNING, " Warning: Cache index allocation failed\n");
+            return;
+        }
+        cache_entries = grown;
+        cache_entry_capacity = new_capacity;
+    }
+
+    CacheEntry* entry = &cache_entries[cache_entry_count++];
+    strncpy(entry->key, key, CACHE_KEY_LEN - 1);
+    entry->key[CACHE_KEY_LEN - 1] = '\0';
+    entry->size = size;
+    entry->last_used = last_used;
+    cache_total_bytes += size;
+    if (last_used > cache_clock) {
+        cache_clock = last_used;
+    }
+}
+
+static int find_entry(const char* key) {
+    for (int i = 0; i < cache_entry_count; i++) {
+        if (strcmp(cache_entries[i].key, key) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static void remove_entry(int index) {
+    char path[256];
+    cache_entry_path(cache_entries[index].key, path, sizeof(path));
+    remove(path);
+
+    cache_total_bytes -= cache_entries[index].size;
+    cache_entries[index] = cache_entries[--cache_entry_count];
+    cache_dirty = 1;
+}
+
+static void load_index(void) {
+    if (cache_loaded) return;
+    cache_loaded = 1;
+
+    char path[256];
+    snprintf(path, sizeof(path), "%s/index.txt", CACHE_DIR);
+    FILE* file = fopen(path, "r");
+    if (file == NULL) {
+        return;
+    }
+
+    char key[CACHE_KEY_LEN];
+    long size, last_used;
+    while (fscanf(file, "%32s %ld %ld", key, &size, &last_used) == 3) {
+        add_entry(key, size, last_used);
+    }
+    fclose(file);
+}
+
+// Write the index back if anything changed
+void cache_flush(void) {
+    pthread_mutex_lock(&cache_lock);
+    if (!cache_dirty) {
+        pthread_mutex_unlock(&cache_lock);
+        return;
+    }
+
+    char path[256];
+    snprintf(path, sizeof(path), "%s/index.txt", CACHE_DIR);
+    FILE* file = fopen(path, "w");
+    if (file == NULL) {
+        log_message(LOG_LEVEL_WARNING, " Warning: Cannot write cache index %s\n", path);
+        pthread_mutex_unlock(&cache_lock);
+        return;
+    }
+
+    for (int i = 0; i < cache_entry_count; i++) {
+        fprintf(file, "%s %ld %ld\n", cache_entries[i].key, cache_entries[i].size, cache_entries[i].last_used);
+    }
+    fclose(file);
+    cache_dirty = 0;
+    pthread_mutex_unlock(&cache_lock);
+}
+
+// Drop an entry whose file turned out to be missing or stale
+static void forget_entry(const char* key) {
+    pthread_mutex_lock(&cache_lock);
+    int index = find_entry(key);
+    if (index >= 0) {
+        remove_entry(index);
+    }
+    pthread_mutex_unlock(&cache_lock);
+}
+
+// Drop least recently used results until the cache fits its budget
+static void evict_entries(void) {
+    while (cache_total_bytes > CACHE_MAX_BYTES && cache_entry_count > 0) {
+        int oldest = 0;
+        for (int i = 1; i < cache_entry_count; i++) {
+            if (cache_entries[i].last_used < cache_entries[oldest].last_used) {
+                oldest = i;
+            }
+        }
+        remove_entry(oldest);
+    }
+}
+
+//  RESULT SERIALIZATION
+
+int cache_load_result(const char* key, AnalysisResult* result) {
+    pthread_mutex_lock(&cache_lock);
+    load_index();
+    int index = find_entry(key);
+    pthread_mutex_unlock(&cache_lock);
+    if (index < 0) {
+        return 0;
+    }
+
+    // the file is parsed without the lock, entries are only replaced by rename
+    char path[256];
+    cache_entry_path(key, path, sizeof(path));
+    FILE* file = fopen(path, "r");
+    if (file == NULL) {
+        forget_entry(key);
+        return 0;
+    }
+
+    char line[256];
+    int version = 0;
+    if (fgets(line, sizeof(line), file) == NULL ||
+        sscanf(line, "ANALYZER_CACHE %d", &version) != 1 || version != CACHE_FORMAT_VERSION) {
+        fclose(file);
+        forget_entry(key);
+        return 0;
+    }
+
+    memset(result, 0, sizeof(AnalysisResult));
+    result->hash_table = hash_table_create();
+    if (result->hash_table == NULL) {
+        fclose(file);
+        return 0;
+    }
+    AdvancedStats* stats = &result->advanced_stats;
+
+    while (fgets(line, sizeof(line), file)) {
+        line[strcspn(line, "\n")] = '\0';
+        int a, b, offset = 0;
+        char word[MAX_WORD_LEN];
+
+        if (strncmp(line, "word ", 5) == 0) {
+            if (sscanf(line + 5, "%d %49s", &a, word) == 2) {
+                hash_table_add(result->hash_table, word, a);
+            }
+        } else if (strncmp(line, "phrase ", 7) == 0) {
+            // stored as text, the ids are only valid for the dictionary loaded now
+            if (sscanf(line + 7, "%d %d %n", &a, &b, &offset) == 2) {
+                add_detected_phrase(result, line + 7 + offset, b);
+            }
+        } else if (strncmp(line, "counts ", 7) == 0) {
+            sscanf(line + 7, "%lld %lld %d %d %d", &result->word_count, &result->char_count,
+                   &result->line_count, &result->sentence_count, &result->toxic_word_count);
+        } else if (strncmp(line, "stats ", 6) == 0) {
+            sscanf(line + 6, "%d %d %d %d %d", &stats->total_sentences, &stats->total_paragraphs,
+                   &stats->longest_sentence, &stats->shortest_sentence, &stats->sentence_words);
+        } else if (strncmp(line, "severity ", 9) == 0) {
+            sscanf(line + 9, "%d %d %d", &result->severity_counts[SEVERITY_MILD],
+                   &result->severity_counts[SEVERITY_MODERATE], &result->severity_counts[SEVERITY_SEVERE]);
+        }
+    }
+    fclose(file);
+
+    finalize_analysis_result(result);
+
+    pthread_mutex_lock(&cache_lock);
+    index = find_entry(key);
+    if (index >= 0) {
+        cache_entries[index].last_used = ++cache_clock;
+        cache_dirty = 1;
+    }
+    pthread_mutex_unlock(&cache_lock);
+    return 1;
+}
+
+void cache_store_result(const char* key, const AnalysisResult* result) {
+    // a spilled vocabulary is not in memory and sketch counts are estimates,
+    // only complete results are cached
+    if (result->ranked_words < result->unique_words || result->sketch != NULL) {
+        return;
+    }
+    pthread_mutex_lock(&cache_lock);
+    load_index();
+    int exists = find_entry(key) >= 0;
+    long temp_id = ++cache_temp_counter;
+    pthread_mutex_unlock(&cache_lock);
+    if (exists) {
+        return;
+    }
+    make_directory(CACHE_DIR);
+
+    // write under a temporary name so readers never see a half-written file
+    char path[256], temp_path[300];
+    cache_entry_path(key, path, sizeof(path));
+    snprintf(temp_path, sizeof(temp_path), "%s.%ld.tmp", path, temp_id);
+    FILE* file = fopen(temp_path, "w");
+    if (file == NULL) {
+        log_message(LOG_LEVEL_WARNING, " Warning: Cannot write cache file %s\n", path);
+        return;
+    }
+
+    const AdvancedStats* stats = &result->advanced_stats;
+    fprintf(file, "ANALYZER_CACHE %d\n", CACHE_FORMAT_VERSION);
+    fprintf(file, "counts %lld %lld %d %d %d\n", result->word_count, result->char_count,
+            result->line_count, result->sentence_count, result->toxic_word_count);
+    fprintf(file, "stats %d %d %d %d %d\n", stats->total_sentences, stats->total_paragraphs,
+            stats->longest_sentence, stats->shortest_sentence, stats->sentence_words);
+    fprintf(file, "severity %d %d %d\n", result->severity_counts[SEVERITY_MILD],
+            result->severity_counts[SEVERITY_MODERATE], result->severity_counts[SEVERITY_SEVERE]);
+    for (int i = 0; i < result->toxic_phrase_count; i++) {
+        fprintf(file, "phrase %d %d %s\n", detected_phrase_severity(result, i),
+                result->detected_phrases[i].count, detected_phrase_text(result, i));
+    }
+    for (int i = 0; i < result->ranked_words; i++) {
+        fprintf(file, "word %d %s\n", result->word_freq[i]->frequency, result->word_freq[i]->word);
+    }
+
+    long size = ftell(file);
+    fclose(file);
+
+    pthread_mutex_lock(&cache_lock);
+    if (find_entry(key) >= 0) {
+        remove(temp_path);  // another worker stored the same content
+    } else {
+        remove(path);
+        if (rename(temp_path, path) == 0) {
+            add_entry(key, size, ++cache_clock);
+            cache_dirty = 1;
+            evict_entries();
+        } else {
+            remove(temp_path);
+        }
+    }
+    pthread_mutex_unlock(&cache_lock);
+}
+
+//  CACHED ANALYSIS
+
+AnalysisResult analyze_file_cached(const char* filename, int* from_cache) {
+    AnalysisResult result = {0};
+    char key[CACHE_KEY_LEN];
+    int have_key = cache_make_key(filename, key);
+
+    if (from_cache) *from_cache = 0;
+    if (have_key && cache_load_result(key, &result)) {
+        if (from_cache) *from_cache = 1;
+        return result;
+    }
+
+    result = analyze_file_streamed(filename);
+
+    // skip storing if the dictionaries were reloaded meanwhile, the key
+    // ends with the dictionary hash
+    char dictionary_now[17];
+    snprintf(dictionary_now, sizeof(dictionary_now), "%016llx", get_dictionary_hash());
+    if (have_key && result.char_count > 0 && strcmp(key + 16, dictionary_now) == 0) {
+        cache_store_result(key, &result);
+    }
+    return result;
+}
+
+// Analyze a batch file by file and merge, unchanged files come from the cache
+int analyze_files_cached(const char** filenames, int file_count, AnalysisResult* merged) {
+    memset(merged, 0, sizeof(AnalysisResult));
+    merged->hash_table = hash_table_create();
+
+    int successful_files = 0;
+    int cached_files = 0;
+
+    log_message(LOG_LEVEL_INFO, "Processing %d files...\n", file_count);
+
+    for (int i = 0; i < file_count; i++) {
+        const char* filename = filenames[i];
+        log_message(LOG_LEVEL_INFO, "\nFile %d/%d: %s\n", i + 1, file_count, filename);
+
+        if (!file_exists(filename)) {
+            log_message(LOG_LEVEL_WARNING, "  Warning: File does not exist, skipping\n");
+            continue;
+        }
+        if (is_file_empty(filename)) {
+            log_message(LOG_LEVEL_WARNING, "  Warning: File is empty, skipping\n");
+            continue;
+        }
+        const char* extension = get_file_extension(filename);
+        if (strcmp(extension, ".csv") != 0 && strcmp(extension, ".txt") != 0 && !is_compressed_file(filename)) {
+            log_message(LOG_LEVEL_WARNING, "  Warning: Unsupported file type '%s', skipping\n", extension);
+            continue;
+        }
+        log_message(LOG_LEVEL_INFO, "  Size: %ld bytes\n", get_file_size(filename));
+
+        int from_cache = 0;
+        AnalysisResult part = analyze_file_cached(filename, &from_cache);
+        if (part.char_count == 0) {
+            log_message(LOG_LEVEL_ERROR, "   Failed to process file\n");
+            cleanup_analyzer(&part);
+            continue;
+        }
+
+        merge_analysis_results(merged, &part);
+        cleanup_analyzer(&part);
+        successful_files++;
+        if (from_cache) {
+            cached_files++;
+            log_message(LOG_LEVEL_INFO, "   Unchanged, using cached result\n");
+        } else {
+            log_message(LOG_LEVEL_INFO, "   Processed successfully\n");
+        }
+    }
+
+    cache_flush();
+    finalize_analysis_result(merged);
+
+    log_message(LOG_LEVEL_INFO, "\nProcessing completed: %d/%d files successful (%d from cache)\n",
+                successful_files, file_count, cached_files);
+    return successful_files;
+}
+
+//  INCREMENTAL ANALYSIS
+
+static void word_log_path(const char* state_file, int generation, char* path, size_t size) {
+    snprintf(path, size, "%s.%d.words", state_file, generation);
+}
+
+typedef struct {
+    FILE* file;
+    long long bytes;
+    long long records;
+} WordLogWriter;
+
+static void write_log_word(const char* word, int frequency, void* data) {
+    WordLogWriter* writer = (WordLogWriter*)data;
+    int len = fprintf(writer->file, "word %d %s\n", frequency, word);
+    if (len > 0) writer->bytes += len;
+    writer->records++;
+}
+
+// Write the words of result into the log from byte offset on, a new file
+// when offset is 0. Returns the records written, -1 on a write error
+static long long write_word_log(const char* path, long long offset, const AnalysisResult* result, long long* bytes) {
+    FILE* file = fopen(path, (offset > 0) ? "r+b" : "wb");
+    if (file == NULL) {
+        return -1;
+    }
+    WordLogWriter writer = {file, offset, 0};
+    int ok = seek_file(file, offset) == 0;
+    for (int i = 0; ok && result->hash_table != NULL && i < HASH_TABLE_SIZE; i++) {
+        for (WordNode* node = result->hash_table->table[i]; node != NULL; node = node->next) {
+            write_log_word(node->word, node->frequency, &writer);
+        }
+    }
+    if (ok && result->spill != NULL) {
+        // spilled words too, a word in both places is added up on load
+        ok = word_spill_each(result->spill, write_log_word, &writer) >= 0;
+    }
+    ok = !ferror(file) && ok;
+    ok = (fclose(file) == 0) && ok;
+    *bytes = writer.bytes;
+    return ok ? writer.records : -1;
+}
+
+// Add the first log->records records of the word log to result. Returns 0
+// when the log is missing or shorter than the state says
+static int merge_word_log(const char* state_file, const WordLog* log, AnalysisResult* result) {
+    if (log->records == 0) {
+        return 1;
+    }
+    char path[300];
+    word_log_path(state_file, log->generation, path, sizeof(path));
+    FILE* file = fopen(path, "rb");
+    if (file == NULL || result->hash_table == NULL) {
+        if (file) fclose(file);
+        return 0;
+    }
+
+    char line[256];
+    long long records = 0;
+    while (records < log->records && fgets(line, sizeof(line), file)) {
+        int frequency;
+        char word[MAX_WORD_LEN];
+        if (sscanf(line, "word %d %49s", &frequency, word) != 2) break;
+        hash_table_add(result->hash_table, word, frequency);
+        if (result->spill != NULL && result->hash_table->size >= result->spill->max_words) {
+            word_spill_flush(result->spill, result->hash_table);
+        }
+        records++;
+    }
+    fclose(file);
+    return records == log->records;
+}
+
+// The state goes to a temporary file first, a crash leaves the old one whole
+static int write_state_file(const char* state_file, const AnalysisStream* stream, unsigned long long tail_hash,
+                            const WordLog* log) {
+    char temp_path[300];
+    snprintf(temp_path, sizeof(temp_path), "%s.tmp", state_file);
+    FILE* file = fopen(temp_path, "wb");
+    if (file == NULL) {
+        return 0;
+    }
+
+    const AnalysisResult* result = &stream->result;
+    const AdvancedStats* stats = &result->advanced_stats;
+    char word[MAX_WORD_LEN];
+    memcpy(word, stream->word_buf, stream->word_len);
+    word[stream->word_len] = '\0';
+
+    fprintf(file, "ANALYZER_STATE %d\n", STATE_FORMAT_VERSION);
+    fprintf(file, "dictionary %016llx\n", stream->dict ? stream->dict->hash : 0ULL);
+    fprintf(file, "offset %lld %016llx\n", stream->offset, tail_hash);
+    fprintf(file, "counts %lld %lld %d %d %d %d\n", result->word_count, result->char_count,
+            result->line_count, result->sentence_count, result->toxic_word_count, stream->word_len);
+    fprintf(file, "tokenizer %d %d %d %d %lld %s\n", stream->in_word, stream->pending_quote,
+            stream->in_run, stream->sentence_run_words, stream->line_start_words,
+            stream->word_len > 0 ? word : "-");
+    fprintf(file, "stats %d %d %d %d\n", stats->total_sentences, stats->longest_sentence,
+            stats->shortest_sentence, stats->sentence_words);
+    fprintf(file, "hits %d\n", stream->phrase_slots);
+    for (int i = 0; i < stream->phrase_slots && stream->phrase_hits; i++) {
+        if (stream->phrase_hits[i] > 0) {
+            fprintf(file, "hit %d %d\n", i, stream->phrase_hits[i]);
+        }
+    }
+    fprintf(file, "words %d %lld %lld %lld\n", log->generation, log->bytes, log->records, log->compacted);
+
+    // the unfinished line goes last as raw bytes, a state without it is incomplete
+    fprintf(file, "line %d\n", stream->line_len);
+    if (stream->line_len > 0) {
+        fwrite(stream->line, 1, stream->line_len, file);
+    }
+    int ok = !ferror(file);
+    ok = (fclose(file) == 0) && ok;
+    if (ok) {
+        remove(state_file);
+        ok = rename(temp_path, state_file) == 0;
+    }
+    if (!ok) {
+        remove(temp_path);
+    }
+    return ok;
+}
+
+// Append the words counted since the state was loaded to the word log, then
+// replace the state
+int save_stream_state(const char* state_file, const AnalysisStream* stream, unsigned long long tail_hash, WordLog* log) {
+    if (stream->result.sketch != NULL) {
+        log_message(LOG_LEVEL_WARNING, " Warning: Approximate counts cannot be resumed, no state saved\n");
+        return 0;
+    }
+
+    char path[300];
+    word_log_path(state_file, log->generation, path, sizeof(path));
+    WordLog next = *log;
+    long long records = write_word_log(path, log->bytes, &stream->result, &next.bytes);
+    next.records += records;
+    if (log->bytes == 0) {
+        next.compacted = next.records;
+    }
+    if (records < 0 || !write_state_file(state_file, stream, tail_hash, &next)) {
+        log_message(LOG_LEVEL_WARNING, " Warning: Cannot write state file %s\n", state_file);
+        return 0;
+    }
+    *log = next;
+    return 1;
+}
+
+// Restore a stream saved with save_stream_state, fails if the dictionaries
+// changed. The words stay in the log. Saved states hold exact counts,
+// approximate runs start over
+int load_stream_state(const char* state_file, AnalysisStream* stream, unsigned long long* tail_hash, WordLog* log) {
+    if (get_sketch_options()->enabled) {
+        return 0;
+    }
+    FILE* file = fopen(state_file, "rb");
+    if (file == NULL) {
+        return 0;
+    }
+
+    char line[256];
+    int version = 0;
+    unsigned long long dictionary = 0;
+    if (fgets(line, sizeof(line), file) == NULL ||
+        sscanf(line, "ANALYZER_STATE %d", &version) != 1 || version != STATE_FORMAT_VERSION ||
+        fgets(line, sizeof(line), file) == NULL ||
+        sscanf(line, "dictionary %llx", &dictionary) != 1) {
+        fclose(file);
+        return 0;
+    }
+
+    // hit positions are only meaningful for the dictionaries they were counted with
+    analysis_stream_init(stream);
+    if (stream->dict == NULL || stream->dict->hash != dictionary || stream->result.hash_table == NULL) {
+        analysis_stream_free(stream);
+        fclose(file);
+        return 0;
+    }
+    AnalysisResult* result = &stream->result;
+    AdvancedStats* stats = &result->advanced_stats;
+    int ok = 1;
+    int have_words = 0;
+    int have_line = 0;
+
+    while (ok && fgets(line, sizeof(line), file)) {
+        line[strcspn(line, "\n")] = '\0';
+        int a, b;
+        char word[MAX_WORD_LEN];
+
+        if (strncmp(line, "hit ", 4) == 0) {
+            if (sscanf(line + 4, "%d %d", &a, &b) == 2 && a >= 0 && a < stream->phrase_slots) {
+                stream->phrase_hits[a] = b;
+            }
+        } else if (strncmp(line, "offset ", 7) == 0) {
+            ok = sscanf(line + 7, "%lld %llx", &stream->offset, tail_hash) == 2;
+        } else if (strncmp(line, "counts ", 7) == 0) {
+            ok = sscanf(line + 7, "%lld %lld %d %d %d %d", &result->word_count, &result->char_count,
+                        &result->line_count, &result->sentence_count, &result->toxic_word_count,
+                        &stream->word_len) == 6;
+        } else if (strncmp(line, "tokenizer ", 10) == 0) {
+            ok = sscanf(line + 10, "%d %d %d %d %lld %49s", &stream->in_word, &stream->pending_quote,
+                        &stream->in_run, &stream->sentence_run_words, &stream->line_start_words,
+                        word) == 6;
+            if (ok && stream->word_len > 0) {
+                memcpy(stream->word_buf, word, stream->word_len);
+            }
+        } else if (strncmp(line, "stats ", 6) == 0) {
+            ok = sscanf(line + 6, "%d %d %d %d", &stats->total_sentences, &stats->longest_sentence,
+                        &stats->shortest_sentence, &stats->sentence_words) == 4;
+        } else if (strncmp(line, "hits ", 5) == 0) {
+            ok = sscanf(line + 5, "%d", &a) == 1 && a == stream->phrase_slots;
+        } else if (strncmp(line, "words ", 6) == 0) {
+            ok = sscanf(line + 6, "%d %lld %lld %lld", &log->generation, &log->bytes, &log->records,
+                        &log->compacted) == 4 && log->bytes >= 0 && log->records >= 0;
+            have_words = ok;
+        } else if (strncmp(line, "line ", 5) == 0) {
+            a = atoi(line + 5);
+            if (a > 0) {
+                stream->line = (char*)malloc(a + 256);
+                stream->line_cap = a + 256;
+                ok = stream->line != NULL && (int)fread(stream->line, 1, a, file) == a;
+                stream->line_len = ok ? a : 0;
+            }
+            have_line = ok && a >= 0;
+            break;
+        }
+    }
+    fclose(file);
+
+    // a state cut short by a crash is never resumed
+    if (!ok || !have_words || !have_line) {
+        analysis_stream_free(stream);
+        return 0;
+    }
+    return 1;
+}
+
+// Hash of the bytes just before offset, detects files that were rewritten
+static unsigned long long hash_tail(FILE* file, long long offset) {
+    unsigned char buffer[STATE_TAIL_CHECK];
+    long long start = (offset > STATE_TAIL_CHECK) ? offset - STATE_TAIL_CHECK : 0;
+    size_t len = (size_t)(offset - start);
+
+    if (seek_file(file, start) != 0 || fread(buffer, 1, len, file) != len) {
+        return 0;
+    }
+    return fnv1a_update(FNV_OFFSET, buffer, len);
+}
+
+// Rewrite the log from the merged counts once appends have doubled it, so
+// it stays within a small factor of the vocabulary
+static void compact_word_log(const char* state_file, const AnalysisStream* stream, unsigned long long tail_hash,
+                             WordLog* log) {
+    if (log->records < WORD_LOG_MIN_RECORDS || log->records <= 2 * log->compacted) {
+        return;
+    }
+    char path[300], old_path[300];
+    WordLog next = {log->generation + 1, 0, 0, 0};
+    word_log_path(state_file, next.generation, path, sizeof(path));
+    word_log_path(state_file, log->generation, old_path, sizeof(old_path));
+    next.records = write_word_log(path, 0, &stream->result, &next.bytes);
+    next.compacted = next.records;
+    if (next.records < 0 || !write_state_file(state_file, stream, tail_hash, &next)) {
+        remove(path);
+        return;
+    }
+    remove(old_path);
+    *log = next;
+}
+
+// Analyze only the bytes appended since the last run. The tokenizer and
+// counts are kept in a state file and only the words of the new data are
+// appended to the word log. The earlier vocabulary is still read back for
+// the report, so a run costs the new data plus one pass over the vocabulary
+AnalysisResult analyze_file_incremental(const char* filename, long long* new_bytes) {
+    AnalysisResult result = {0};
+    if (new_bytes) *new_bytes = 0;
+
+    char state_file[256];
+    unsigned long long path_hash = fnv1a_update(FNV_OFFSET, (const unsigned char*)filename, strlen(filename));
+    make_directory(CACHE_DIR);
+    snprintf(state_file, sizeof(state_file), "%s/%016llx.state", CACHE_DIR, path_hash);
+
+    FILE* file = fopen(filename, "rb");
+    if (file == NULL) {
+        log_message(LOG_LEVEL_ERROR, "Error: Cannot open file %s\n", filename);
+        return result;
+    }
+    long long file_size = get_large_file_size(filename);
+
+    AnalysisStream stream;
+    unsigned long long tail_hash = 0;
+    WordLog log = {0, 0, 0, 0};
+    char log_path[300];
+    int resumed = load_stream_state(state_file, &stream, &tail_hash, &log);
+    if (resumed && (stream.offset > file_size || hash_tail(file, stream.offset) != tail_hash)) {
+        log_message(LOG_LEVEL_INFO, " %s changed before the saved offset, analyzing from the start\n", filename);
+        analysis_stream_free(&stream);
+        word_log_path(state_file, log.generation, log_path, sizeof(log_path));
+        remove(log_path);
+        resumed = 0;
+    }
+    if (!resumed) {
+        analysis_stream_init(&stream);
+        WordLog fresh = {log.generation + 1, 0, 0, 0};
+        log = fresh;
+    }
+
+    long long start = stream.offset;
+    if (seek_file(file, start) != 0) {
+        log_message(LOG_LEVEL_ERROR, "Error: Cannot seek in %s\n", filename);
+        fclose(file);
+        analysis_stream_free(&stream);
+        return result;
+    }
+
+    size_t chunk_size = 1024 * 1024;
+    char* chunk = (char*)malloc(chunk_size);
+    if (chunk == NULL) {
+        handle_error("analyze_file_incremental", ERROR_MEMORY_ALLOCATION, filename);
+        fclose(file);
+        analysis_stream_free(&stream);
+        return result;
+    }
+    size_t bytes_read;
+    while ((bytes_read = fread(chunk, 1, chunk_size, file)) > 0) {
+        analysis_stream_feed(&stream, chunk, bytes_read);
+    }
+    free(chunk);
+
+    tail_hash = hash_tail(file, stream.offset);
+    fclose(file);
+
+    if (new_bytes) *new_bytes = stream.offset - start;
+    if (resumed) {
+        log_message(LOG_LEVEL_INFO, " Resumed %s at byte %lld, analyzed %lld new bytes\n", filename, start, stream.offset - start);
+    } else {
+        log_message(LOG_LEVEL_INFO, " Analyzed %s from the start (%lld bytes)\n", filename, stream.offset);
+    }
+
+    // earlier counts join the new words only after those were logged
+    WordLog previous = log;
+    save_stream_state(state_file, &stream, tail_hash, &log);
+    if (resumed && !merge_word_log(state_file, &previous, &stream.result)) {
+        log_message(LOG_LEVEL_WARNING, " Warning: Word log of %s is damaged, analyzing from the start\n", filename);
+        analysis_stream_free(&stream);
+        word_log_path(state_file, previous.generation, log_path, sizeof(log_path));
+        remove(log_path);
+        remove(state_file);
+        return analyze_file_incremental(filename, new_bytes);
+    }
+    compact_word_log(state_file, &stream, tail_hash, &log);
+    return analysis_stream_finish(&stream);
+}
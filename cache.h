@@ -0,0 +1,44 @@
+#ifndef CACHE_H
+#define CACHE_H
+
+#include "content.h"
+
+#define CACHE_DIR "analysis_cache"
+#define CACHE_MAX_BYTES (64L * 1024 * 1024)  // LRU evicts past this size
+#define CACHE_KEY_LEN 33                      // 32 hex chars + '\0'
+#define CACHE_FORMAT_VERSION 2
+
+// content hashing
+int hash_file_content(const char* filename, unsigned long long* hash);
+
+// cache lookups, key = content hash + dictionary hash
+int cache_make_key(const char* filename, char* key);
+int cache_load_result(const char* key, AnalysisResult* result);
+void cache_store_result(const char* key, const AnalysisResult* result);
+void cache_flush(void);
+
+// analyze with cache, unchanged files are not analyzed again
+AnalysisResult analyze_file_cached(const char* filename, int* from_cache);
+int analyze_files_cached(const char** filenames, int file_count, AnalysisResult* merged);
+
+// incremental analysis of append-only files
+#define STATE_FORMAT_VERSION 3
+#define STATE_TAIL_CHECK 4096   // bytes before the offset that must be unchanged
+#define WORD_LOG_MIN_RECORDS 4096   // a word log this small is never compacted
+
+// Word counts of an incremental run are appended to a log next to the state
+// file, a run writes only the words of its new data. The state says how much
+// of the log is valid, and the log is rewritten under a new generation once
+// appends have doubled it
+typedef struct {
+    int generation;             // part of the log file name
+    long long bytes;            // valid length
+    long long records;          // word records, a word may appear in several
+    long long compacted;        // records right after the last rewrite
+} WordLog;
+
+int save_stream_state(const char* state_file, const AnalysisStream* stream, unsigned long long tail_hash, WordLog* log);
+int load_stream_state(const char* state_file, AnalysisStream* stream, unsigned long long* tail_hash, WordLog* log);
+AnalysisResult analyze_file_incremental(const char* filename, long long* new_bytes);
+
+#endif
@@ -0,0 +1,526 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "columnar.h"
+#include "content.h"
+#include "dict.h"
+#include "file.h"
+#include "reader.h"
+#include "tool.h"
+#include "error.h"
+
+enum {
+    COL_ROW = 0,
+    COL_WORDS,
+    COL_SCORE,
+    COL_MILD,
+    COL_MODERATE,
+    COL_SEVERE,
+    COL_PHRASE_COUNT,
+    COL_PHRASES
+};
+
+static const char COLUMNAR_MAGIC_BYTES[8] = COLUMNAR_MAGIC;
+
+// growable byte buffer for one column of the current row group
+typedef struct {
+    unsigned char* data;
+    size_t len;
+    size_t cap;
+} ByteColumn;
+
+typedef struct {
+    const RowExportOptions* options;
+    FILE* file;
+    long long written;          // bytes in the output so far
+    int failed;
+
+    AnalysisStream stream;
+    PhraseIdList phrases;       // matches on the current row
+    AnalysisResult* score_input;
+    long long line_number;      // of the row being analyzed
+
+    // current row group
+    ByteColumn columns[COLUMNAR_COLUMNS];
+    ByteColumn header;
+    int* group_codes;           // dictionary phrase -> code in this group, -1 if unused
+    int* group_dict;            // code -> dictionary phrase
+    int group_dict_count;
+    int group_rows;
+    long long group_last_row;
+
+    long long* group_offsets;
+    unsigned int* group_row_counts;
+    int group_count;
+    int group_capacity;
+    long long rows;
+    long long toxic_rows;
+
+    // a line split across read chunks
+    char* line;
+    size_t line_len;
+    size_t line_cap;
+    long long lines_read;
+} RowExport;
+
+//  ENCODING
+
+static int column_reserve(ByteColumn* column, size_t extra) {
+    if (column->len + extra <= column->cap) return 1;
+    size_t cap = column->cap ? column->cap : 65536;
+    while (cap < column->len + extra) cap *= 2;
+    unsigned char* data = (unsigned char*)realloc(column->data, cap);
+    if (data == NULL) return 0;
+    column->data = data;
+    column->cap = cap;
+    return 1;
+}
+
+static void column_varint(ByteColumn* column, unsigned long long value) {
+    if (!column_reserve(column, 10)) return;
+    while (value >= 0x80) {
+        column->data[column->len++] = (unsigned char)(value | 0x80);
+        value >>= 7;
+    }
+    column->data[column->len++] = (unsigned char)value;
+}
+
+static void column_le(ByteColumn* column, unsigned long long value, int bytes) {
+    if (!column_reserve(column, bytes)) return;
+    for (int i = 0; i < bytes; i++) {
+        column->data[column->len++] = (unsigned char)(value >> (8 * i));
+    }
+}
+
+static void column_bytes(ByteColumn* column, const void* data, size_t len) {
+    if (!column_reserve(column, len)) return;
+    memcpy(column->data + column->len, data, len);
+    column->len += len;
+}
+
+static void export_write(RowExport* export, const void* data, size_t len) {
+    if (export->failed) return;
+    if (fwrite(data, 1, len, export->file) != len) {
+        log_message(LOG_LEVEL_ERROR, "Error: Failed to write %s\n", export->options->output);
+        export->failed = 1;
+    }
+    export->written += len;
+}
+
+//  WRITING
+
+static void flush_row_group(RowExport* export) {
+    if (export->group_rows == 0) return;
+
+    if (export->group_count == export->group_capacity) {
+        int capacity = export->group_capacity ? export->group_capacity * 2 : 64;
+        long long* offsets = (long long*)realloc(export->group_offsets, capacity * sizeof(long long));
+        if (offsets != NULL) export->group_offsets = offsets;
+        unsigned int* counts = (unsigned int*)realloc(export->group_row_counts, capacity * sizeof(unsigned int));
+        if (counts != NULL) export->group_row_counts = counts;
+        if (offsets == NULL || counts == NULL) {
+            export->failed = 1;
+            return;
+        }
+        export->group_capacity = capacity;
+    }
+    export->group_offsets[export->group_count] = export->written;
+    export->group_row_counts[export->group_count] = export->group_rows;
+    export->group_count++;
+
+    // the group dictionary maps the codes in COL_PHRASES back to phrases
+    ByteColumn* header = &export->header;
+    header->len = 0;
+    column_le(header, export->group_rows, 4);
+    column_le(header, export->group_dict_count, 4);
+    for (int i = 0; i < export->group_dict_count; i++) {
+        column_varint(header, export->group_dict[i]);
+    }
+    for (int i = 0; i < COLUMNAR_COLUMNS; i++) {
+        column_le(header, export->columns[i].len, 4);
+    }
+    export_write(export, header->data, header->len);
+    for (int i = 0; i < COLUMNAR_COLUMNS; i++) {
+        export_write(export, export->columns[i].data, export->columns[i].len);
+        export->columns[i].len = 0;
+    }
+
+    for (int i = 0; i < export->group_dict_count; i++) {
+        export->group_codes[export->group_dict[i]] = -1;
+    }
+    export->group_dict_count = 0;
+    export->group_rows = 0;
+    export->group_last_row = 0;
+}
+
+static int compare_ints(const void* a, const void* b) {
+    return *(const int*)a - *(const int*)b;
+}
+
+// on_line hook: one fed row has been matched, append it to the columns
+static void record_row(AnalysisStream* stream, void* data) {
+    RowExport* export = (RowExport*)data;
+    PhraseIdList* phrases = &export->phrases;
+    const ToxicDictionary* dict = &stream->dict->toxic;
+
+    // a phrase counts once per row, like detected_phrases for a text
+    int distinct = 0;
+    if (phrases->count > 1) {
+        qsort(phrases->ids, phrases->count, sizeof(int), compare_ints);
+    }
+    for (int i = 0; i < phrases->count; i++) {
+        if (distinct == 0 || phrases->ids[distinct - 1] != phrases->ids[i]) {
+            phrases->ids[distinct++] = phrases->ids[i];
+        }
+    }
+
+    AnalysisResult* score_input = export->score_input;
+    memset(score_input->severity_counts, 0, sizeof(score_input->severity_counts));
+    for (int i = 0; i < distinct; i++) {
+        score_input->severity_counts[dict->severity[phrases->ids[i]]]++;
+    }
+    score_input->word_count = stream->line_words;
+    score_input->toxic_phrase_count = distinct;
+    int score = calculate_toxicity_score(score_input);
+
+    ByteColumn* columns = export->columns;
+    column_varint(&columns[COL_ROW], export->line_number - export->group_last_row);
+    export->group_last_row = export->line_number;
+    column_varint(&columns[COL_WORDS], stream->line_words);
+    column_varint(&columns[COL_SCORE], score);
+    column_varint(&columns[COL_MILD], score_input->severity_counts[SEVERITY_MILD]);
+    column_varint(&columns[COL_MODERATE], score_input->severity_counts[SEVERITY_MODERATE]);
+    column_varint(&columns[COL_SEVERE], score_input->severity_counts[SEVERITY_SEVERE]);
+    column_varint(&columns[COL_PHRASE_COUNT], distinct);
+    for (int i = 0; i < distinct; i++) {
+        int id = phrases->ids[i];
+        if (export->group_codes[id] < 0) {
+            export->group_codes[id] = export->group_dict_count;
+            export->group_dict[export->group_dict_count++] = id;
+        }
+        column_varint(&columns[COL_PHRASES], export->group_codes[id]);
+    }
+
+    export->rows++;
+    if (distinct > 0) export->toxic_rows++;
+    if (++export->group_rows == COLUMNAR_ROW_GROUP_ROWS) {
+        flush_row_group(export);
+    }
+}
+
+static void export_line(RowExport* export, char* line, size_t len) {
+    export->lines_read++;
+    if (len > 0 && line[len - 1] == '\r') len--;
+    line[len] = '\0';
+    if (len == 0 || (export->lines_read == 1 && export->options->has_header)) {
+        return;
+    }
+
+    const char* text = line;
+    if (export->options->column >= 0) {
+        // same column split as csv_column_to_text
+        char* rest = line;
+        char* token;
+        int column = 0;
+        text = "";
+        while ((token = next_token(&rest, ",")) != NULL) {
+            if (column++ == export->options->column) {
+                text = token;
+                break;
+            }
+        }
+    }
+
+    export->line_number = export->lines_read;
+    analysis_stream_feed(&export->stream, text, strlen(text));
+    analysis_stream_feed(&export->stream, "\n", 1);
+}
+
+static int line_append(RowExport* export, const char* data, size_t len) {
+    if (export->line_len + len + 1 > export->line_cap) {
+        size_t cap = export->line_cap ? export->line_cap : 4096;
+        while (cap < export->line_len + len + 1) cap *= 2;
+        char* line = (char*)realloc(export->line, cap);
+        if (line == NULL) return 0;
+        export->line = line;
+        export->line_cap = cap;
+    }
+    memcpy(export->line + export->line_len, data, len);
+    export->line_len += len;
+    return 1;
+}
+
+static void export_chunk(const char* chunk, size_t len, void* data) {
+    RowExport* export = (RowExport*)data;
+    const char* end = chunk + len;
+
+    while (chunk < end && !export->failed) {
+        const char* newline = (const char*)memchr(chunk, '\n', end - chunk);
+        size_t part = (newline ? newline : end) - chunk;
+        if (!line_append(export, chunk, part)) {
+            export->failed = 1;
+            return;
+        }
+        if (newline == NULL) break;
+        export_line(export, export->line, export->line_len);
+        export->line_len = 0;
+        chunk = newline + 1;
+    }
+}
+
+static void write_footer(RowExport* export) {
+    ByteColumn* footer = &export->header;
+    const ToxicDictionary* dict = &export->stream.dict->toxic;
+    long long footer_offset = export->written;
+
+    footer->len = 0;
+    column_le(footer, dict->count, 4);
+    for (int i = 0; i < dict->count; i++) {
+        size_t len = strlen(dict->text[i]);
+        column_le(footer, dict->severity[i], 1);
+        column_varint(footer, len);
+        column_bytes(footer, dict->text[i], len);
+    }
+    column_le(footer, export->group_count, 4);
+    for (int i = 0; i < export->group_count; i++) {
+        column_le(footer, export->group_offsets[i], 8);
+        column_le(footer, export->group_row_counts[i], 4);
+    }
+    column_le(footer, export->rows, 8);
+    column_le(footer, footer_offset, 8);
+    column_bytes(footer, COLUMNAR_MAGIC_BYTES, 8);
+    export_write(export, footer->data, footer->len);
+}
+
+long long export_rows_columnar(const RowExportOptions* options) {
+    double start = get_time_ms();
+    RowExport* export = (RowExport*)calloc(1, sizeof(RowExport));
+    if (export == NULL) {
+        log_message(LOG_LEVEL_ERROR, "Error: Memory allocation failed\n");
+        return -1;
+    }
+    export->options = options;
+
+    FILE* input = fopen(options->input, "rb");
+    if (input == NULL) {
+        log_message(LOG_LEVEL_ERROR, "Error: Cannot open file %s\n", options->input);
+        free(export);
+        return -1;
+    }
+    export->file = fopen(options->output, "wb");
+    if (export->file == NULL) {
+        log_message(LOG_LEVEL_ERROR, "Error: Cannot create %s\n", options->output);
+        fclose(input);
+        free(export);
+        return -1;
+    }
+
+    analysis_stream_init(&export->stream);
+    export->stream.line_phrases = &export->phrases;
+    export->stream.on_line = record_row;
+    export->stream.callback_data = export;
+    int dict_size = export->stream.phrase_slots;
+    export->score_input = (AnalysisResult*)calloc(1, sizeof(AnalysisResult));
+    export->group_codes = (int*)malloc((dict_size + 1) * sizeof(int));
+    export->group_dict = (int*)malloc((dict_size + 1) * sizeof(int));
+    if (export->score_input == NULL || export->group_codes == NULL || export->group_dict == NULL ||
+        export->stream.dict == NULL) {
+        log_message(LOG_LEVEL_ERROR, "Error: Memory allocation failed\n");
+        export->failed = 1;
+    } else {
+        memset(export->group_codes, 0xff, (dict_size + 1) * sizeof(int));
+        export_write(export, COLUMNAR_MAGIC_BYTES, 8);
+        if (read_file_ahead(input, export_chunk, export) < 0) {
+            export->failed = 1;
+        }
+        if (export->line_len > 0 && !export->failed) {
+            export_line(export, export->line, export->line_len);
+        }
+        flush_row_group(export);
+        write_footer(export);
+    }
+    fclose(input);
+    if (fclose(export->file) != 0) export->failed = 1;
+
+    long long rows = export->failed ? -1 : export->rows;
+    if (!export->failed) {
+        log_message(LOG_LEVEL_INFO, "ROWS %s -> %s: %lld rows (%lld toxic) in %d row groups, %lld bytes, %.1f ms\n",
+                    options->input, options->output, export->rows, export->toxic_rows, export->group_count,
+                    export->written, get_time_ms() - start);
+    }
+
+    AnalysisResult totals = analysis_stream_finish(&export->stream);
+    cleanup_analyzer(&totals);
+    for (int i = 0; i < COLUMNAR_COLUMNS; i++) {
+        free(export->columns[i].data);
+    }
+    free(export->header.data);
+    free(export->phrases.ids);
+    free(export->phrases.starts);
+    free(export->score_input);
+    free(export->group_codes);
+    free(export->group_dict);
+    free(export->group_offsets);
+    free(export->group_row_counts);
+    free(export->line);
+    free(export);
+    return rows;
+}
+
+//  READING
+
+static unsigned long long read_le(const unsigned char* p, int bytes) {
+    unsigned long long value = 0;
+    for (int i = 0; i < bytes; i++) {
+        value |= (unsigned long long)p[i] << (8 * i);
+    }
+    return value;
+}
+
+// Decode one varint, sets *p to NULL past the end
+static unsigned long long read_varint(const unsigned char** p, const unsigned char* end) {
+    unsigned long long value = 0;
+    int shift = 0;
+    while (*p != NULL && *p < end && shift < 64) {
+        unsigned char byte = *(*p)++;
+        value |= (unsigned long long)(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) return value;
+        shift += 7;
+    }
+    *p = NULL;
+    return 0;
+}
+
+static unsigned char* read_range(FILE* file, long long offset, long long len) {
+    if (offset < 0 || len < 0) return NULL;
+    unsigned char* data = (unsigned char*)malloc(len > 0 ? len : 1);
+    if (data == NULL) return NULL;
+    if (seek_file(file, offset) != 0 || fread(data, 1, len, file) != (size_t)len) {
+        free(data);
+        return NULL;
+    }
+    return data;
+}
+
+long long dump_rows_columnar(const char* filename, FILE* out, long long limit) {
+    long long size = get_large_file_size(filename);
+    FILE* file = fopen(filename, "rb");
+    if (file == NULL || size < 32) {
+        log_message(LOG_LEVEL_ERROR, "Error: Cannot read %s\n", filename);
+        if (file) fclose(file);
+        return -1;
+    }
+
+    unsigned char trailer[24];
+    unsigned char* footer = NULL;
+    char** phrases = NULL;
+    long long footer_offset = 0;
+    int phrase_count = 0;
+    if (seek_file(file, size - 24) == 0 && fread(trailer, 1, 24, file) == 24 &&
+        memcmp(trailer + 16, COLUMNAR_MAGIC_BYTES, 8) == 0) {
+        footer_offset = (long long)read_le(trailer + 8, 8);
+    }
+    if (footer_offset >= 8 && footer_offset < size - 24) {
+        footer = read_range(file, footer_offset, size - 24 - footer_offset);
+    }
+    if (footer == NULL) {
+        log_message(LOG_LEVEL_ERROR, "Error: %s is not a columnar results file\n", filename);
+        fclose(file);
+        return -1;
+    }
+
+    // phrase table
+    const unsigned char* p = footer;
+    const unsigned char* footer_end = footer + (size - 24 - footer_offset);
+    phrase_count = (footer_end - p >= 4) ? (int)read_le(p, 4) : 0;
+    p += 4;
+    phrases = (char**)calloc(phrase_count + 1, sizeof(char*));
+    for (int i = 0; i < phrase_count && p != NULL && phrases != NULL; i++) {
+        p++;                    // severity
+        unsigned long long len = read_varint(&p, footer_end);
+        if (p == NULL || len > (unsigned long long)(footer_end - p)) break;
+        phrases[i] = (char*)malloc(len + 1);
+        if (phrases[i] == NULL) break;
+        memcpy(phrases[i], p, len);
+        phrases[i][len] = '\0';
+        p += len;
+    }
+
+    long long printed = 0;
+    int group_count = (p != NULL && footer_end - p >= 4) ? (int)read_le(p, 4) : 0;
+    if (p != NULL) p += 4;
+    fprintf(out, "row,words,score,mild,moderate,severe,phrases\n");
+
+    for (int g = 0; g < group_count && p != NULL && footer_end - p >= 12; g++, p += 12) {
+        long long offset = (long long)read_le(p, 8);
+        long long next = (g + 1 < group_count && footer_end - p >= 24) ? (long long)read_le(p + 12, 8) : footer_offset;
+        // a damaged footer must not send a group past its neighbours
+        if (offset < 8 || next > footer_offset || next - offset < 8) {
+            log_message(LOG_LEVEL_ERROR, "Error: %s has a damaged row group\n", filename);
+            break;
+        }
+        unsigned char* group = read_range(file, offset, next - offset);
+        if (group == NULL) break;
+        const unsigned char* group_end = group + (next - offset);
+
+        const unsigned char* q = group;
+        unsigned int rows = (unsigned int)read_le(q, 4);
+        unsigned int dict_count = (unsigned int)read_le(q + 4, 4);
+        q += 8;
+        // every dictionary entry takes at least one byte
+        if (dict_count > (unsigned long long)(group_end - q)) {
+            dict_count = 0;
+            q = NULL;
+        }
+        int* group_dict = (int*)malloc((dict_count + 1) * sizeof(int));
+        for (unsigned int i = 0; i < dict_count && q != NULL && group_dict != NULL; i++) {
+            group_dict[i] = (int)read_varint(&q, group_end);
+        }
+
+        // each column is read with its own cursor
+        const unsigned char* cursor[COLUMNAR_COLUMNS];
+        const unsigned char* column_end[COLUMNAR_COLUMNS];
+        const unsigned char* data = (q != NULL && group_end - q >= 4 * COLUMNAR_COLUMNS) ? q + 4 * COLUMNAR_COLUMNS : NULL;
+        for (int c = 0; c < COLUMNAR_COLUMNS && data != NULL; c++) {
+            size_t len = (size_t)read_le(q + 4 * c, 4);
+            if (len > (size_t)(group_end - data)) {
+                data = NULL;
+                break;
+            }
+            cursor[c] = data;
+            column_end[c] = data + len;
+            data += len;
+        }
+
+        long long row = 0;
+        for (unsigned int r = 0; r < rows && data != NULL && group_dict != NULL; r++) {
+            if (limit >= 0 && printed >= limit) break;
+            unsigned long long values[COL_PHRASE_COUNT + 1];
+            for (int c = COL_ROW; c <= COL_PHRASE_COUNT; c++) {
+                values[c] = read_varint(&cursor[c], column_end[c]);
+            }
+            row += values[COL_ROW];
+            fprintf(out, "%lld,%llu,%llu,%llu,%llu,%llu,\"", row, values[COL_WORDS], values[COL_SCORE],
+                    values[COL_MILD], values[COL_MODERATE], values[COL_SEVERE]);
+            for (unsigned long long i = 0; i < values[COL_PHRASE_COUNT] && cursor[COL_PHRASES] != NULL; i++) {
+                unsigned long long code = read_varint(&cursor[COL_PHRASES], column_end[COL_PHRASES]);
+                int id = (code < dict_count) ? group_dict[code] : -1;
+                const char* text = (id >= 0 && id < phrase_count && phrases[id]) ? phrases[id] : "?";
+                fprintf(out, "%s%s", i ? "|" : "", text);
+            }
+            fprintf(out, "\"\n");
+            printed++;
+        }
+        free(group_dict);
+        free(group);
+        if (limit >= 0 && printed >= limit) break;
+    }
+
+    for (int i = 0; i < phrase_count && phrases != NULL; i++) {
+        free(phrases[i]);
+    }
+    free(phrases);
+    free(footer);
+    fclose(file);
+    return printed;
+}
@@ -0,0 +1,37 @@
+#ifndef COLUMNAR_H
+#define COLUMNAR_H
+
+#include <stdio.h>
+
+// Per-row toxicity results in a compact columnar file (.tcol):
+//
+//   "TOXCOL1\0"
+//   row groups: u32 rows, u32 dictionary size, varint phrase ids of the
+//               group dictionary, then each column as u32 byte length + data
+//   footer:     u32 phrase count, per phrase u8 severity + varint length + text,
+//               u32 group count, per group u64 offset + u32 rows,
+//               u64 total rows, u64 footer offset, "TOXCOL1\0"
+//
+// Columns are LEB128 varints: row (line number, delta in the group), words,
+// score, mild, moderate, severe (distinct phrases per severity), phrase count
+// per row, then the row's phrases as codes into the group dictionary.
+// Integers in headers and footer are little endian
+#define COLUMNAR_MAGIC "TOXCOL1"
+#define COLUMNAR_ROW_GROUP_ROWS 65536
+#define COLUMNAR_COLUMNS 8
+
+// options for analyzer --rows
+typedef struct {
+    const char* input;          // CSV or text, one row per line
+    const char* output;
+    int column;                 // analyze only this CSV column, -1 for the whole row
+    int has_header;             // skip the first line
+} RowExportOptions;
+
+// Returns the number of rows written, -1 on error
+long long export_rows_columnar(const RowExportOptions* options);
+
+// Print a .tcol file as CSV, limit < 0 prints every row. Returns rows printed or -1
+long long dump_rows_columnar(const char* filename, FILE* out, long long limit);
+
+#endif
@@ -6,54 +6,19 @@
 #include <time.h>
 #include "content.h"
 #include "tool.h"
-
-// Global variables
-static WordNode* word_array[MAX_WORDS];
-static int wordcount = 0;
-
-// toxic phrases stuff
-static ToxicPhrase toxic_phrases[MAX_TOXIC_PHRASES];
-static int toxic_phrase_count = 0;
-
-static char stopwords[MAX_STOPWORDS][MAX_WORD_LEN];
-static int stopword_count = 0;
+#include "dict.h"
+#include "error.h"
+#include "spill.h"
+#include "sketch.h"
+#include "hits.h"
 
 // UTILITY FUNCTIONS 
 
-// Load stop words from file
-int load_stopwords(const char* filename, char stopwords[][MAX_WORD_LEN], int max_count) {
-    FILE* file = fopen(filename, "r");
-    if (!file) {
-        printf(" Error: Cannot open stopwords file '%s'\n", filename);
-        return 0;
-    }
-    
-    int count = 0;
-    char word[MAX_WORD_LEN];
-    while (count < max_count && fscanf(file, "%s", word) == 1) {
-        strcpy(stopwords[count], word);
-        count++;
-    }
-    
-    fclose(file);
-    printf(" Loaded %d stopwords from %s\n", count, filename);
-    return count;
-}
-
-void init_stopwords() {
-    stopword_count = load_stopwords("stopwords.txt", stopwords, MAX_STOPWORDS);
-    if (stopword_count == 0) {
-        printf(" Warning: No stopwords loaded, using default set\n");
-    }
-}
-
 int is_stop_word(const char* word) {
-    for (int i = 0; i < stopword_count; i++) {
-        if (strcmp(word, stopwords[i]) == 0) {
-            return 1;
-        }
-    }
-    return 0;
+    AnalyzerDictionaries* dicts = dictionaries_acquire();
+    int found = (dicts != NULL && stopwords_contains(&dicts->stopwords, word));
+    dictionaries_release(dicts);
+    return found;
 }
 
 const char* get_severity_name(ToxicitySeverity severity) {
@@ -67,87 +32,120 @@ const char* get_severity_name(ToxicitySeverity severity) {
 
 // TOXIC DICTIONARY MANAGEMENT 
 
-void add_toxic_phrase(const char* phrase, ToxicitySeverity severity) {
-    if (toxic_phrase_count >= MAX_TOXIC_PHRASES) {
-        printf(" Warning: Toxic phrase dictionary full, cannot add '%s'\n", phrase);
-        return;
-    }
-    
-    if (strlen(phrase) == 0 || strlen(phrase) >= MAX_PHRASE_LEN) {
-        printf(" Warning: Invalid phrase length for '%s'\n", phrase);
-        return;
-    }
-    
-    // Check for duplicates
-    for (int i = 0; i < toxic_phrase_count; i++) {
-        if (strcasecmp(toxic_phrases[i].text, phrase) == 0) {
-            printf("  Warning: Duplicate toxic phrase '%s', skipping\n", phrase);
-            return;
-        }
-    }
-    
-    strncpy(toxic_phrases[toxic_phrase_count].text, phrase, MAX_PHRASE_LEN - 1);
-    toxic_phrases[toxic_phrase_count].text[MAX_PHRASE_LEN - 1] = '\0';
-    toxic_phrases[toxic_phrase_count].severity = severity;
-    toxic_phrase_count++;
-}
-
-// Unified toxic dictionary loading
-int load_toxic_dictionary(const char* filename) {
-    FILE* file = fopen(filename, "r");
-    if (file == NULL) {
-        printf(" Error: Cannot open toxic dictionary file '%s'\n", filename);
-        printf("Please create 'toxicwords.txt' with format: phrase,SEVERITY\n");
-        return 0;
-    }
+// TOXICITY DETECTION 
 
-    char line[256];
-    toxic_phrase_count = 0;
-    int loaded_count = 0;
+static void phrase_id_list_add(PhraseIdList* list, int id, int start) {
+    if (list->count == list->capacity) {
+        int capacity = list->capacity ? list->capacity * 2 : 16;
+        int* ids = (int*)realloc(list->ids, capacity * sizeof(int));
+        if (ids == NULL) return;
+        list->ids = ids;
+        int* starts = (int*)realloc(list->starts, capacity * sizeof(int));
+        if (starts == NULL) return;
+        list->starts = starts;
+        list->capacity = capacity;
+    }
+    list->ids[list->count] = id;
+    list->starts[list->count++] = start;
+}
 
-    printf(" Loading toxic dictionary from %s...\n", filename);
+// Count phrase hits in one lowercased line. Phrases never contain a newline,
+// so matching line by line finds the same hits as matching the whole text.
+// A hit starts and ends on a word boundary, so only those substrings (up to
+// the longest phrase) are looked up, whatever the dictionary size
+static int count_phrases_in_line(const ToxicDictionary* dict, const char* line, int* hits, int* severity_hits,
+                                 PhraseIdList* matched) {
+    int total = 0;
     
-    while (fgets(line, sizeof(line), file) && toxic_phrase_count < MAX_TOXIC_PHRASES) {
-        line[strcspn(line, "\n")] = '\0';
-        line[strcspn(line, "\r")] = '\0';
-        
-        if (strlen(line) == 0 || line[0] == '#' || line[0] == ';') {
+    for (int start = 0; line[start]; start++) {
+        if (start > 0 && isalnum((unsigned char)line[start - 1])) {
             continue;
         }
-        
-        char* comma = strchr(line, ',');
-        if (comma != NULL) {
-            *comma = '\0';
-            char* phrase = line;
-            char* severity_str = comma + 1;
-            
-            ToxicitySeverity severity = SEVERITY_MILD;
-            
-            if (strcasecmp(severity_str, "SEVERE") == 0) {
-                severity = SEVERITY_SEVERE;
-            } else if (strcasecmp(severity_str, "MODERATE") == 0) {
-                severity = SEVERITY_MODERATE;
-            } else if (strcasecmp(severity_str, "MILD") == 0) {
-                severity = SEVERITY_MILD;
-            } else {
-                printf("  Warning: Invalid severity '%s' for phrase '%s', using MILD\n", 
-                       severity_str, phrase);
+        unsigned int hash = 0;
+        for (int len = 1; len <= dict->max_len && line[start + len - 1]; len++) {
+            hash = hash * 31 + (unsigned char)line[start + len - 1];
+            if (isalnum((unsigned char)line[start + len])) {
+                continue;
+            }
+            int i = dict_find(dict, line + start, len, hash);
+            if (i >= 0) {
+                hits[i]++;
+                total++;
+                if (severity_hits) severity_hits[dict->severity[i]]++;
+                if (matched) phrase_id_list_add(matched, i, start);
             }
-            
-            add_toxic_phrase(phrase, severity);
-            loaded_count++;
-        } else {
-            add_toxic_phrase(line, SEVERITY_MILD);
-            loaded_count++;
         }
     }
+    return total;
+}
+
+// Fill the detected phrase list from per-dictionary-phrase hit counts
+static void collect_detected_phrases(AnalyzerDictionaries* dicts, AnalysisResult* result, const int* hits) {
+    const ToxicDictionary* dict = &dicts->toxic;
+    free(result->detected_phrases);
+    dictionaries_release(result->phrase_dict);
+    result->detected_phrases = NULL;
+    result->phrase_dict = NULL;
+    result->toxic_phrase_count = 0;
+    memset(result->severity_counts, 0, sizeof(result->severity_counts));
     
-    fclose(file);
-    printf(" Successfully loaded %d toxic phrases\n", loaded_count);
-    return (loaded_count > 0) ? 1 : 0;
+    int found = 0;
+    for (int i = 0; i < dict->count; i++) {
+        if (hits[i] > 0) found++;
+    }
+    if (found == 0) return;
+    result->phrase_dict = dictionaries_retain(dicts);
+    result->detected_phrases = (DetectedPhrase*)malloc(found * sizeof(DetectedPhrase));
+    if (result->detected_phrases == NULL) return;
+    
+    for (int i = 0; i < dict->count; i++) {
+        if (hits[i] > 0) {
+            DetectedPhrase* detected = &result->detected_phrases[result->toxic_phrase_count++];
+            detected->phrase_id = i;
+            detected->count = hits[i];
+            result->severity_counts[dict->severity[i]]++;
+        }
+    }
 }
 
-// TOXICITY DETECTION 
+const char* detected_phrase_text(const AnalysisResult* result, int i) {
+    return result->phrase_dict->toxic.text[result->detected_phrases[i].phrase_id];
+}
+
+ToxicitySeverity detected_phrase_severity(const AnalysisResult* result, int i) {
+    return (ToxicitySeverity)result->phrase_dict->toxic.severity[result->detected_phrases[i].phrase_id];
+}
+
+// position of phrase id in the detected list, appended with count 0 if new
+static int detected_phrase_slot(AnalysisResult* result, int phrase_id) {
+    for (int i = 0; i < result->toxic_phrase_count; i++) {
+        if (result->detected_phrases[i].phrase_id == phrase_id) return i;
+    }
+    DetectedPhrase* grown = (DetectedPhrase*)realloc(result->detected_phrases,
+                                                     (result->toxic_phrase_count + 1) * sizeof(DetectedPhrase));
+    if (grown == NULL) return -1;
+    result->detected_phrases = grown;
+    grown[result->toxic_phrase_count].phrase_id = phrase_id;
+    grown[result->toxic_phrase_count].count = 0;
+    return result->toxic_phrase_count++;
+}
+
+int add_detected_phrase(AnalysisResult* result, const char* text, int count) {
+    if (result->phrase_dict == NULL) {
+        result->phrase_dict = dictionaries_acquire();
+        if (result->phrase_dict == NULL) return -1;
+    }
+    char lower[MAX_PHRASE_LEN];
+    strncpy(lower, text, MAX_PHRASE_LEN - 1);
+    lower[MAX_PHRASE_LEN - 1] = '\0';
+    to_lower_case(lower);
+    int len = strlen(lower);
+    int id = dict_find(&result->phrase_dict->toxic, lower, len, hash_string(lower, len));
+    if (id < 0) return -1;
+    int slot = detected_phrase_slot(result, id);
+    if (slot >= 0) result->detected_phrases[slot].count += count;
+    return slot;
+}
 
 int detect_toxic_phrases(const char* text, AnalysisResult* result) {
     if (text == NULL || result == NULL) {
@@ -157,58 +155,50 @@ int detect_toxic_phrases(const char* text, AnalysisResult* result) {
     result->toxic_phrase_count = 0;
     result->toxic_word_count = 0;
     memset(result->severity_counts, 0, sizeof(result->severity_counts));
+    AnalyzerDictionaries* dicts = dictionaries_acquire();
+    if (dicts == NULL || dicts->toxic.count == 0) {
+        dictionaries_release(dicts);
+        return 0;
+    }
     
-    char text_lower[100000];
-    strncpy(text_lower, text, sizeof(text_lower) - 1);
-    text_lower[sizeof(text_lower) - 1] = '\0';
+    char* text_lower = strdup(text);
+    int* hits = (int*)calloc(dicts->toxic.count, sizeof(int));
+    if (text_lower == NULL || hits == NULL) {
+        free(text_lower);
+        free(hits);
+        dictionaries_release(dicts);
+        return 0;
+    }
     to_lower_case(text_lower);
     
-    int total_detected = 0;
-    
-    for (int i = 0; i < toxic_phrase_count && result->toxic_phrase_count < 50; i++) {
-        char phrase_lower[MAX_PHRASE_LEN];
-        strncpy(phrase_lower, toxic_phrases[i].text, sizeof(phrase_lower) - 1);
-        phrase_lower[sizeof(phrase_lower) - 1] = '\0';
-        to_lower_case(phrase_lower);
-        
-        char* pos = (char*)text_lower;
-        int phrase_count = 0;
-        
-        while ((pos = strstr(pos, phrase_lower)) != NULL) {
-            if ((pos == text_lower || !isalnum((unsigned char)*(pos-1))) &&
-                (!isalnum((unsigned char)*(pos + strlen(phrase_lower))))) {
-                
-                phrase_count++;
-                result->toxic_word_count++;
-            }
-            pos += strlen(phrase_lower);
-        }
-        
-        if (phrase_count > 0 && result->toxic_phrase_count < 50) {
-            strncpy(result->detected_toxic_phrases[result->toxic_phrase_count].text, 
-                   toxic_phrases[i].text, MAX_PHRASE_LEN - 1);
-            result->detected_toxic_phrases[result->toxic_phrase_count].text[MAX_PHRASE_LEN - 1] = '\0';
-            result->detected_toxic_phrases[result->toxic_phrase_count].severity = toxic_phrases[i].severity;
-            result->detected_toxic_phrases[result->toxic_phrase_count].count = phrase_count;
-            
-            result->severity_counts[toxic_phrases[i].severity]++;
-            result->toxic_phrase_count++;
-            total_detected += phrase_count;
-        }
+    char* line = text_lower;
+    while (line != NULL) {
+        char* newline = strchr(line, '\n');
+        if (newline) *newline = '\0';
+        result->toxic_word_count += count_phrases_in_line(&dicts->toxic, line, hits, NULL, NULL);
+        line = newline ? newline + 1 : NULL;
     }
     
-    return total_detected;
+    collect_detected_phrases(dicts, result, hits);
+    free(text_lower);
+    free(hits);
+    dictionaries_release(dicts);
+    return result->toxic_word_count;
 }
 
 int calculate_toxicity_score(const AnalysisResult* result) {
-    if (result->word_count == 0) return 0;
+    return score_toxicity_counts(result->word_count, result->toxic_phrase_count, result->severity_counts);
+}
+
+int score_toxicity_counts(long long word_count, int phrase_count, const int* severity_counts) {
+    if (word_count == 0) return 0;
     
 
-    int base_score = result->severity_counts[SEVERITY_SEVERE] * 3 +
-                    result->severity_counts[SEVERITY_MODERATE] * 2 +
-                    result->severity_counts[SEVERITY_MILD] * 1;
+    int base_score = severity_counts[SEVERITY_SEVERE] * 3 +
+                    severity_counts[SEVERITY_MODERATE] * 2 +
+                    severity_counts[SEVERITY_MILD] * 1;
     
-    double density = (double)result->toxic_phrase_count / result->word_count * 100;
+    double density = (double)phrase_count / word_count * 100;
     
     if (density > 5.0) base_score += 40;
     else if (density > 2.0) base_score += 25;
@@ -243,13 +233,27 @@ void hash_table_init(HashTable* ht) {
     ht->size = 0;
 }
 
+// An empty table on the heap, so results stay small to copy
+HashTable* hash_table_create(void) {
+    HashTable* ht = (HashTable*)malloc(sizeof(HashTable));
+    if (ht != NULL) {
+        hash_table_init(ht);
+    }
+    return ht;
+}
+
 void hash_table_insert(HashTable* ht, const char* word) {
+    hash_table_add(ht, word, 1);
+}
+
+// Add count occurrences of word (used when merging results)
+void hash_table_add(HashTable* ht, const char* word, int count) {
     unsigned int index = hash_function(word);
     WordNode* current = ht->table[index];
     
     while (current != NULL) {
         if (strcmp(current->word, word) == 0) {
-            current->frequency++;
+            current->frequency += count;
             return;
         }
         current = current->next;
@@ -258,7 +262,7 @@ void hash_table_insert(HashTable* ht, const char* word) {
     WordNode* new_node = (WordNode*)malloc(sizeof(WordNode));
     strncpy(new_node->word, word, MAX_WORD_LEN - 1);
     new_node->word[MAX_WORD_LEN - 1] = '\0';
-    new_node->frequency = 1;
+    new_node->frequency = count;
     new_node->next = ht->table[index];
     ht->table[index] = new_node;
     ht->size++;
@@ -278,6 +282,7 @@ void hash_table_to_array(HashTable* ht, WordNode*** array, int* size) {
 }
 
 void hash_table_free(HashTable* ht) {
+    if (ht == NULL) return;
     for (int i = 0; i < HASH_TABLE_SIZE; i++) {
         WordNode* current = ht->table[i];
         while (current != NULL) {
@@ -292,20 +297,35 @@ void hash_table_free(HashTable* ht) {
 
 // SORTING ALGORITHMS 
 
+// Rank order: higher frequency first, ties alphabetically. Every word is
+// distinct, so all sorts agree and runs of equal counts cannot degrade quick sort
+static int word_order(const WordNode* a, const WordNode* b) {
+    if (a->frequency != b->frequency) {
+        return (a->frequency > b->frequency) ? -1 : 1;
+    }
+    return strcmp(a->word, b->word);
+}
+
 int partition(WordNode** array, int low, int high) {
-    int pivot = array[high]->frequency;
+    // middle element as pivot, already ranked input stays fast
+    int mid = low + (high - low) / 2;
+    WordNode* temp = array[mid];
+    array[mid] = array[high];
+    array[high] = temp;
+    
+    WordNode* pivot = array[high];
     int i = low - 1;
     
     for (int j = low; j < high; j++) {
-        if (array[j]->frequency >= pivot) {
+        if (word_order(array[j], pivot) < 0) {
             i++;
-            WordNode* temp = array[i];
+            temp = array[i];
             array[i] = array[j];
             array[j] = temp;
         }
     }
     
-    WordNode* temp = array[i + 1];
+    temp = array[i + 1];
     array[i + 1] = array[high];
     array[high] = temp;
     
@@ -313,17 +333,23 @@ int partition(WordNode** array, int low, int high) {
 }
 
 void quick_sort(WordNode** array, int low, int high) {
-    if (low < high) {
+    // recurse into the smaller part only, so the stack stays shallow
+    while (low < high) {
         int pi = partition(array, low, high);
-        quick_sort(array, low, pi - 1);
-        quick_sort(array, pi + 1, high);
+        if (pi - low < high - pi) {
+            quick_sort(array, low, pi - 1);
+            low = pi + 1;
+        } else {
+            quick_sort(array, pi + 1, high);
+            high = pi - 1;
+        }
     }
 }
 
 void bubble_sort(WordNode** array, int n) {
     for (int i = 0; i < n - 1; i++) {
         for (int j = 0; j < n - i - 1; j++) {
-            if (array[j]->frequency < array[j + 1]->frequency) {
+            if (word_order(array[j], array[j + 1]) > 0) {
                 WordNode* temp = array[j];
                 array[j] = array[j + 1];
                 array[j + 1] = temp;
@@ -347,7 +373,7 @@ void merge(WordNode** array, int left, int mid, int right) {
     int i = 0, j = 0, k = left;
     
     while (i < n1 && j < n2) {
-        if (left_arr[i]->frequency >= right_arr[j]->frequency) {
+        if (word_order(left_arr[i], right_arr[j]) <= 0) {
             array[k] = left_arr[i];
             i++;
         } else {
@@ -402,17 +428,47 @@ void sort_words(WordNode** array, int n, SortAlgorithm algorithm) {
 //ANALYSIS CORE FUNCTIONS 
 
 void init_analyzer(void) {
-    wordcount = 0;
-    memset(word_array, 0, sizeof(word_array));
-    
-    init_stopwords();
+    // stop words and toxic phrases are loaded once, later calls do nothing
+    dictionaries_init();
+}
+
+// Parse a text dictionary once and save it in the binary form init_analyzer maps
+int compile_toxic_dictionary(const char* source_file, const char* output_file) {
+    double start = get_time_ms();
+    ToxicDictionary dict;
+    memset(&dict, 0, sizeof(dict));
     
-    if (!load_toxic_dictionary("toxicwords.txt")) {
-        printf("  Toxicity detection disabled. Create 'toxicwords.txt' to enable.\n");
+    int ok = dict_load_text(&dict, source_file) && dict_compile(&dict, source_file, output_file);
+    if (ok) {
+        log_message(LOG_LEVEL_INFO, " Compiled %d toxic phrases into %s in %.1f ms\n", dict.count, output_file,
+                    get_time_ms() - start);
     }
+    dict_free(&dict);
+    return ok;
 }
 
-void process_word(const char* word, AnalysisResult* result) {
+// Add to the word table, which goes to disk as a sorted run once it is over the
+// budget. In approximate mode the sketch takes the word instead
+static void add_word_count(AnalysisResult* result, const char* word, int count) {
+    if (result->sketch != NULL) {
+        word_sketch_add(result->sketch, word, count);
+        return;
+    }
+    if (result->hash_table == NULL) {
+        result->hash_table = hash_table_create();
+        if (result->hash_table == NULL) return;
+    }
+    hash_table_add(result->hash_table, word, count);
+    if (result->spill != NULL && result->hash_table->size >= result->spill->max_words) {
+        word_spill_flush(result->spill, result->hash_table);
+    }
+}
+
+static void add_spilled_word(const char* word, int frequency, void* data) {
+    add_word_count((AnalysisResult*)data, word, frequency);
+}
+
+static void count_word(const StopwordList* stopwords, const char* word, AnalysisResult* result) {
     if (strlen(word) == 0) return;
     
     result->word_count++;
@@ -422,11 +478,17 @@ void process_word(const char* word, AnalysisResult* result) {
     
     if (strlen(normalized) == 0) return;
     
-    if (is_stop_word(normalized)) {
+    if (stopwords != NULL && stopwords_contains(stopwords, normalized)) {
         return;
     }
     
-    hash_table_insert(&result->hash_table, normalized);
+    add_word_count(result, normalized, 1);
+}
+
+void process_word(const char* word, AnalysisResult* result) {
+    AnalyzerDictionaries* dicts = dictionaries_acquire();
+    count_word(dicts ? &dicts->stopwords : NULL, word, result);
+    dictionaries_release(dicts);
 }
 
 void calculate_advanced_stats(const char* text, AdvancedStats* stats) {
@@ -461,6 +523,7 @@ void calculate_advanced_stats(const char* text, AdvancedStats* stats) {
         if (*ptr == '.' || *ptr == '!' || *ptr == '?') {
             stats->total_sentences++;
             stats->total_words += current_sentence_words;
+            stats->sentence_words += current_sentence_words;
             
             if (current_sentence_words > stats->longest_sentence) {
                 stats->longest_sentence = current_sentence_words;
@@ -483,95 +546,390 @@ AnalysisResult analyze_text(const char* text) {
     AnalysisResult result = {0};
     if (text == NULL) return result;
     
-    hash_table_init(&result.hash_table);
+    // all state lives in the stream, only the dictionaries are shared
+    AnalysisStream stream;
+    analysis_stream_init(&stream);
+    analysis_stream_feed(&stream, text, strlen(text));
+    return analysis_stream_finish(&stream);
+}
+
+//  STREAMING ANALYSIS 
+
+void analysis_stream_init(AnalysisStream* stream) {
+    memset(stream, 0, sizeof(AnalysisStream));
+    stream->result.hash_table = hash_table_create();
+    stream->result.sketch = word_sketch_create();
+    stream->result.spill = (stream->result.sketch == NULL) ? word_spill_create() : NULL;
+    stream->result.advanced_stats.shortest_sentence = 10000;
+    
+    // the stream keeps the dictionaries it started with, even across a reload
+    stream->dict = dictionaries_acquire();
+    stream->phrase_slots = stream->dict ? stream->dict->toxic.count : 0;
+    if (stream->phrase_slots > 0) {
+        stream->phrase_hits = (int*)calloc(stream->phrase_slots, sizeof(int));
+    }
+}
+
+// Move a long-running stream to the latest dictionaries, hits counted so far
+// are carried over for phrases that are still in the dictionary
+int analysis_stream_refresh_dictionaries(AnalysisStream* stream) {
+    AnalyzerDictionaries* latest = dictionaries_acquire();
+    if (latest == NULL || latest == stream->dict) {
+        dictionaries_release(latest);
+        return 0;
+    }
+    
+    int* hits = NULL;
+    if (latest->toxic.count > 0) {
+        hits = (int*)calloc(latest->toxic.count, sizeof(int));
+        if (hits == NULL) {
+            dictionaries_release(latest);
+            return 0;
+        }
+    }
+    for (int i = 0; i < stream->phrase_slots && stream->phrase_hits && hits; i++) {
+        if (stream->phrase_hits[i] > 0) {
+            const char* lower = stream->dict->toxic.lower[i];
+            int len = strlen(lower);
+            int j = dict_find(&latest->toxic, lower, len, hash_string(lower, len));
+            if (j >= 0) hits[j] += stream->phrase_hits[i];
+        }
+    }
+    
+    free(stream->phrase_hits);
+    dictionaries_release(stream->dict);
+    stream->phrase_hits = hits;
+    stream->phrase_slots = latest->toxic.count;
+    stream->dict = latest;
+    return 1;
+}
+
+static void stream_end_word(AnalysisStream* stream) {
+    if (stream->in_word && stream->word_len > 0) {
+        stream->word_buf[stream->word_len] = '\0';
+        count_word(stream->dict ? &stream->dict->stopwords : NULL, stream->word_buf, &stream->result);
+    }
+    stream->in_word = 0;
+    stream->word_len = 0;
+}
+
+static void stream_end_line(AnalysisStream* stream) {
+    // the hit list brings its own match buffer when nobody else asked for one
+    PhraseIdList* matched = stream->line_phrases;
+    if (matched == NULL && stream->hit_list != NULL) matched = &stream->hit_list->line;
+
+    stream->line_number++;
+    memset(stream->line_severity, 0, sizeof(stream->line_severity));
+    if (matched) matched->count = 0;
+    if (stream->phrase_hits != NULL && stream->line_len > 0) {
+        stream->line[stream->line_len] = '\0';
+        stream->result.toxic_word_count += count_phrases_in_line(&stream->dict->toxic, stream->line,
+                                                                 stream->phrase_hits, stream->line_severity,
+                                                                 matched);
+        if (stream->hit_list != NULL) {
+            hit_list_add_line(stream->hit_list, &stream->dict->toxic, matched,
+                              stream->line_offset, stream->line_number);
+        }
+    }
+    stream->line_words = (int)(stream->result.word_count - stream->line_start_words);
     
-    char buffer[MAX_WORD_LEN];
-    const char* p = text;
-    int in_word = 0;
-    int word_len = 0;
+    if (stream->on_line) {
+        stream->on_line(stream, stream->callback_data);
+    }
+    stream->line_len = 0;
+    stream->line_start_words = stream->result.word_count;
+}
+
+// Same tokenizer as the whole-text analysis, but all state lives in the stream
+// so a text can be fed in any number of chunks
+void analysis_stream_feed(AnalysisStream* stream, const char* data, size_t len) {
+    AnalysisResult* result = &stream->result;
+    AdvancedStats* stats = &result->advanced_stats;
     
-    while (*p) {
-        result.char_count++;
+    for (size_t i = 0; i < len; i++) {
+        unsigned char c = (unsigned char)data[i];
+        result->char_count++;
         
-        if (*p == '.' || *p == '!' || *p == '?') {
-            result.sentence_count++;
+        // an apostrophe only stays in the word if a letter follows
+        if (stream->pending_quote) {
+            stream->pending_quote = 0;
+            if (isalnum(c) && stream->word_len < MAX_WORD_LEN - 1) {
+                stream->word_buf[stream->word_len++] = '\'';
+            } else if (!isalnum(c)) {
+                stream_end_word(stream);
+            }
         }
         
-        if (*p == '\n') {
-            result.line_count++;
+        if (c == '.' || c == '!' || c == '?') {
+            result->sentence_count++;
         }
         
-        if (isalnum((unsigned char)*p)) {
-            if (!in_word) {
-                in_word = 1;
-                word_len = 0;
+        if (isalnum(c)) {
+            if (!stream->in_word) {
+                stream->in_word = 1;
+                stream->word_len = 0;
             }
-            if (word_len < MAX_WORD_LEN - 1) {
-                buffer[word_len++] = tolower((unsigned char)*p);
+            if (stream->word_len < MAX_WORD_LEN - 1) {
+                stream->word_buf[stream->word_len++] = tolower(c);
             }
+        } else if (c == '\'' && stream->in_word) {
+            stream->pending_quote = 1;
         } else {
-            if (*p == '\'' && in_word && isalnum((unsigned char)*(p+1))) {
-                if (word_len < MAX_WORD_LEN - 1) {
-                    buffer[word_len++] = tolower((unsigned char)*p);
+            stream_end_word(stream);
+        }
+        
+        // sentence stats
+        if (isalnum(c)) {
+            if (!stream->in_run) {
+                stream->sentence_run_words++;
+                stream->in_run = 1;
+            }
+        } else {
+            stream->in_run = 0;
+            if (c == '.' || c == '!' || c == '?') {
+                stats->total_sentences++;
+                stats->sentence_words += stream->sentence_run_words;
+                if (stream->sentence_run_words > stats->longest_sentence) {
+                    stats->longest_sentence = stream->sentence_run_words;
+                }
+                if (stream->sentence_run_words < stats->shortest_sentence && stream->sentence_run_words > 0) {
+                    stats->shortest_sentence = stream->sentence_run_words;
                 }
-            } else {
-                if (in_word && word_len > 0) {
-                    buffer[word_len] = '\0';
-                    process_word(buffer, &result);
+                stream->sentence_run_words = 0;
+            }
+        }
+        
+        // lines for phrase detection
+        if (c == '\n') {
+            result->line_count++;
+            stream_end_line(stream);
+            stream->line_offset = stream->offset + i + 1;
+        } else if (stream->phrase_hits != NULL) {
+            if (stream->line_len + 1 >= stream->line_cap) {
+                int new_cap = (stream->line_cap == 0) ? 256 : stream->line_cap * 2;
+                char* grown = (char*)realloc(stream->line, new_cap);
+                if (grown == NULL) {
+                    stream_end_line(stream);
+                    stream->line_offset = stream->offset + i + 1;
+                    continue;
                 }
-                in_word = 0;
-                word_len = 0;
+                stream->line = grown;
+                stream->line_cap = new_cap;
             }
+            stream->line[stream->line_len++] = tolower(c);
         }
-        p++;
     }
-    
-    if (in_word && word_len > 0) {
-        buffer[word_len] = '\0';
-        process_word(buffer, &result);
+    stream->offset += len;
+}
+
+// Flush the pending word and line and build the final result. The stream
+// must not be fed again afterwards
+AnalysisResult analysis_stream_finish(AnalysisStream* stream) {
+    if (stream->pending_quote) {
+        stream->pending_quote = 0;
+        stream_end_word(stream);
+    }
+    stream_end_word(stream);
+    if (stream->line_len > 0 || stream->result.word_count > stream->line_start_words) {
+        stream_end_line(stream);
     }
     
-    hash_table_to_array(&result.hash_table, &result.word_freq, &result.unique_words);
-    wordcount = result.unique_words;
-    
-    sort_words(result.word_freq, wordcount, SORT_QUICK);
+    AnalysisResult result = stream->result;
+    result.advanced_stats.total_paragraphs = (result.line_count > 0) ? result.line_count + 1 : 1;
+    result.line_count++;
     
-    for (int i = 0; i < wordcount && i < MAX_WORDS; i++) {
-        word_array[i] = result.word_freq[i];
+    if (stream->phrase_hits != NULL) {
+        collect_detected_phrases(stream->dict, &result, stream->phrase_hits);
     }
+    finalize_analysis_result(&result);
     
-    if (result.word_count > 0) {
-        result.avg_word_length = (double)result.char_count / result.word_count;
-        if (result.sentence_count > 0) {
-            result.reading_level = (0.39 * ((double)result.word_count / result.sentence_count)) + 
-                                  (11.8 * result.avg_word_length) - 15.59;
+    free(stream->line);
+    free(stream->phrase_hits);
+    dictionaries_release(stream->dict);
+    stream->line = NULL;
+    stream->phrase_hits = NULL;
+    stream->dict = NULL;
+    return result;
+}
+
+// Free a stream that will not be finished
+void analysis_stream_free(AnalysisStream* stream) {
+    free(stream->line);
+    free(stream->phrase_hits);
+    dictionaries_release(stream->dict);
+    stream->line = NULL;
+    stream->phrase_hits = NULL;
+    stream->dict = NULL;
+    hash_table_free(stream->result.hash_table);
+    free(stream->result.hash_table);
+    stream->result.hash_table = NULL;
+    word_spill_free(stream->result.spill);
+    word_sketch_free(stream->result.sketch);
+    stream->result.spill = NULL;
+    stream->result.sketch = NULL;
+}
+
+// Build the sorted word list and derived stats from the raw counts
+void finalize_analysis_result(AnalysisResult* result) {
+    if (result->word_freq) {
+        free(result->word_freq);
+        result->word_freq = NULL;
+    }
+    // after a spill only the top words come back into memory, a sketch only
+    // knows its heavy hitters and estimates the vocabulary
+    long long vocabulary = -1;
+    if (result->hash_table == NULL) {
+        result->hash_table = hash_table_create();
+    }
+    result->ranked_words = 0;
+    if (result->hash_table != NULL) {
+        if (result->sketch != NULL) {
+            word_sketch_top(result->sketch, result->hash_table);
+            vocabulary = word_sketch_distinct(result->sketch);
+        } else if (result->spill != NULL && result->spill->run_count > 0) {
+            vocabulary = word_spill_finish(result->spill, result->hash_table, WORD_SPILL_KEEP);
+        }
+        hash_table_to_array(result->hash_table, &result->word_freq, &result->ranked_words);
+    }
+    sort_words(result->word_freq, result->ranked_words, SORT_QUICK);
+    result->unique_words = (vocabulary > result->ranked_words) ? (int)vocabulary : result->ranked_words;
+    
+    result->avg_word_length = 0.0;
+    result->reading_level = 0.0;
+    if (result->word_count > 0) {
+        result->avg_word_length = (double)result->char_count / result->word_count;
+        if (result->sentence_count > 0) {
+            result->reading_level = (0.39 * ((double)result->word_count / result->sentence_count)) + 
+                                  (11.8 * result->avg_word_length) - 15.59;
         }
     }
     
-    result.line_count++;
-    
-    calculate_advanced_stats(text, &result.advanced_stats);
-    result.advanced_stats.unique_words = result.unique_words;
-    
-    if (toxic_phrase_count > 0) {
-        detect_toxic_phrases(text, &result);
+    AdvancedStats* stats = &result->advanced_stats;
+    stats->unique_words = result->unique_words;
+    if (stats->total_sentences > 0) {
+        stats->avg_sentence_length = (double)stats->sentence_words / stats->total_sentences;
     }
     
     // Calculate toxicity ratios
-    if (result.word_count > 0) {
-        result.advanced_stats.clean_word_count = result.word_count - result.toxic_word_count;
-        result.advanced_stats.toxic_ratio = (double)result.toxic_word_count / result.word_count * 100;
-        result.advanced_stats.clean_ratio = (double)result.advanced_stats.clean_word_count / result.word_count * 100;
+    if (result->word_count > 0) {
+        stats->clean_word_count = result->word_count - result->toxic_word_count;
+        stats->toxic_ratio = (double)result->toxic_word_count / result->word_count * 100;
+        stats->clean_ratio = (double)stats->clean_word_count / result->word_count * 100;
+    }
+    stats->total_words = result->word_count;
+    
+    if (result->word_count > 0) {
+        stats->lexical_diversity = (double)result->unique_words / result->word_count;
+    } else {
+        stats->lexical_diversity = 0.0;
+    }
+}
+
+// Sum the detected phrases of part into total, both from the same dictionary
+static void merge_detected_phrases(AnalysisResult* total, const AnalysisResult* part) {
+    const ToxicDictionary* dict = &total->phrase_dict->toxic;
+    int* slots = (int*)malloc(dict->count * sizeof(int));
+    DetectedPhrase* grown = (DetectedPhrase*)realloc(total->detected_phrases,
+        (total->toxic_phrase_count + part->toxic_phrase_count) * sizeof(DetectedPhrase));
+    if (grown != NULL) total->detected_phrases = grown;
+    if (slots == NULL || grown == NULL) {
+        free(slots);
+        return;
     }
-    result.advanced_stats.total_words = result.word_count;
     
-    if (result.word_count > 0) {
-        result.advanced_stats.lexical_diversity = (double)result.unique_words / result.word_count;
+    // dictionary position -> index in the total's list
+    memset(slots, 0xff, dict->count * sizeof(int));
+    for (int i = 0; i < total->toxic_phrase_count; i++) {
+        slots[grown[i].phrase_id] = i;
+    }
+    for (int i = 0; i < part->toxic_phrase_count; i++) {
+        int id = part->detected_phrases[i].phrase_id;
+        if (slots[id] < 0) {
+            slots[id] = total->toxic_phrase_count++;
+            grown[slots[id]].phrase_id = id;
+            grown[slots[id]].count = 0;
+            total->severity_counts[dict->severity[id]]++;
+        }
+        grown[slots[id]].count += part->detected_phrases[i].count;
+    }
+    free(slots);
+}
+
+// Move the detected phrases onto a newer dictionary snapshot, matched by text
+// as analysis_stream_refresh_dictionaries does. Phrases the newer dictionary
+// no longer has are dropped
+static void rebase_detected_phrases(AnalysisResult* result, AnalyzerDictionaries* latest) {
+    AnalyzerDictionaries* old = result->phrase_dict;
+    int kept = 0;
+    memset(result->severity_counts, 0, sizeof(result->severity_counts));
+    for (int i = 0; i < result->toxic_phrase_count; i++) {
+        const char* lower = old->toxic.lower[result->detected_phrases[i].phrase_id];
+        int len = strlen(lower);
+        int id = dict_find(&latest->toxic, lower, len, hash_string(lower, len));
+        if (id < 0) continue;
+        result->detected_phrases[kept].phrase_id = id;
+        result->detected_phrases[kept].count = result->detected_phrases[i].count;
+        result->severity_counts[latest->toxic.severity[id]]++;
+        kept++;
+    }
+    result->toxic_phrase_count = kept;
+    result->phrase_dict = dictionaries_retain(latest);
+    dictionaries_release(old);
+}
+
+// Add the raw counts of part into total, call finalize_analysis_result after the last merge
+void merge_analysis_results(AnalysisResult* total, const AnalysisResult* part) {
+    total->word_count += part->word_count;
+    total->char_count += part->char_count;
+    total->line_count += part->line_count;
+    total->sentence_count += part->sentence_count;
+    total->toxic_word_count += part->toxic_word_count;
+    
+    if (total->sketch != NULL && part->sketch != NULL && word_sketch_merge(total->sketch, part->sketch)) {
+        // sketches of the same shape add up
+    } else if (part->ranked_words < part->unique_words && part->spill != NULL) {
+        word_spill_each(part->spill, add_spilled_word, total);
     } else {
-        result.advanced_stats.lexical_diversity = 0.0;
+        for (int i = 0; i < part->ranked_words; i++) {
+            add_word_count(total, part->word_freq[i]->word, part->word_freq[i]->frequency);
+        }
     }
     
-    return result;
+    AdvancedStats* stats = &total->advanced_stats;
+    const AdvancedStats* other = &part->advanced_stats;
+    if (stats->total_paragraphs == 0) {  // empty total, take the first file's values
+        stats->shortest_sentence = other->shortest_sentence;
+    } else if (other->shortest_sentence < stats->shortest_sentence) {
+        stats->shortest_sentence = other->shortest_sentence;
+    }
+    if (other->longest_sentence > stats->longest_sentence) {
+        stats->longest_sentence = other->longest_sentence;
+    }
+    stats->total_sentences += other->total_sentences;
+    stats->total_paragraphs += other->total_paragraphs;
+    stats->sentence_words += other->sentence_words;
+    
+    // same phrase in several files is one detected phrase with summed count
+    if (part->toxic_phrase_count == 0) return;
+    if (total->phrase_dict == NULL) {
+        total->phrase_dict = dictionaries_retain(part->phrase_dict);
+    } else if (part->phrase_dict != total->phrase_dict &&
+               part->phrase_dict->generation > total->phrase_dict->generation) {
+        // part saw a dictionary reload, phrases it added must not be dropped
+        rebase_detected_phrases(total, part->phrase_dict);
+    }
+    if (part->phrase_dict == total->phrase_dict) {
+        merge_detected_phrases(total, part);
+        return;
+    }
+    for (int i = 0; i < part->toxic_phrase_count; i++) {
+        // analyzed before a dictionary reload, matched by text
+        int known = total->toxic_phrase_count;
+        int slot = add_detected_phrase(total, detected_phrase_text(part, i), part->detected_phrases[i].count);
+        if (slot >= known) {
+            total->severity_counts[detected_phrase_severity(total, slot)]++;
+        }
+    }
 }
 
 //  DISPLAY FUNCTIONS 
@@ -582,22 +940,26 @@ void show_most_toxic_words(const AnalysisResult* result, int n) {
         return;
     }
     
-    ToxicPhrase sorted_toxic[50];
+    // sort indexes, not the phrases, most hits first and ties in list order
     int total_count = result->toxic_phrase_count;
-    if (total_count > 50) total_count = 50;
-    
+    int* sorted_toxic = (int*)malloc(total_count * sizeof(int));
+    if (sorted_toxic == NULL) {
+        log_message(LOG_LEVEL_ERROR, "Error: Memory allocation failed\n");
+        return;
+    }
     for (int i = 0; i < total_count; i++) {
-        sorted_toxic[i] = result->detected_toxic_phrases[i];
+        sorted_toxic[i] = i;
     }
     
-    for (int i = 0; i < total_count - 1; i++) {
-        for (int j = 0; j < total_count - i - 1; j++) {
-            if (sorted_toxic[j].count < sorted_toxic[j + 1].count) {
-                ToxicPhrase temp = sorted_toxic[j];
-                sorted_toxic[j] = sorted_toxic[j + 1];
-                sorted_toxic[j + 1] = temp;
-            }
+    for (int i = 1; i < total_count; i++) {
+        int index = sorted_toxic[i];
+        int count = result->detected_phrases[index].count;
+        int j = i - 1;
+        while (j >= 0 && result->detected_phrases[sorted_toxic[j]].count < count) {
+            sorted_toxic[j + 1] = sorted_toxic[j];
+            j--;
         }
+        sorted_toxic[j + 1] = index;
     }
     
     int show_count = (total_count < n) ? total_count : n;
@@ -609,11 +971,12 @@ void show_most_toxic_words(const AnalysisResult* result, int n) {
     for (int i = 0; i < show_count; i++) {
         printf("%-5d %-18s %-11s %d\n", 
                i + 1, 
-               sorted_toxic[i].text,
-               get_severity_name(sorted_toxic[i].severity),
-               sorted_toxic[i].count);
+               detected_phrase_text(result, sorted_toxic[i]),
+               get_severity_name(detected_phrase_severity(result, sorted_toxic[i])),
+               result->detected_phrases[sorted_toxic[i]].count);
     }
     printf("-----------------------------------------------\n");
+    free(sorted_toxic);
 }
 
 void print_toxicity_report(const AnalysisResult* result) {
@@ -633,7 +996,7 @@ void print_toxicity_report(const AnalysisResult* result) {
     double toxicity_ratio = (double)result->toxic_phrase_count / result->word_count * 100;
     printf("Toxicity density: %.2f%%\n", toxicity_ratio);
     
-    printf("Word Composition:   %d toxic (%.1f%%) / %d clean (%.1f%%)\n",
+    printf("Word Composition:   %d toxic (%.1f%%) / %lld clean (%.1f%%)\n",
            result->toxic_word_count, result->advanced_stats.toxic_ratio,
            result->advanced_stats.clean_word_count, result->advanced_stats.clean_ratio);
     
@@ -643,8 +1006,8 @@ void print_toxicity_report(const AnalysisResult* result) {
     printf("\nDetected toxic phrases:\n");
     for (int i = 0; i < result->toxic_phrase_count; i++) {
         printf("  %s [%s]\n", 
-               result->detected_toxic_phrases[i].text,
-               get_severity_name(result->detected_toxic_phrases[i].severity));
+               detected_phrase_text(result, i),
+               get_severity_name(detected_phrase_severity(result, i)));
     }
     
     printf("\nRISK ASSESSMENT: ");
@@ -667,7 +1030,7 @@ void print_advanced_stats(const AdvancedStats* stats) {
         printf("Vocabulary Diversity: 0.000\n");
     }
     
-    printf("Unique Words:         %d / %d\n", stats->unique_words, stats->total_words);
+    printf("Unique Words:         %d / %lld\n", stats->unique_words, stats->total_words);
     printf("Average Sentence:     %.1f words\n", stats->avg_sentence_length);
     printf("Longest Sentence:     %d words\n", stats->longest_sentence);
     printf("Shortest Sentence:    %d words\n", stats->shortest_sentence);
@@ -676,15 +1039,15 @@ void print_advanced_stats(const AdvancedStats* stats) {
 
 void print_analysis_report(const AnalysisResult* result) {
     printf("\n=== TEXT ANALYSIS ===\n");
-    printf("Total characters: %d\n", result->char_count);
-    printf("Total words:      %d\n", result->word_count);
+    printf("Total characters: %lld\n", result->char_count);
+    printf("Total words:      %lld\n", result->word_count);
     printf("Total sentences:  %d\n", result->sentence_count);
     printf("Unique words:     %d\n", result->unique_words);
     printf("Reading level:    %.2f\n", result->reading_level);
     
-    if (wordcount > 0) {
+    if (result->ranked_words > 0) {
         printf("\nTop 3 words: ");
-        int top_n = (wordcount < 3) ? wordcount : 3;
+        int top_n = (result->ranked_words < 3) ? result->ranked_words : 3;
         for (int i = 0; i < top_n; i++) {
             printf("%s(%d) ", result->word_freq[i]->word, result->word_freq[i]->frequency);
         }
@@ -693,7 +1056,10 @@ void print_analysis_report(const AnalysisResult* result) {
     
     print_advanced_stats(&result->advanced_stats);
     
-    if (toxic_phrase_count > 0) {
+    AnalyzerDictionaries* dicts = dictionaries_acquire();
+    int detection_enabled = (dicts != NULL && dicts->toxic.count > 0);
+    dictionaries_release(dicts);
+    if (detection_enabled) {
         print_toxicity_report(result);
         if (result->toxic_phrase_count > 0) {
             show_most_toxic_words(result, 5);
@@ -767,7 +1133,7 @@ void get_top_words(int n, const AnalysisResult* result) {
         return;
     }
     
-    if (result == NULL || result->unique_words == 0 || result->word_freq == NULL) {
+    if (result == NULL || result->ranked_words == 0 || result->word_freq == NULL) {
         printf("No words available for analysis. Please analyze a text file first.\n");
         return;
     }
@@ -787,39 +1153,39 @@ void get_top_words(int n, const AnalysisResult* result) {
     }
     getchar();
     
-    int display_count = (n > result->unique_words) ? result->unique_words : n;
+    int display_count = (n > result->ranked_words) ? result->ranked_words : n;
     
-    WordNode** temp_array = (WordNode**)malloc(result->unique_words * sizeof(WordNode*));
+    WordNode** temp_array = (WordNode**)malloc(result->ranked_words * sizeof(WordNode*));
     if (temp_array == NULL) {
         printf(" Memory allocation failed\n");
         return;
     }
     
-    for (int i = 0; i < result->unique_words; i++) {
+    for (int i = 0; i < result->ranked_words; i++) {
         temp_array[i] = result->word_freq[i];
     }
     
     switch (choice) {
         case 1:
-            bubble_sort(temp_array, result->unique_words);
+            bubble_sort(temp_array, result->ranked_words);
             printf("\n=== TOP %d WORDS (Bubble Sort) ===\n", display_count);
             break;
         case 2:
-            quick_sort(temp_array, 0, result->unique_words - 1);
+            quick_sort(temp_array, 0, result->ranked_words - 1);
             printf("\n=== TOP %d WORDS (Quick Sort) ===\n", display_count);
             break;
         case 3:
-            merge_sort(temp_array, 0, result->unique_words - 1);
+            merge_sort(temp_array, 0, result->ranked_words - 1);
             printf("\n=== TOP %d WORDS (Merge Sort) ===\n", display_count);
             break;
         case 4:
-            compare_sorting_algorithms(temp_array, result->unique_words);
-            quick_sort(temp_array, 0, result->unique_words - 1);
+            compare_sorting_algorithms(temp_array, result->ranked_words);
+            quick_sort(temp_array, 0, result->ranked_words - 1);
             printf("\n=== TOP %d WORDS (After Comparison) ===\n", display_count);
             break;
         default:
             printf("Invalid choice. Using Quick Sort.\n");
-            quick_sort(temp_array, 0, result->unique_words - 1);
+            quick_sort(temp_array, 0, result->ranked_words - 1);
             printf("\n=== TOP %d WORDS (Quick Sort) ===\n", display_count);
             break;
     }
@@ -836,7 +1202,7 @@ void get_top_words(int n, const AnalysisResult* result) {
     printf("------------------------------------\n");
     
     int total_occurrences = 0;
-    for (int i = 0; i < result->unique_words; i++) {
+    for (int i = 0; i < result->ranked_words; i++) {
         total_occurrences += result->word_freq[i]->frequency;
     }
     
@@ -855,161 +1221,6 @@ void get_top_words(int n, const AnalysisResult* result) {
     free(temp_array);
 }
 
-// FILE OUTPUT FUNCTIONS 
-
-void save_toxicity_report(const char* filename, const AnalysisResult* result) {
-    FILE* file = fopen(filename, "w");
-    if (file == NULL) {
-        printf(" Error: Cannot create toxicity report file\n");
-        return;
-    }
-    
-    fprintf(file, "TOXICITY ANALYSIS REPORT\n");
-    fprintf(file, "Generated on: %s", ctime(&(time_t){time(NULL)}));
-    fprintf(file, "============================================\n\n");
-    
-    fprintf(file, "TEXT STATISTICS:\n");
-    fprintf(file, "Total words:        %d\n", result->word_count);
-    fprintf(file, "Total sentences:    %d\n", result->sentence_count);
-    fprintf(file, "Text length:        %d characters\n\n", result->char_count);
-    
-    fprintf(file, "TOXICITY FINDINGS:\n");
-    fprintf(file, "Total toxic phrases: %d\n", result->toxic_phrase_count);
-    fprintf(file, "Severe: %d, Moderate: %d, Mild: %d\n", 
-            result->severity_counts[SEVERITY_SEVERE],
-            result->severity_counts[SEVERITY_MODERATE],
-            result->severity_counts[SEVERITY_MILD]);
-    
-    double toxicity_ratio = (double)result->toxic_phrase_count / result->word_count * 100;
-    fprintf(file, "Toxicity density:    %.2f%%\n\n", toxicity_ratio);
-    
-    fprintf(file, "DETECTED TOXIC PHRASES:\n");
-    for (int i = 0; i < result->toxic_phrase_count; i++) {
-        fprintf(file, "%2d. %s [%s]\n", 
-                i + 1,
-                result->detected_toxic_phrases[i].text,
-                get_severity_name(result->detected_toxic_phrases[i].severity));
-    }
-    
-    fclose(file);
-    printf(" Toxicity report saved to: %s\n", filename);
-}
-
-void save_analysis_report(const char* filename, AnalysisResult* result) {
-    FILE* file = fopen(filename, "w");
-    if (file == NULL) {
-        printf(" Error: Cannot create analysis report\n");
-        return;
-    }
-    
-    fprintf(file, "TEXT ANALYSIS REPORT\n");
-    fprintf(file, "====================\n\n");
-    
-    fprintf(file, "BASIC STATISTICS:\n");
-    fprintf(file, "Total characters: %d\n", result->char_count);
-    fprintf(file, "Total words:      %d\n", result->word_count);
-    fprintf(file, "Total sentences:  %d\n", result->sentence_count);
-    fprintf(file, "Unique words:     %d\n", result->unique_words);
-    fprintf(file, "Reading level:    %.2f\n\n", result->reading_level);
-
-    fprintf(file, "TOXICITY RATIO ANALYSIS:\n");
-    fprintf(file, "Toxic words:      %d (%.1f%%)\n", 
-            result->toxic_word_count, result->advanced_stats.toxic_ratio);
-    fprintf(file, "Clean words:      %d (%.1f%%)\n",
-            result->advanced_stats.clean_word_count, result->advanced_stats.clean_ratio);
-    fprintf(file, "Total words:      %d\n\n", result->word_count);
-    
-    fprintf(file, "TOP 10 WORDS:\n");
-    int top_n = (result->unique_words < 10) ? result->unique_words : 10;
-    for (int i = 0; i < top_n; i++) {
-        fprintf(file, "%2d. %-15s (%d)\n", i+1, result->word_freq[i]->word, result->word_freq[i]->frequency);
-    }
-    
-    fclose(file);
-    printf(" Analysis report saved to: %s\n", filename);
-}
-
-//  ADDITIONAL OUTPUT FORMATS 
-
-void save_analysis_csv(const char* filename, const AnalysisResult* result) {
-    FILE* file = fopen(filename, "w");
-    if (file == NULL) {
-        printf(" Error: Cannot create CSV file: %s\n", filename);
-        return;
-    }
-    
-    fprintf(file, "Metric,Value\n");
-    fprintf(file, "Total Characters,%d\n", result->char_count);
-    fprintf(file, "Total Words,%d\n", result->word_count);
-    fprintf(file, "Total Sentences,%d\n", result->sentence_count);
-    fprintf(file, "Total Lines,%d\n", result->line_count);
-    fprintf(file, "Unique Words,%d\n", result->unique_words);
-    fprintf(file, "Average Word Length,%.2f\n", result->avg_word_length);
-    fprintf(file, "Reading Level,%.2f\n", result->reading_level);
-    fprintf(file, "Lexical Diversity,%.3f\n", result->advanced_stats.lexical_diversity);
-    fprintf(file, "Average Sentence Length,%.1f\n", result->advanced_stats.avg_sentence_length);
-    fprintf(file, "Paragraph Count,%d\n", result->advanced_stats.total_paragraphs);
-    
-    if (result->toxic_phrase_count > 0) {
-        fprintf(file, "Total Toxic Phrases,%d\n", result->toxic_phrase_count);
-        fprintf(file, "Severe Toxic Phrases,%d\n", result->severity_counts[SEVERITY_SEVERE]);
-        fprintf(file, "Moderate Toxic Phrases,%d\n", result->severity_counts[SEVERITY_MODERATE]);
-        fprintf(file, "Mild Toxic Phrases,%d\n", result->severity_counts[SEVERITY_MILD]);
-        fprintf(file, "Toxicity Score,%d\n", calculate_toxicity_score(result));
-        fprintf(file, "Toxicity Density,%.2f%%\n", (double)result->toxic_phrase_count / result->word_count * 100);
-    }
-    
-    fclose(file);
-    printf(" Analysis CSV saved to: %s\n", filename);
-}
-
-void save_word_frequency_csv(const char* filename, WordNode** words, int count) {
-    FILE* file = fopen(filename, "w");
-    if (file == NULL) {
-        printf(" Error: Cannot create CSV file: %s\n", filename);
-        return;
-    }
-    
-    fprintf(file, "Rank,Word,Frequency,Percentage\n");
-    
-    int total_occurrences = 0;
-    for (int i = 0; i < count; i++) {
-        total_occurrences += words[i]->frequency;
-    }
-    
-    for (int i = 0; i < count && i < 100; i++) {
-        double percentage = (double)words[i]->frequency / total_occurrences * 100;
-        fprintf(file, "%d,%s,%d,%.2f%%\n", 
-                i + 1, 
-                words[i]->word, 
-                words[i]->frequency, 
-                percentage);
-    }
-    
-    fclose(file);
-    printf(" Word frequency CSV saved to: %s\n", filename);
-}
-
-void save_toxicity_csv(const char* filename, const AnalysisResult* result) {
-    FILE* file = fopen(filename, "w");
-    if (file == NULL) {
-        printf(" Error: Cannot create CSV file: %s\n", filename);
-        return;
-    }
-    
-    fprintf(file, "Rank,Toxic Phrase,Severity\n");
-    
-    for (int i = 0; i < result->toxic_phrase_count; i++) {
-        fprintf(file, "%d,%s,%s\n", 
-                i + 1,
-                result->detected_toxic_phrases[i].text,
-                get_severity_name(result->detected_toxic_phrases[i].severity));
-    }
-    
-    fclose(file);
-    printf(" Toxicity CSV saved to: %s\n", filename);
-}
-
 //  CLEANUP FUNCTION 
 
 void cleanup_analyzer(AnalysisResult* result) {
@@ -1017,7 +1228,17 @@ void cleanup_analyzer(AnalysisResult* result) {
         free(result->word_freq);
     }
     if (result) {
-        hash_table_free(&result->hash_table);
+        hash_table_free(result->hash_table);
+        free(result->hash_table);
+        free(result->detected_phrases);
+        dictionaries_release(result->phrase_dict);
+        word_spill_free(result->spill);
+        word_sketch_free(result->sketch);
+        result->hash_table = NULL;
+        result->detected_phrases = NULL;
+        result->phrase_dict = NULL;
+        result->spill = NULL;
+        result->sketch = NULL;
     }
 }
 //  ADDITIONAL OUTPUT AND COMPARISON FUNCTIONS 
@@ -1030,8 +1251,8 @@ void print_results_table(const AnalysisResult* result) {
     printf("┌────────────────────────────┬──────────┐\n");
     printf("│ Metric                     │ Value    │\n");
     printf("├────────────────────────────┼──────────┤\n");
-    printf("│ Total Characters           │ %8d │\n", result->char_count);
-    printf("│ Total Words                │ %8d │\n", result->word_count);
+    printf("│ Total Characters           │ %8lld │\n", result->char_count);
+    printf("│ Total Words                │ %8lld │\n", result->word_count);
     printf("│ Total Sentences            │ %8d │\n", result->sentence_count);
     printf("│ Unique Words               │ %8d │\n", result->unique_words);
     printf("│ Average Word Length        │ %8.2f │\n", result->avg_word_length);
@@ -1074,8 +1295,8 @@ void print_results_table(const AnalysisResult* result) {
             for (int i = 0; i < result->toxic_phrase_count && i < 10; i++) {
                 printf("│ %4d │ %-18s │ %-8s │\n", 
                        i + 1,
-                       result->detected_toxic_phrases[i].text,
-                       get_severity_name(result->detected_toxic_phrases[i].severity));
+                       detected_phrase_text(result, i),
+                       get_severity_name(detected_phrase_severity(result, i)));
             }
             printf("└──────┴────────────────────┴──────────┘\n");
         }
@@ -1084,104 +1305,13 @@ void print_results_table(const AnalysisResult* result) {
     }
 }
 
-void save_comprehensive_report(const char* base_filename, const AnalysisResult* result) {
-    char analysis_csv[100], word_csv[100], toxicity_csv[100], full_report[100];
-    
-    // Generate filenames
-    snprintf(analysis_csv, sizeof(analysis_csv), "%s_analysis.csv", base_filename);
-    snprintf(word_csv, sizeof(word_csv), "%s_words.csv", base_filename);
-    snprintf(toxicity_csv, sizeof(toxicity_csv), "%s_toxicity.csv", base_filename);
-    snprintf(full_report, sizeof(full_report), "%s_full.txt", base_filename);
-    
-    // Save reports in various formats
-    save_analysis_csv(analysis_csv, result);
-    save_word_frequency_csv(word_csv, result->word_freq, result->unique_words);
-    
-    if (result->toxic_phrase_count > 0) {
-        save_toxicity_csv(toxicity_csv, result);
-    }
-    
-    // Save full text report
-    FILE* file = fopen(full_report, "w");
-    if (file) {
-        time_t now = time(NULL);
-        fprintf(file, "COMPREHENSIVE TEXT ANALYSIS REPORT\n");
-        fprintf(file, "Generated on: %s", ctime(&now));
-        fprintf(file, "Analysis ID: %s\n\n", base_filename);
-        
-        fprintf(file, "Output Files:\n");
-        fprintf(file, "- Analysis CSV: %s\n", analysis_csv);
-        fprintf(file, "- Word Frequency CSV: %s\n", word_csv);
-        if (result->toxic_phrase_count > 0) {
-            fprintf(file, "- Toxicity CSV: %s\n", toxicity_csv);
-        }
-        fprintf(file, "\n");
-        
-        // Basic stats
-        fprintf(file, "BASIC STATISTICS:\n");
-        fprintf(file, "Total characters: %d\n", result->char_count);
-        fprintf(file, "Total words: %d\n", result->word_count);
-        fprintf(file, "Total sentences: %d\n", result->sentence_count);
-        fprintf(file, "Unique words: %d\n", result->unique_words);
-        fprintf(file, "Average word length: %.2f\n", result->avg_word_length);
-        fprintf(file, "Reading level: %.2f\n\n", result->reading_level);
-        
-        // Advanced stats
-        fprintf(file, "ADVANCED STATISTICS:\n");
-        fprintf(file, "Lexical diversity: %.1f%%\n", result->advanced_stats.lexical_diversity * 100);
-        fprintf(file, "Average sentence length: %.1f\n", result->advanced_stats.avg_sentence_length);
-        fprintf(file, "Paragraph count: %d\n\n", result->advanced_stats.total_paragraphs);
-        
-        // Word frequency
-        fprintf(file, "TOP 20 WORDS:\n");
-        int top_n = (result->unique_words < 20) ? result->unique_words : 20;
-        for (int i = 0; i < top_n; i++) {
-            fprintf(file, "%2d. %-15s (%d occurrences)\n", 
-                    i + 1, result->word_freq[i]->word, result->word_freq[i]->frequency);
-        }
-        fprintf(file, "\n");
-        
-        // Toxicity stats
-        if (result->toxic_phrase_count > 0) {
-            fprintf(file, "TOXICITY ANALYSIS:\n");
-            fprintf(file, "Total toxic phrases: %d\n", result->toxic_phrase_count);
-            fprintf(file, "Severe: %d, Moderate: %d, Mild: %d\n", 
-                    result->severity_counts[SEVERITY_SEVERE],
-                    result->severity_counts[SEVERITY_MODERATE],
-                    result->severity_counts[SEVERITY_MILD]);
-            fprintf(file, "Toxicity score: %d/100\n\n", calculate_toxicity_score(result));
-            
-            fprintf(file, "DETECTED TOXIC PHRASES:\n");
-            for (int i = 0; i < result->toxic_phrase_count; i++) {
-                fprintf(file, "%2d. %s [%s]\n", 
-                        i + 1,
-                        result->detected_toxic_phrases[i].text,
-                        get_severity_name(result->detected_toxic_phrases[i].severity));
-            }
-        } else {
-            fprintf(file, "TOXICITY ANALYSIS: No toxic content detected\n");
-        }
-        
-        fclose(file);
-        printf(" Comprehensive report saved to: %s\n", full_report);
-    }
-    
-    printf("\n Generated structured outputs:\n");
-    printf("   - %s (Analysis CSV)\n", analysis_csv);
-    printf("   - %s (Word frequency CSV)\n", word_csv);
-    if (result->toxic_phrase_count > 0) {
-        printf("   - %s (Toxicity CSV)\n", toxicity_csv);
-    }
-    printf("   - %s (Full report)\n", full_report);
-}
-
 void print_word_frequency_chart(const AnalysisResult* result, int top_n) {
-    if (result->unique_words == 0) {
+    if (result->ranked_words == 0) {
         printf("No words available for chart.\n");
         return;
     }
     
-    int display_count = (top_n > result->unique_words) ? result->unique_words : top_n;
+    int display_count = (top_n > result->ranked_words) ? result->ranked_words : top_n;
     
     // Find max frequency for scaling
     int max_frequency = result->word_freq[0]->frequency;
@@ -1250,8 +1380,8 @@ void compare_results(const AnalysisResult* result1, const AnalysisResult* result
     printf("%-25s %12s %12s %12s\n", "Metric", "File 1", "File 2", "Difference");
     printf("-------------------------------------------\n");
     
-    int word_diff = result2->word_count - result1->word_count;
-    printf("%-25s %12d %12d %12d\n", "Word Count", 
+    long long word_diff = result2->word_count - result1->word_count;
+    printf("%-25s %12lld %12lld %12lld\n", "Word Count", 
            result1->word_count, result2->word_count, word_diff);
     
     int unique_diff = result2->unique_words - result1->unique_words;
@@ -1391,7 +1521,7 @@ void save_comparison_report(const char* filename, const AnalysisResult* result1,
     fprintf(file, "%-20s | %12s | %12s | %10s\n", "Metric", "File 1", "File 2", "Diff");
     fprintf(file, "-------------------------------------------------\n");
     
-    fprintf(file, "%-20s | %12d | %12d | %10d\n", "Total Words", 
+    fprintf(file, "%-20s | %12lld | %12lld | %10lld\n", "Total Words", 
             result1->word_count, result2->word_count, 
             result2->word_count - result1->word_count);
     
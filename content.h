@@ -1,16 +1,14 @@
 #ifndef TEXT_ANALYZER_H
 #define TEXT_ANALYZER_H
 #include <time.h>
+#include <stddef.h>
 #define MAX_WORDS 10000
 #define MAX_WORD_LEN 50
 #define MAX_PHRASE_LEN 100
 #define MAX_SEVERITY_LEVELS 3
-#define MAX_TOXIC_PHRASES 1000
 #define HASH_TABLE_SIZE 10007  // prime number reduce hash collisions
-#define MAX_STOPWORDS 1000
 #define MAX_WORD_LEN 50
 
-void init_stopwords();
 // sorting algorithm types
 typedef enum {
     SORT_BUBBLE = 0,
@@ -33,7 +31,7 @@ typedef struct {
 
 // asvanced stats struct
 typedef struct {
-    int total_words;
+    long long total_words;
     int unique_words;
     int total_sentences;
     int total_paragraphs;
@@ -42,9 +40,10 @@ typedef struct {
     double avg_word_length;
     int longest_sentence;
     int shortest_sentence;
+    int sentence_words;         // words inside terminated sentences
     double toxic_ratio;          
     double clean_ratio;            
-    int clean_word_count; 
+    long long clean_word_count; 
 } AdvancedStats;
 
 // toxicity severity levels
@@ -54,24 +53,26 @@ typedef enum {
     SEVERITY_SEVERE
 } ToxicitySeverity;
 
-// toxic phrase struct
+// detected toxic phrase, text and severity come from the result's dictionary
 typedef struct {
-    char text[MAX_PHRASE_LEN];
-    ToxicitySeverity severity;
+    int phrase_id;              // position in phrase_dict
     int count;
-} ToxicPhrase;
+} DetectedPhrase;
 
 // analysis result st
 typedef struct {
-    int word_count;
-    int char_count;
+    long long word_count;   // 64-bit, a multi-gigabyte log passes 2^31 characters
+    long long char_count;
     int line_count;
     int sentence_count;
     int unique_words;
     double avg_word_length;
     double reading_level;
     WordNode** word_freq;  // change to array for sort
-    HashTable hash_table;  // new hash table
+    int ranked_words;      // entries in word_freq, fewer than unique_words after a spill
+    HashTable* hash_table;  // word counts, see hash_table_create
+    struct WordSpill* spill;  // word counts written to disk, see spill.h
+    struct WordSketch* sketch;  // approximate word counts instead of the table, see sketch.h
     
     // advanced stats
     AdvancedStats advanced_stats;
@@ -79,22 +80,72 @@ typedef struct {
     // toxicity stats
     int toxic_phrase_count;
     int severity_counts[MAX_SEVERITY_LEVELS];
-    ToxicPhrase detected_toxic_phrases[50];
+    DetectedPhrase* detected_phrases;   // toxic_phrase_count entries
+    struct AnalyzerDictionaries* phrase_dict;   // held while the result lives
     int toxic_word_count;           // toxic word count
     double lexical_diversity;       // diversity
     double avg_sentence_length;     // average length
     double sentiment_score;         // mood score
 } AnalysisResult;
 
+struct AnalyzerDictionaries;
+
+// dictionary positions matched on one line, in match order
+typedef struct {
+    int* ids;
+    int* starts;                // byte in the line where each match begins
+    int count;
+    int capacity;
+} PhraseIdList;
+
+struct HitList;
+
+// streaming analysis state, lets a text be fed in chunks and resumed later
+typedef struct AnalysisStream {
+    AnalysisResult result;      // raw counts so far
+    char word_buf[MAX_WORD_LEN];
+    int word_len;
+    int in_word;
+    int pending_quote;          // apostrophe waiting for the next char
+    int in_run;                 // inside an alnum run (sentence stats)
+    int sentence_run_words;     // words in the unterminated sentence
+    char* line;                 // current lowercased line for phrase detection
+    int line_len;
+    int line_cap;
+    int* phrase_hits;           // hits per dictionary phrase
+    int phrase_slots;
+    long long offset;           // bytes fed so far
+    struct AnalyzerDictionaries* dict;  // snapshot used for this stream
+    
+    // per-line hook, called after each line has been matched
+    long long line_start_words;
+    int line_words;                         // words on the finished line
+    int line_severity[MAX_SEVERITY_LEVELS]; // phrase hits on the finished line
+    PhraseIdList* line_phrases;             // when set, filled with the line's matches
+    long long line_offset;                  // byte where the current line starts
+    long long line_number;                  // lines finished so far
+    struct HitList* hit_list;               // when set, every match is recorded, see hits.h
+    void (*on_line)(struct AnalysisStream* stream, void* data);
+    void* callback_data;
+} AnalysisStream;
+
 // basic function
 void init_analyzer(void);
 AnalysisResult analyze_text(const char* text);
 void print_analysis_report(const AnalysisResult* result);
 void get_top_words(int n, const AnalysisResult* result);
-void save_analysis_report(const char* filename, AnalysisResult* result);
 int is_stop_word(const char* word);
 void process_word(const char* word, AnalysisResult* result);
 void cleanup_analyzer(AnalysisResult* result);
+void finalize_analysis_result(AnalysisResult* result);
+void merge_analysis_results(AnalysisResult* total, const AnalysisResult* part);
+
+// streaming analysis
+void analysis_stream_init(AnalysisStream* stream);
+void analysis_stream_feed(AnalysisStream* stream, const char* data, size_t len);
+AnalysisResult analysis_stream_finish(AnalysisStream* stream);
+void analysis_stream_free(AnalysisStream* stream);
+int analysis_stream_refresh_dictionaries(AnalysisStream* stream);
 
 // advanced stats function
 void calculate_advanced_stats(const char* text, AdvancedStats* stats);
@@ -102,15 +153,22 @@ void print_advanced_stats(const AdvancedStats* stats);
 
 
 // toxicity detection function
-int load_toxic_dictionary(const char* filename);
-void add_toxic_phrase(const char* phrase, ToxicitySeverity severity);
+int compile_toxic_dictionary(const char* source_file, const char* output_file);
 int detect_toxic_phrases(const char* text, AnalysisResult* result);
 void print_toxicity_report(const AnalysisResult* result);
-void save_toxicity_report(const char* filename, const AnalysisResult* result);
 const char* get_severity_name(ToxicitySeverity severity);
 int calculate_toxicity_score(const AnalysisResult* result);
+// same score for any stretch of text, from its word count and phrases per severity
+int score_toxicity_counts(long long word_count, int phrase_count, const int* severity_counts);
 const char* get_toxicity_level(int score);
 
+// text and severity of the i-th detected phrase
+const char* detected_phrase_text(const AnalysisResult* result, int i);
+ToxicitySeverity detected_phrase_severity(const AnalysisResult* result, int i);
+// Add count hits of a phrase given by text, looked up in the result's
+// dictionary. Returns its index in detected_phrases, -1 if it is not a phrase
+int add_detected_phrase(AnalysisResult* result, const char* text, int count);
+
 // sorting algorithm
 void quick_sort(WordNode** array, int low, int high);
 void merge_sort(WordNode** array, int left, int right);
@@ -123,7 +181,9 @@ void compare_sorting_algorithms(WordNode** array, int n);
 //hash table function
 unsigned int hash_function(const char* word);
 void hash_table_init(HashTable* ht);
+HashTable* hash_table_create(void);
 void hash_table_insert(HashTable* ht, const char* word);
+void hash_table_add(HashTable* ht, const char* word, int count);
 void hash_table_to_array(HashTable* ht, WordNode*** array, int* size);
 void hash_table_free(HashTable* ht);
 
@@ -131,11 +191,7 @@ void hash_table_free(HashTable* ht);
 void show_most_toxic_words(const AnalysisResult* result, int n);
 
 // structured output
-void save_analysis_csv(const char* filename, const AnalysisResult* result);
-void save_toxicity_csv(const char* filename, const AnalysisResult* result);
-void save_word_frequency_csv(const char* filename, WordNode** words, int count);
 void print_results_table(const AnalysisResult* result);
-void save_comprehensive_report(const char* base_filename, const AnalysisResult* result);
 
 // enhanced feature 
 void print_word_frequency_chart(const AnalysisResult* result, int top_n);
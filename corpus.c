@@ -0,0 +1,615 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "corpus.h"
+#include "content.h"
+#include "file.h"
+#include "reader.h"
+#include "tool.h"
+#include "dict.h"
+#include "report.h"
+#include "spill.h"
+#include "sketch.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <dirent.h>
+#include <glob.h>
+#include <sys/stat.h>
+#endif
+
+#define CORPUS_CHUNK_SIZE 65536
+#define CORPUS_PROGRESS_STEP 500
+
+//  FILE ENUMERATION
+
+static int add_file(FileList* list, const char* path) {
+    if (list->count >= list->capacity) {
+        int new_capacity = (list->capacity == 0) ? 256 : list->capacity * 2;
+        char** grown = realloc(list->paths, new_capacity * sizeof(char*));
+        if (grown == NULL) {
+            printf("Error: Memory allocation failed\n");
+            return 0;
+        }
+        list->paths = grown;
+        list->capacity = new_capacity;
+    }
+    list->paths[list->count] = strdup(path);
+    if (list->paths[list->count] == NULL) {
+        return 0;
+    }
+    list->count++;
+    return 1;
+}
+
+void free_file_list(FileList* list) {
+    for (int i = 0; i < list->count; i++) {
+        free(list->paths[i]);
+    }
+    free(list->paths);
+    memset(list, 0, sizeof(FileList));
+}
+
+// text, csv and their compressed forms are picked up from directories
+int is_supported_input(const char* filename) {
+    const char* extension = get_file_extension(filename);
+    return strcmp(extension, ".txt") == 0 || strcmp(extension, ".csv") == 0 ||
+           is_compressed_file(filename);
+}
+
+static int is_directory(const char* path) {
+#ifdef _WIN32
+    DWORD attributes = GetFileAttributesA(path);
+    return attributes != INVALID_FILE_ATTRIBUTES && (attributes & FILE_ATTRIBUTE_DIRECTORY);
+#else
+    struct stat info;
+    return stat(path, &info) == 0 && S_ISDIR(info.st_mode);
+#endif
+}
+
+// Add every supported file below dir, returns the number added
+static int collect_directory(const char* dir, FileList* list) {
+    char path[CORPUS_PATH_LEN];
+    int added = 0;
+
+#ifdef _WIN32
+    WIN32_FIND_DATAA entry;
+    snprintf(path, sizeof(path), "%s\\*", dir);
+    HANDLE find = FindFirstFileA(path, &entry);
+    if (find == INVALID_HANDLE_VALUE) {
+        printf("  Warning: Cannot open directory %s\n", dir);
+        return 0;
+    }
+    do {
+        const char* name = entry.cFileName;
+#else
+    DIR* handle = opendir(dir);
+    if (handle == NULL) {
+        printf("  Warning: Cannot open directory %s\n", dir);
+        return 0;
+    }
+    struct dirent* entry;
+    while ((entry = readdir(handle)) != NULL) {
+        const char* name = entry->d_name;
+#endif
+        if (strcmp(name, ".") == 0 || strcmp(name, "..") == 0) continue;
+
+        snprintf(path, sizeof(path), "%s/%s", dir, name);
+        if (is_directory(path)) {
+            added += collect_directory(path, list);
+        } else if (is_supported_input(name)) {
+            added += add_file(list, path);
+        }
+#ifdef _WIN32
+    } while (FindNextFileA(find, &entry));
+    FindClose(find);
+#else
+    }
+    closedir(handle);
+#endif
+    return added;
+}
+
+// one match of a file, directory or glob
+static int collect_match(const char* path, FileList* list) {
+    if (is_directory(path)) {
+        return collect_directory(path, list);
+    }
+    return add_file(list, path);
+}
+
+static int compare_paths(const void* a, const void* b) {
+    return strcmp(*(char* const*)a, *(char* const*)b);
+}
+
+// Expand a file, directory or wildcard pattern, returns the number of files added
+// (0 if nothing matched, the caller decides whether that is worth a warning)
+int collect_input_files(const char* pattern, FileList* list) {
+    int start = list->count;
+
+    if (strpbrk(pattern, "*?[") != NULL) {
+#ifdef _WIN32
+        // FindFirstFile only matches the last path component
+        char dir[CORPUS_PATH_LEN];
+        char path[CORPUS_PATH_LEN];
+        strncpy(dir, pattern, sizeof(dir) - 1);
+        dir[sizeof(dir) - 1] = '\0';
+        char* slash = strrchr(dir, '/');
+        char* backslash = strrchr(dir, '\\');
+        if (backslash > slash) slash = backslash;
+        if (slash != NULL) *slash = '\0';
+
+        WIN32_FIND_DATAA entry;
+        HANDLE find = FindFirstFileA(pattern, &entry);
+        if (find != INVALID_HANDLE_VALUE) {
+            do {
+                if (strcmp(entry.cFileName, ".") == 0 || strcmp(entry.cFileName, "..") == 0) continue;
+                if (slash != NULL) {
+                    snprintf(path, sizeof(path), "%s/%s", dir, entry.cFileName);
+                } else {
+                    snprintf(path, sizeof(path), "%s", entry.cFileName);
+                }
+                collect_match(path, list);
+            } while (FindNextFileA(find, &entry));
+            FindClose(find);
+        }
+#else
+        glob_t matches;
+        if (glob(pattern, 0, NULL, &matches) == 0) {
+            for (size_t i = 0; i < matches.gl_pathc; i++) {
+                collect_match(matches.gl_pathv[i], list);
+            }
+        }
+        globfree(&matches);
+#endif
+    } else if (is_directory(pattern) || file_exists(pattern)) {
+        collect_match(pattern, list);
+    }
+
+    int added = list->count - start;
+    // directory order is not stable across systems
+    qsort(list->paths + start, added, sizeof(char*), compare_paths);
+    return added;
+}
+
+//  WORK-STEALING SCHEDULER
+
+// a whole file, or one newline-aligned byte range of a big one
+typedef struct {
+    int file;
+    long long start;
+    long long end;      // -1 = to the end of the file
+} CorpusTask;
+
+// owner pops from the tail, thieves take from the head
+typedef struct {
+    CorpusTask* tasks;
+    int head;
+    int tail;
+    pthread_mutex_t lock;
+} TaskDeque;
+
+typedef struct {
+    long long size;
+    int shards;
+    int shards_left;
+    int failed;                 // a shard could not be read
+    AnalysisResult* partial;    // merged shards of a split file
+    pthread_mutex_t lock;       // partial and shards_left, only for split files
+} CorpusFile;
+
+typedef struct {
+    const FileList* list;
+    CorpusFile* files;
+    TaskDeque* deques;
+    int worker_count;
+    FILE* index;
+    int done_files;
+    int failed_files;
+    pthread_mutex_t lock;       // index and counters
+} CorpusRun;
+
+typedef struct {
+    CorpusRun* run;
+    int id;
+    int stolen;
+    AnalysisResult* corpus;     // this worker's share of the corpus result
+} CorpusWorker;
+
+static int take_task(CorpusRun* run, int self, CorpusTask* task) {
+    TaskDeque* own = &run->deques[self];
+    pthread_mutex_lock(&own->lock);
+    if (own->head < own->tail) {
+        *task = own->tasks[--own->tail];
+        pthread_mutex_unlock(&own->lock);
+        return 1;
+    }
+    pthread_mutex_unlock(&own->lock);
+
+    // own deque is empty, steal the oldest task of another worker
+    for (int i = 1; i < run->worker_count; i++) {
+        TaskDeque* victim = &run->deques[(self + i) % run->worker_count];
+        pthread_mutex_lock(&victim->lock);
+        if (victim->head < victim->tail) {
+            *task = victim->tasks[victim->head++];
+            pthread_mutex_unlock(&victim->lock);
+            return 2;
+        }
+        pthread_mutex_unlock(&victim->lock);
+    }
+    return 0;
+}
+
+// Split a big plain file at the first newline after every shard_size bytes
+static int plan_shards(const char* path, long long size, long long shard_size, long long* bounds, int max_shards) {
+    int count = 0;
+    FILE* file = fopen(path, "rb");
+    if (file == NULL) {
+        return 0;
+    }
+
+    long long previous = 0;
+    for (long long target = shard_size; target < size && count < max_shards - 1; target += shard_size) {
+        if (target <= previous) continue;
+        seek_file(file, target);
+        long long pos = target;
+        int c;
+        while ((c = fgetc(file)) != EOF) {
+            pos++;
+            if (c == '\n') break;
+        }
+        if (c == EOF || pos >= size) break;
+        bounds[count++] = pos;
+        previous = pos;
+    }
+    fclose(file);
+    return count;
+}
+
+static void feed_corpus_chunk(const char* chunk, size_t len, void* data) {
+    analysis_stream_feed((AnalysisStream*)data, chunk, len);
+}
+
+// ok is cleared when the file cannot be read, an empty file still counts
+static AnalysisResult analyze_task(const char* path, const CorpusTask* task, char* buffer, int* ok) {
+    AnalysisStream stream;
+    analysis_stream_init(&stream);
+    *ok = 1;
+
+    if (is_compressed_file(path)) {
+        if (read_compressed_file(path, feed_corpus_chunk, &stream) < 0) *ok = 0;
+    } else if (strcmp(get_file_extension(path), ".csv") == 0) {
+        char* text = load_file_text(path);
+        if (text != NULL) {
+            analysis_stream_feed(&stream, text, strlen(text));
+            free(text);
+        } else {
+            *ok = 0;
+        }
+    } else {
+        FILE* file = fopen(path, "rb");
+        if (file == NULL) {
+            *ok = 0;
+        } else {
+            long long remaining = (task->end < 0) ? -1 : task->end - task->start;
+            seek_file(file, task->start);
+            while (remaining != 0) {
+                size_t want = CORPUS_CHUNK_SIZE;
+                if (remaining > 0 && remaining < (long long)want) want = (size_t)remaining;
+                size_t len = fread(buffer, 1, want, file);
+                if (len == 0) break;
+                analysis_stream_feed(&stream, buffer, len);
+                if (remaining > 0) remaining -= len;
+            }
+            if (ferror(file)) *ok = 0;
+            fclose(file);
+        }
+    }
+    return analysis_stream_finish(&stream);
+}
+
+static void write_csv_field(FILE* file, const char* text) {
+    fputc('"', file);
+    for (const char* p = text; *p; p++) {
+        if (*p == '"') fputc('"', file);
+        fputc(*p, file);
+    }
+    fputc('"', file);
+}
+
+// Record a finished file in the index, called with run->lock held
+static void record_file(CorpusRun* run, int index, const AnalysisResult* result) {
+    const CorpusFile* file = &run->files[index];
+    write_csv_field(run->index, run->list->paths[index]);
+    if (result == NULL) {
+        fprintf(run->index, ",%lld,%d,0,0,0,0,0,FAILED\n", file->size, file->shards);
+        run->failed_files++;
+    } else {
+        int score = calculate_toxicity_score(result);
+        fprintf(run->index, ",%lld,%d,%lld,%d,%d,%d,%d,%s\n", file->size, file->shards,
+                result->word_count, result->unique_words, result->sentence_count,
+                result->toxic_phrase_count, score, get_toxicity_level(score));
+    }
+
+    run->done_files++;
+    if (run->done_files % CORPUS_PROGRESS_STEP == 0 || run->done_files == run->list->count) {
+        printf("\rAnalyzed %d/%d files", run->done_files, run->list->count);
+        fflush(stdout);
+    }
+}
+
+static void* corpus_worker(void* arg) {
+    CorpusWorker* worker = (CorpusWorker*)arg;
+    CorpusRun* run = worker->run;
+    char* buffer = (char*)malloc(CORPUS_CHUNK_SIZE);
+    CorpusTask task;
+    int source, ok;
+
+    while (buffer != NULL && (source = take_task(run, worker->id, &task)) != 0) {
+        if (source == 2) worker->stolen++;
+        dictionaries_reload_if_changed();
+
+        CorpusFile* file = &run->files[task.file];
+        AnalysisResult result = analyze_task(run->list->paths[task.file], &task, buffer, &ok);
+
+        if (file->shards == 1) {
+            pthread_mutex_lock(&run->lock);
+            record_file(run, task.file, ok ? &result : NULL);
+            pthread_mutex_unlock(&run->lock);
+            merge_analysis_results(worker->corpus, &result);
+            cleanup_analyzer(&result);
+            continue;
+        }
+
+        // every shard but the last ends with a newline, and finishing it
+        // counted the empty line after that once more than the file has
+        if (task.end >= 0) {
+            result.line_count--;
+            result.advanced_stats.total_paragraphs--;
+        }
+
+        // shards are merged into the file's partial result, the last one finishes it
+        pthread_mutex_lock(&file->lock);
+        merge_analysis_results(file->partial, &result);
+        if (!ok) file->failed = 1;
+        int last = (--file->shards_left == 0);
+        pthread_mutex_unlock(&file->lock);
+        cleanup_analyzer(&result);
+
+        if (last) {
+            finalize_analysis_result(file->partial);
+            pthread_mutex_lock(&run->lock);
+            record_file(run, task.file, file->failed ? NULL : file->partial);
+            pthread_mutex_unlock(&run->lock);
+            merge_analysis_results(worker->corpus, file->partial);
+            cleanup_analyzer(file->partial);
+            free(file->partial);
+            file->partial = NULL;
+        }
+    }
+    free(buffer);
+    return NULL;
+}
+
+static AnalysisResult* new_partial_result(void) {
+    AnalysisResult* result = (AnalysisResult*)calloc(1, sizeof(AnalysisResult));
+    if (result != NULL) {
+        result->hash_table = hash_table_create();
+        result->sketch = word_sketch_create();
+        result->spill = (result->sketch == NULL) ? word_spill_create() : NULL;
+    }
+    return result;
+}
+
+// Build the task list, big plain files become several newline-aligned shards
+static CorpusTask* plan_tasks(const FileList* list, CorpusFile* files, long long shard_size, int* task_count) {
+    int capacity = list->count + 16;
+    int count = 0;
+    CorpusTask* tasks = (CorpusTask*)malloc(capacity * sizeof(CorpusTask));
+    long long bounds[256];
+
+    for (int i = 0; i < list->count && tasks != NULL; i++) {
+        const char* path = list->paths[i];
+        files[i].size = get_large_file_size(path);
+        int cuts = 0;
+        if (shard_size > 0 && files[i].size > shard_size && !is_compressed_file(path) &&
+            strcmp(get_file_extension(path), ".csv") != 0) {
+            cuts = plan_shards(path, files[i].size, shard_size, bounds, 256);
+        }
+
+        if (count + cuts + 1 > capacity) {
+            capacity = (count + cuts + 1) * 2;
+            CorpusTask* grown = realloc(tasks, capacity * sizeof(CorpusTask));
+            if (grown == NULL) {
+                free(tasks);
+                return NULL;
+            }
+            tasks = grown;
+        }
+
+        long long start = 0;
+        for (int s = 0; s <= cuts; s++) {
+            CorpusTask* task = &tasks[count++];
+            task->file = i;
+            task->start = start;
+            task->end = (s < cuts) ? bounds[s] : -1;
+            start = task->end;
+        }
+        if (cuts > 0) {
+            files[i].partial = new_partial_result();
+            if (files[i].partial == NULL) {
+                free(tasks);
+                return NULL;
+            }
+            pthread_mutex_init(&files[i].lock, NULL);
+        }
+        files[i].shards = cuts + 1;
+        files[i].shards_left = cuts + 1;
+    }
+    *task_count = count;
+    return tasks;
+}
+
+// Free the per-file state, partial results are left only by a failed run
+static void free_corpus_files(CorpusRun* run) {
+    for (int i = 0; i < run->list->count; i++) {
+        if (run->files[i].partial != NULL) {
+            cleanup_analyzer(run->files[i].partial);
+            free(run->files[i].partial);
+        }
+        if (run->files[i].shards > 1) {
+            pthread_mutex_destroy(&run->files[i].lock);
+        }
+    }
+    free(run->files);
+}
+
+static void save_corpus_reports(const CorpusOptions* options, AnalysisResult* result) {
+    char base[CORPUS_PATH_LEN];
+    ReportSnapshot snapshot;
+    ReportJob jobs[REPORT_MAX_JOBS];
+    int count = 0;
+
+    snprintf(base, sizeof(base), "%s/corpus", options->output_dir);
+    add_report_job(jobs, &count, REPORT_FILE_ANALYSIS_TXT, base);
+    add_report_job(jobs, &count, REPORT_FILE_TOXICITY_TXT, base);
+    add_report_job(jobs, &count, REPORT_FILE_ANALYSIS_CSV, base);
+    add_report_job(jobs, &count, REPORT_FILE_WORDS_CSV, base);
+    if (result->toxic_phrase_count > 0) {
+        add_report_job(jobs, &count, REPORT_FILE_TOXICITY_CSV, base);
+    }
+    report_snapshot_init(&snapshot, result, base);
+    if (options->all_words) snapshot.word_limit = 0;
+    snapshot.min_frequency = options->min_frequency;
+    write_reports(&snapshot, jobs, count);
+}
+
+int run_corpus(const FileList* list, const CorpusOptions* options) {
+    double start_time = get_time_ms();
+    char path[CORPUS_PATH_LEN];
+
+    if (list->count == 0) {
+        printf("Error: No input files found\n");
+        return -1;
+    }
+    set_word_memory_limit((long long)options->memory_mb * 1024 * 1024);
+    set_sketch_options(&options->approx);
+    if (!make_directory(options->output_dir)) {
+        printf("Error: Cannot create output directory %s\n", options->output_dir);
+        return -1;
+    }
+    snprintf(path, sizeof(path), "%s/corpus_index.csv", options->output_dir);
+    FILE* index = fopen(path, "w");
+    if (index == NULL) {
+        printf("Error: Cannot create %s\n", path);
+        return -1;
+    }
+    fprintf(index, "file,bytes,shards,words,unique_words,sentences,toxic_phrases,toxicity_score,level\n");
+
+    CorpusRun run;
+    memset(&run, 0, sizeof(run));
+    run.list = list;
+    run.index = index;
+    run.files = (CorpusFile*)calloc(list->count, sizeof(CorpusFile));
+    int task_count = 0;
+    CorpusTask* tasks = (run.files != NULL) ? plan_tasks(list, run.files, options->shard_size, &task_count) : NULL;
+    if (tasks == NULL) {
+        printf("Error: Memory allocation failed\n");
+        if (run.files != NULL) free_corpus_files(&run);
+        fclose(index);
+        return -1;
+    }
+
+    run.worker_count = (options->threads > 0) ? options->threads : get_cpu_count();
+    if (run.worker_count > CORPUS_MAX_THREADS) run.worker_count = CORPUS_MAX_THREADS;
+    if (run.worker_count > task_count) run.worker_count = task_count;
+    printf("Analyzing %d files (%d tasks) on %d threads...\n", list->count, task_count, run.worker_count);
+
+    // each worker starts with one contiguous block of tasks
+    run.deques = (TaskDeque*)calloc(run.worker_count, sizeof(TaskDeque));
+    CorpusWorker workers[CORPUS_MAX_THREADS];
+    pthread_t threads[CORPUS_MAX_THREADS];
+    int started[CORPUS_MAX_THREADS];
+    int workers_ready = (run.deques != NULL);
+    for (int i = 0; i < run.worker_count && workers_ready; i++) {
+        workers[i].corpus = new_partial_result();
+        if (workers[i].corpus == NULL) {
+            while (--i >= 0) {
+                cleanup_analyzer(workers[i].corpus);
+                free(workers[i].corpus);
+            }
+            workers_ready = 0;
+        }
+    }
+    if (!workers_ready) {
+        printf("Error: Memory allocation failed\n");
+        free_corpus_files(&run);
+        free(run.deques);
+        free(tasks);
+        fclose(index);
+        return -1;
+    }
+
+    pthread_mutex_init(&run.lock, NULL);
+    for (int i = 0; i < run.worker_count; i++) {
+        int first = (int)((long long)task_count * i / run.worker_count);
+        int last = (int)((long long)task_count * (i + 1) / run.worker_count);
+        run.deques[i].tasks = tasks + first;
+        run.deques[i].head = 0;
+        run.deques[i].tail = last - first;
+        pthread_mutex_init(&run.deques[i].lock, NULL);
+
+        workers[i].run = &run;
+        workers[i].id = i;
+        workers[i].stolen = 0;
+    }
+    for (int i = 0; i < run.worker_count; i++) {
+        started[i] = (pthread_create(&threads[i], NULL, corpus_worker, &workers[i]) == 0);
+    }
+
+    AnalysisResult corpus;
+    memset(&corpus, 0, sizeof(corpus));
+    corpus.hash_table = hash_table_create();
+    corpus.sketch = word_sketch_create();
+    corpus.spill = (corpus.sketch == NULL) ? word_spill_create() : NULL;
+    int stolen = 0;
+    for (int i = 0; i < run.worker_count; i++) {
+        // a worker whose thread did not start runs here, stealing what is left
+        if (started[i]) {
+            pthread_join(threads[i], NULL);
+        } else {
+            corpus_worker(&workers[i]);
+        }
+        finalize_analysis_result(workers[i].corpus);
+        merge_analysis_results(&corpus, workers[i].corpus);
+        cleanup_analyzer(workers[i].corpus);
+        free(workers[i].corpus);
+        stolen += workers[i].stolen;
+    }
+    // other workers may still steal from a deque until they are all joined
+    for (int i = 0; i < run.worker_count; i++) {
+        pthread_mutex_destroy(&run.deques[i].lock);
+    }
+    pthread_mutex_destroy(&run.lock);
+    fclose(index);
+    printf("\n");
+
+    finalize_analysis_result(&corpus);
+    save_corpus_reports(options, &corpus);
+
+    int score = calculate_toxicity_score(&corpus);
+    printf("CORPUS files=%d failed=%d words=%lld unique=%d sentences=%d toxic_phrases=%d score=%d level=%s\n",
+           list->count - run.failed_files, run.failed_files, corpus.word_count, corpus.unique_words,
+           corpus.sentence_count, corpus.toxic_phrase_count, score, get_toxicity_level(score));
+    printf("Index: %s (%d tasks stolen between threads)\n", path, stolen);
+    printf("DONE %d/%d files in %.1f ms\n", list->count - run.failed_files, list->count,
+           get_time_ms() - start_time);
+
+    cleanup_analyzer(&corpus);
+    free_corpus_files(&run);
+    free(run.deques);
+    free(tasks);
+    return run.failed_files;
+}
@@ -0,0 +1,37 @@
+#ifndef CORPUS_H
+#define CORPUS_H
+
+#include "sketch.h"
+
+#define CORPUS_SHARD_SIZE (8LL * 1024 * 1024)  // plain files bigger than this are split
+#define CORPUS_MAX_THREADS 64
+#define CORPUS_PATH_LEN 1024
+
+// growable list of input paths
+typedef struct {
+    char** paths;
+    int count;
+    int capacity;
+} FileList;
+
+// options for analyzer --corpus
+typedef struct {
+    const char* output_dir;
+    int threads;
+    long long shard_size;
+    int all_words;              // whole vocabulary in corpus_words.csv
+    int min_frequency;
+    int memory_mb;              // word table budget per partial result, 0 for no limit
+    SketchOptions approx;       // approximate word counts, merged across shards and files
+} CorpusOptions;
+
+// expand a file, directory (recursive) or glob pattern into the list
+int collect_input_files(const char* pattern, FileList* list);
+void free_file_list(FileList* list);
+int is_supported_input(const char* filename);
+
+// Analyze every file on a work-stealing pool, writes corpus_index.csv and
+// the merged corpus reports. Returns the number of failed files
+int run_corpus(const FileList* files, const CorpusOptions* options);
+
+#endif
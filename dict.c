@@ -0,0 +1,585 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <pthread.h>
+#include "dict.h"
+#include "cache.h"
+#include "error.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+// compiled file layout: header, index slots, text offsets, lower offsets,
+// severities (padded to 4 bytes), then the string pool
+typedef struct {
+    char magic[8];
+    unsigned int version;
+    unsigned int count;
+    unsigned int index_capacity;
+    unsigned int max_len;
+    long long source_size;      // toxicwords.txt it was compiled from
+    long long source_mtime;     // sub-second, see get_source_stamp
+    unsigned int pool_size;
+    unsigned int reserved;
+} CompiledDictHeader;
+
+static const char COMPILED_DICT_MAGIC[8] = "TOXDICT";
+
+// the published set, swapped under the lock
+static AnalyzerDictionaries* current_dictionaries = NULL;
+static int dictionary_generation = 0;
+static int reload_running = 0;
+static double last_reload_check = 0;
+static pthread_mutex_t dictionaries_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t dictionaries_once = PTHREAD_ONCE_INIT;
+
+// Returns 1 if the phrase was added
+int dict_add(ToxicDictionary* dict, const char* phrase, ToxicitySeverity severity) {
+    if (strlen(phrase) == 0 || strlen(phrase) >= MAX_PHRASE_LEN) {
+        log_message(LOG_LEVEL_WARNING, " Warning: Invalid phrase length for '%s'\n", phrase);
+        return 0;
+    }
+    if (dict->mapping != NULL) {
+        log_message(LOG_LEVEL_WARNING, " Warning: Compiled dictionary is read-only, cannot add '%s'\n", phrase);
+        return 0;
+    }
+    
+    // Check for duplicates, case-insensitive through the lowercased index
+    char lower[MAX_PHRASE_LEN];
+    strcpy(lower, phrase);
+    to_lower_case(lower);
+    int len = strlen(lower);
+    if (dict_find(dict, lower, len, hash_string(lower, len)) >= 0) {
+        log_message(LOG_LEVEL_WARNING, "  Warning: Duplicate toxic phrase '%s', skipping\n", phrase);
+        return 0;
+    }
+    
+    if (dict->count >= dict->capacity) {
+        int new_capacity = (dict->capacity == 0) ? 1024 : dict->capacity * 2;
+        char** grown_text = realloc(dict->text, new_capacity * sizeof(char*));
+        if (grown_text != NULL) dict->text = grown_text;
+        char** grown_lower = realloc(dict->lower, new_capacity * sizeof(char*));
+        if (grown_lower != NULL) dict->lower = grown_lower;
+        unsigned char* grown_severity = realloc(dict->severity, new_capacity);
+        if (grown_severity != NULL) dict->severity = grown_severity;
+        if (grown_text == NULL || grown_lower == NULL || grown_severity == NULL) {
+            log_message(LOG_LEVEL_WARNING, " Warning: Memory allocation failed, cannot add '%s'\n", phrase);
+            return 0;
+        }
+        dict->capacity = new_capacity;
+    }
+    
+    dict->text[dict->count] = strdup(phrase);
+    dict->lower[dict->count] = strdup(lower);
+    if (dict->text[dict->count] == NULL || dict->lower[dict->count] == NULL ||
+        !string_index_add(&dict->index, dict->lower, dict->count)) {
+        free(dict->text[dict->count]);
+        free(dict->lower[dict->count]);
+        log_message(LOG_LEVEL_WARNING, " Warning: Memory allocation failed, cannot add '%s'\n", phrase);
+        return 0;
+    }
+    dict->severity[dict->count] = (unsigned char)severity;
+    if (len > dict->max_len) {
+        dict->max_len = len;
+    }
+    dict->count++;
+    return 1;
+}
+
+// Position of a lowercased phrase, -1 if it is not in the dictionary
+int dict_find(const ToxicDictionary* dict, const char* lower, int len, unsigned int hash) {
+    return string_index_find(&dict->index, dict->lower, lower, len, hash);
+}
+
+void dict_free(ToxicDictionary* dict) {
+    if (dict->mapping != NULL) {
+#ifdef _WIN32
+        UnmapViewOfFile(dict->mapping);
+#else
+        munmap(dict->mapping, dict->mapping_size);
+#endif
+    } else {
+        for (int i = 0; i < dict->count; i++) {
+            free(dict->text[i]);
+            free(dict->lower[i]);
+        }
+        free(dict->severity);
+        string_index_free(&dict->index);
+    }
+    free(dict->text);
+    free(dict->lower);
+    memset(dict, 0, sizeof(ToxicDictionary));
+}
+
+// Unified toxic dictionary loading
+int dict_load_text(ToxicDictionary* dict, const char* filename) {
+    FILE* file = fopen(filename, "r");
+    if (file == NULL) {
+        log_message(LOG_LEVEL_ERROR, " Error: Cannot open toxic dictionary file '%s'\n", filename);
+        log_message(LOG_LEVEL_INFO, "Please create 'toxicwords.txt' with format: phrase,SEVERITY\n");
+        return 0;
+    }
+
+    char line[256];
+    dict_free(dict);
+    int loaded_count = 0;
+
+    log_message(LOG_LEVEL_INFO, " Loading toxic dictionary from %s...\n", filename);
+    
+    while (fgets(line, sizeof(line), file)) {
+        line[strcspn(line, "\n")] = '\0';
+        line[strcspn(line, "\r")] = '\0';
+        
+        if (strlen(line) == 0 || line[0] == '#' || line[0] == ';') {
+            continue;
+        }
+        
+        char* comma = strchr(line, ',');
+        if (comma != NULL) {
+            *comma = '\0';
+            char* phrase = line;
+            char* severity_str = comma + 1;
+            
+            ToxicitySeverity severity = SEVERITY_MILD;
+            
+            if (strcasecmp(severity_str, "SEVERE") == 0) {
+                severity = SEVERITY_SEVERE;
+            } else if (strcasecmp(severity_str, "MODERATE") == 0) {
+                severity = SEVERITY_MODERATE;
+            } else if (strcasecmp(severity_str, "MILD") == 0) {
+                severity = SEVERITY_MILD;
+            } else {
+                log_message(LOG_LEVEL_WARNING, "  Warning: Invalid severity '%s' for phrase '%s', using MILD\n",
+                            severity_str, phrase);
+            }
+            
+            loaded_count += dict_add(dict, phrase, severity);
+        } else {
+            loaded_count += dict_add(dict, line, SEVERITY_MILD);
+        }
+    }
+    
+    fclose(file);
+    log_message(LOG_LEVEL_INFO, " Successfully loaded %d toxic phrases\n", loaded_count);
+    return (loaded_count > 0) ? 1 : 0;
+}
+
+// Size and modification time of a source file. The time is in 100 ns ticks
+// on Windows and nanoseconds elsewhere, so two saves in one second differ
+static int get_source_stamp(const char* source_file, long long* size, long long* mtime) {
+#ifdef _WIN32
+    WIN32_FILE_ATTRIBUTE_DATA info;
+    if (!GetFileAttributesExA(source_file, GetFileExInfoStandard, &info)) {
+        return 0;
+    }
+    *size = ((long long)info.nFileSizeHigh << 32) | info.nFileSizeLow;
+    *mtime = ((long long)info.ftLastWriteTime.dwHighDateTime << 32) | info.ftLastWriteTime.dwLowDateTime;
+#else
+    struct stat info;
+    if (stat(source_file, &info) != 0) {
+        return 0;
+    }
+    *size = (long long)info.st_size;
+#ifdef __APPLE__
+    *mtime = (long long)info.st_mtimespec.tv_sec * 1000000000LL + info.st_mtimespec.tv_nsec;
+#else
+    *mtime = (long long)info.st_mtim.tv_sec * 1000000000LL + info.st_mtim.tv_nsec;
+#endif
+#endif
+    return 1;
+}
+
+//  COMPILED DICTIONARY
+
+// Write the dictionary with its index so loading needs no parsing or hashing
+int dict_compile(const ToxicDictionary* dict, const char* source_file, const char* output_file) {
+    CompiledDictHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, COMPILED_DICT_MAGIC, sizeof(header.magic));
+    header.version = COMPILED_DICT_VERSION;
+    header.count = dict->count;
+    header.index_capacity = dict->index.capacity;
+    header.max_len = dict->max_len;
+    get_source_stamp(source_file, &header.source_size, &header.source_mtime);
+
+    unsigned int* text_offsets = malloc((dict->count + 1) * sizeof(unsigned int));
+    unsigned int* lower_offsets = malloc((dict->count + 1) * sizeof(unsigned int));
+    if (text_offsets == NULL || lower_offsets == NULL) {
+        log_message(LOG_LEVEL_ERROR, "Error: Memory allocation failed\n");
+        free(text_offsets);
+        free(lower_offsets);
+        return 0;
+    }
+    for (int i = 0; i < dict->count; i++) {
+        text_offsets[i] = header.pool_size;
+        header.pool_size += strlen(dict->text[i]) + 1;
+        lower_offsets[i] = header.pool_size;
+        header.pool_size += strlen(dict->lower[i]) + 1;
+    }
+
+    char temp_file[512];
+    snprintf(temp_file, sizeof(temp_file), "%s.tmp", output_file);
+    FILE* file = fopen(temp_file, "wb");
+    if (file == NULL) {
+        log_message(LOG_LEVEL_ERROR, "Error: Cannot create %s\n", output_file);
+        free(text_offsets);
+        free(lower_offsets);
+        return 0;
+    }
+
+    static const char padding[4] = {0};
+    fwrite(&header, sizeof(header), 1, file);
+    fwrite(dict->index.slots, sizeof(int), dict->index.capacity, file);
+    fwrite(text_offsets, sizeof(unsigned int), dict->count, file);
+    fwrite(lower_offsets, sizeof(unsigned int), dict->count, file);
+    fwrite(dict->severity, 1, dict->count, file);
+    fwrite(padding, 1, (4 - dict->count % 4) % 4, file);
+    for (int i = 0; i < dict->count; i++) {
+        fwrite(dict->text[i], 1, strlen(dict->text[i]) + 1, file);
+        fwrite(dict->lower[i], 1, strlen(dict->lower[i]) + 1, file);
+    }
+    int ok = !ferror(file);
+    fclose(file);
+    free(text_offsets);
+    free(lower_offsets);
+
+    remove(output_file);
+    if (!ok || rename(temp_file, output_file) != 0) {
+        log_message(LOG_LEVEL_ERROR, "Error: Failed to write %s\n", output_file);
+        remove(temp_file);
+        return 0;
+    }
+    return 1;
+}
+
+static void* map_file(const char* filename, size_t* size) {
+#ifdef _WIN32
+    HANDLE file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE) {
+        return NULL;
+    }
+    LARGE_INTEGER file_size;
+    GetFileSizeEx(file, &file_size);
+    HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    void* view = (mapping != NULL) ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : NULL;
+    if (mapping != NULL) CloseHandle(mapping);
+    CloseHandle(file);
+    *size = (size_t)file_size.QuadPart;
+    return view;
+#else
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) {
+        return NULL;
+    }
+    struct stat info;
+    void* view = NULL;
+    if (fstat(fd, &info) == 0 && info.st_size > 0) {
+        view = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (view == MAP_FAILED) view = NULL;
+        *size = (size_t)info.st_size;
+    }
+    close(fd);
+    return view;
+#endif
+}
+
+// Map a compiled dictionary. Fails if it is missing, corrupt, from another
+// format version or older than its source file, so the caller can fall back
+int dict_map(ToxicDictionary* dict, const char* compiled_file, const char* source_file) {
+    size_t size = 0;
+    char* view = map_file(compiled_file, &size);
+    if (view == NULL) {
+        return 0;
+    }
+
+    ToxicDictionary mapped;
+    memset(&mapped, 0, sizeof(mapped));
+    mapped.mapping = view;
+    mapped.mapping_size = size;
+
+    const CompiledDictHeader* header = (const CompiledDictHeader*)view;
+    long long source_size, source_mtime;
+    size_t count = (size >= sizeof(*header)) ? header->count : 0;
+    size_t capacity = (size >= sizeof(*header)) ? header->index_capacity : 0;
+    size_t pool_start = sizeof(*header) + capacity * sizeof(int) + count * 2 * sizeof(unsigned int) +
+                        (count + 3) / 4 * 4;
+
+    if (size < sizeof(*header) || memcmp(header->magic, COMPILED_DICT_MAGIC, sizeof(header->magic)) != 0 ||
+        header->version != COMPILED_DICT_VERSION || (capacity & (capacity - 1)) != 0 ||
+        (count > 0 && capacity <= count) || pool_start + header->pool_size != size ||
+        (header->pool_size > 0 && view[size - 1] != '\0')) {
+        log_message(LOG_LEVEL_WARNING, " Warning: %s is not a valid compiled dictionary, loading text\n", compiled_file);
+        dict_free(&mapped);
+        return 0;
+    }
+    if (get_source_stamp(source_file, &source_size, &source_mtime) &&
+        (source_size != header->source_size || source_mtime != header->source_mtime)) {
+        log_message(LOG_LEVEL_WARNING, " Warning: %s changed since it was compiled, loading text\n", source_file);
+        dict_free(&mapped);
+        return 0;
+    }
+
+    const int* slots = (const int*)(view + sizeof(*header));
+    const unsigned int* text_offsets = (const unsigned int*)(slots + capacity);
+    const unsigned int* lower_offsets = text_offsets + count;
+    char* pool = view + pool_start;
+
+    // only the pointer arrays are built, everything else is used in place
+    mapped.text = malloc((count + 1) * sizeof(char*));
+    mapped.lower = malloc((count + 1) * sizeof(char*));
+    if (mapped.text == NULL || mapped.lower == NULL) {
+        dict_free(&mapped);
+        return 0;
+    }
+    const unsigned char* severity = (const unsigned char*)(lower_offsets + count);
+    for (size_t i = 0; i < count; i++) {
+        if (text_offsets[i] >= header->pool_size || lower_offsets[i] >= header->pool_size ||
+            severity[i] >= MAX_SEVERITY_LEVELS) {
+            log_message(LOG_LEVEL_WARNING, " Warning: %s is corrupt, loading text\n", compiled_file);
+            dict_free(&mapped);
+            return 0;
+        }
+        mapped.text[i] = pool + text_offsets[i];
+        mapped.lower[i] = pool + lower_offsets[i];
+    }
+    // lookups probe until an empty slot, a full table would never stop on a miss
+    size_t empty = 0;
+    int bad_slot = 0;
+    for (size_t i = 0; i < capacity; i++) {
+        if (slots[i] >= (int)count) bad_slot = 1;
+        if (slots[i] < 0) empty++;
+    }
+    if (bad_slot || (capacity > 0 && empty == 0)) {
+        log_message(LOG_LEVEL_WARNING, " Warning: %s is corrupt, loading text\n", compiled_file);
+        dict_free(&mapped);
+        return 0;
+    }
+    mapped.severity = (unsigned char*)severity;
+    mapped.index.slots = (int*)slots;
+    mapped.index.capacity = (int)capacity;
+    mapped.count = (int)count;
+    mapped.capacity = (int)count;
+    mapped.max_len = header->max_len;
+
+    dict_free(dict);
+    *dict = mapped;
+    return 1;
+}
+
+//  STOP WORDS
+
+// Add one stop word, repeated words are ignored
+int stopwords_add(StopwordList* list, const char* word) {
+    if (stopwords_contains(list, word)) {
+        return 0;
+    }
+    if (list->count >= list->capacity) {
+        int new_capacity = (list->capacity == 0) ? 256 : list->capacity * 2;
+        char** grown = realloc(list->words, new_capacity * sizeof(char*));
+        if (grown == NULL) {
+            return 0;
+        }
+        list->words = grown;
+        list->capacity = new_capacity;
+    }
+    list->words[list->count] = strdup(word);
+    if (list->words[list->count] == NULL || !string_index_add(&list->index, list->words, list->count)) {
+        free(list->words[list->count]);
+        return 0;
+    }
+    list->count++;
+    return 1;
+}
+
+int stopwords_contains(const StopwordList* list, const char* word) {
+    int len = strlen(word);
+    return string_index_find(&list->index, list->words, word, len, hash_string(word, len)) >= 0;
+}
+
+// Load stop words from file
+int stopwords_load(StopwordList* list, const char* filename) {
+    FILE* file = fopen(filename, "r");
+    if (!file) {
+        log_message(LOG_LEVEL_ERROR, " Error: Cannot open stopwords file '%s'\n", filename);
+        return 0;
+    }
+    
+    stopwords_free(list);
+    char word[MAX_WORD_LEN];
+    while (fscanf(file, "%49s", word) == 1) {
+        stopwords_add(list, word);
+    }
+    
+    fclose(file);
+    log_message(LOG_LEVEL_INFO, " Loaded %d stopwords from %s\n", list->count, filename);
+    return list->count;
+}
+
+void stopwords_free(StopwordList* list) {
+    for (int i = 0; i < list->count; i++) {
+        free(list->words[i]);
+    }
+    free(list->words);
+    string_index_free(&list->index);
+    memset(list, 0, sizeof(StopwordList));
+}
+
+//  PUBLISHED DICTIONARIES
+
+// Build a complete set from the files on disk, nothing shared is touched
+AnalyzerDictionaries* dictionaries_load(void) {
+    AnalyzerDictionaries* dicts = (AnalyzerDictionaries*)calloc(1, sizeof(AnalyzerDictionaries));
+    if (dicts == NULL) {
+        log_message(LOG_LEVEL_ERROR, "Error: Memory allocation failed\n");
+        return NULL;
+    }
+    // stamp and hash the sources before parsing them: a file saved while it
+    // is parsed then no longer matches its stamp and is loaded again
+    get_source_stamp(TOXIC_DICT_FILE, &dicts->toxic_size, &dicts->toxic_mtime);
+    get_source_stamp(STOPWORDS_FILE, &dicts->stop_size, &dicts->stop_mtime);
+
+    // results depend on the dictionaries, so cache keys include this
+    unsigned long long toxic = 0, stop = 0;
+    hash_file_content(TOXIC_DICT_FILE, &toxic);
+    hash_file_content(STOPWORDS_FILE, &stop);
+    dicts->hash = (toxic * 31 + stop) * 31 + CACHE_FORMAT_VERSION;
+
+    if (stopwords_load(&dicts->stopwords, STOPWORDS_FILE) == 0) {
+        log_message(LOG_LEVEL_WARNING, " Warning: No stopwords loaded, using default set\n");
+    }
+    // the compiled form skips parsing, see compile_toxic_dictionary
+    if (dict_map(&dicts->toxic, COMPILED_DICT_FILE, TOXIC_DICT_FILE)) {
+        log_message(LOG_LEVEL_INFO, " Loaded %d toxic phrases from %s\n", dicts->toxic.count, COMPILED_DICT_FILE);
+    } else if (!dict_load_text(&dicts->toxic, TOXIC_DICT_FILE)) {
+        log_message(LOG_LEVEL_WARNING, "  Toxicity detection disabled. Create 'toxicwords.txt' to enable.\n");
+    }
+    return dicts;
+}
+
+static void free_dictionaries(AnalyzerDictionaries* dicts) {
+    dict_free(&dicts->toxic);
+    stopwords_free(&dicts->stopwords);
+    free(dicts);
+}
+
+// Make next the set new analyses get. Analyses already running keep the
+// set they started with, the old one is freed after the last of them ends
+void dictionaries_publish(AnalyzerDictionaries* next) {
+    pthread_mutex_lock(&dictionaries_lock);
+    AnalyzerDictionaries* old = current_dictionaries;
+    next->generation = ++dictionary_generation;
+    next->refs = 1;                 // the published reference
+    current_dictionaries = next;
+    pthread_mutex_unlock(&dictionaries_lock);
+
+    if (old != NULL) {
+        dictionaries_release(old);
+    }
+}
+
+static void load_first_dictionaries(void) {
+    AnalyzerDictionaries* dicts = dictionaries_load();
+    if (dicts != NULL) {
+        dictionaries_publish(dicts);
+    }
+}
+
+// Load the dictionaries the first time any thread needs them. Every later
+// call returns at once, so the files are read exactly once per process
+void dictionaries_init(void) {
+    pthread_once(&dictionaries_once, load_first_dictionaries);
+}
+
+AnalyzerDictionaries* dictionaries_acquire(void) {
+    dictionaries_init();
+    pthread_mutex_lock(&dictionaries_lock);
+    AnalyzerDictionaries* dicts = current_dictionaries;
+    if (dicts != NULL) {
+        dicts->refs++;
+    }
+    pthread_mutex_unlock(&dictionaries_lock);
+    return dicts;
+}
+
+AnalyzerDictionaries* dictionaries_retain(AnalyzerDictionaries* dicts) {
+    if (dicts == NULL) return NULL;
+    pthread_mutex_lock(&dictionaries_lock);
+    dicts->refs++;
+    pthread_mutex_unlock(&dictionaries_lock);
+    return dicts;
+}
+
+void dictionaries_release(AnalyzerDictionaries* dicts) {
+    if (dicts == NULL) return;
+
+    pthread_mutex_lock(&dictionaries_lock);
+    int last = (--dicts->refs == 0);
+    pthread_mutex_unlock(&dictionaries_lock);
+    if (last) {
+        free_dictionaries(dicts);
+    }
+}
+
+static void* reload_thread(void* arg) {
+    (void)arg;
+    AnalyzerDictionaries* next = dictionaries_load();
+    if (next != NULL) {
+        dictionaries_publish(next);
+        log_message(LOG_LEVEL_INFO, "[INFO] Dictionaries reloaded: %d toxic phrases, %d stopwords\n",
+                    next->toxic.count, next->stopwords.count);
+        fflush(stdout);
+    }
+
+    pthread_mutex_lock(&dictionaries_lock);
+    reload_running = 0;
+    pthread_mutex_unlock(&dictionaries_lock);
+    return NULL;
+}
+
+// Start a background reload if a source file was edited since the current
+// set was loaded. Cheap to call often, the files are checked once a second
+int dictionaries_reload_if_changed(void) {
+    double now = get_time_ms();
+    pthread_mutex_lock(&dictionaries_lock);
+    AnalyzerDictionaries* dicts = current_dictionaries;
+    if (dicts == NULL || reload_running || now - last_reload_check < DICT_RELOAD_CHECK_MS) {
+        pthread_mutex_unlock(&dictionaries_lock);
+        return 0;
+    }
+    last_reload_check = now;
+    long long toxic_size = dicts->toxic_size, toxic_mtime = dicts->toxic_mtime;
+    long long stop_size = dicts->stop_size, stop_mtime = dicts->stop_mtime;
+    pthread_mutex_unlock(&dictionaries_lock);
+
+    long long size, mtime;
+    int changed = (get_source_stamp(TOXIC_DICT_FILE, &size, &mtime) && (size != toxic_size || mtime != toxic_mtime)) ||
+                  (get_source_stamp(STOPWORDS_FILE, &size, &mtime) && (size != stop_size || mtime != stop_mtime));
+    if (!changed) {
+        return 0;
+    }
+
+    pthread_mutex_lock(&dictionaries_lock);
+    if (reload_running) {
+        pthread_mutex_unlock(&dictionaries_lock);
+        return 0;
+    }
+    reload_running = 1;
+    pthread_mutex_unlock(&dictionaries_lock);
+
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, reload_thread, NULL) != 0) {
+        pthread_mutex_lock(&dictionaries_lock);
+        reload_running = 0;
+        pthread_mutex_unlock(&dictionaries_lock);
+        return 0;
+    }
+    pthread_detach(thread);
+    return 1;
+}
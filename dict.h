@@ -0,0 +1,73 @@
+#ifndef DICT_H
+#define DICT_H
+
+#include "content.h"
+#include "tool.h"
+
+#define TOXIC_DICT_FILE "toxicwords.txt"
+#define STOPWORDS_FILE "stopwords.txt"
+#define COMPILED_DICT_FILE "toxicwords.bin"
+#define COMPILED_DICT_VERSION 2
+#define DICT_RELOAD_CHECK_MS 1000   // how often the source files are checked for edits
+
+// toxic phrase dictionary, built from text or mapped from a compiled file
+typedef struct {
+    int count;
+    int capacity;
+    int max_len;                // longest phrase, bounds the matcher
+    char** text;                // as written in the dictionary
+    char** lower;               // lowercased, what the matcher compares
+    unsigned char* severity;
+    StringIndex index;          // lowercased phrase -> position
+    void* mapping;              // compiled file view, strings point into it
+    size_t mapping_size;
+} ToxicDictionary;
+
+// stop words with a hash index for lookups
+typedef struct {
+    char** words;
+    int count;
+    int capacity;
+    StringIndex index;
+} StopwordList;
+
+// Everything an analysis reads. A loaded set is never modified: a reload
+// builds a new one and publishes it, and the old one is freed when the last
+// analysis holding a reference releases it
+typedef struct AnalyzerDictionaries {
+    ToxicDictionary toxic;
+    StopwordList stopwords;
+    unsigned long long hash;    // of the source files, part of cache keys
+    long long toxic_size;       // source stamps, to notice edits
+    long long toxic_mtime;
+    long long stop_size;
+    long long stop_mtime;
+    int generation;
+    int refs;
+} AnalyzerDictionaries;
+
+int dict_add(ToxicDictionary* dict, const char* phrase, ToxicitySeverity severity);
+int dict_load_text(ToxicDictionary* dict, const char* filename);
+int dict_find(const ToxicDictionary* dict, const char* lower, int len, unsigned int hash);
+void dict_free(ToxicDictionary* dict);
+
+// versioned binary form with the matcher index prebuilt
+int dict_compile(const ToxicDictionary* dict, const char* source_file, const char* output_file);
+int dict_map(ToxicDictionary* dict, const char* compiled_file, const char* source_file);
+
+int stopwords_add(StopwordList* list, const char* word);
+int stopwords_contains(const StopwordList* list, const char* word);
+int stopwords_load(StopwordList* list, const char* filename);
+void stopwords_free(StopwordList* list);
+
+// published dictionaries, the first acquire loads them if init was not called
+AnalyzerDictionaries* dictionaries_load(void);
+void dictionaries_init(void);
+void dictionaries_publish(AnalyzerDictionaries* next);
+AnalyzerDictionaries* dictionaries_acquire(void);
+void dictionaries_release(AnalyzerDictionaries* dicts);
+// another reference to a set already held, e.g. to outlive the stream that acquired it
+AnalyzerDictionaries* dictionaries_retain(AnalyzerDictionaries* dicts);
+int dictionaries_reload_if_changed(void);
+
+#endif
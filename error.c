@@ -2,8 +2,35 @@
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
+#include <stdarg.h>
 #include "error.h"
 
+static void print_log_message(LogLevel level, const char* message, void* data) {
+    (void)level;
+    (void)data;
+    fputs(message, stdout);
+}
+
+// where status messages go, an embedding program can catch or drop them
+static LogCallback log_callback = print_log_message;
+static void* log_callback_data = NULL;
+
+void set_log_callback(LogCallback callback, void* data) {
+    log_callback = callback;
+    log_callback_data = data;
+}
+
+void log_message(LogLevel level, const char* format, ...) {
+    if (log_callback == NULL) return;
+    
+    char message[1024];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(message, sizeof(message), format, args);
+    va_end(args);
+    log_callback(level, message, log_callback_data);
+}
+
 
 int extract_readable_text(const char* ifile, const char* output_file) {
     printf(" Extracting readable text from %s to %s\n", ifile, output_file);
@@ -208,45 +235,33 @@ int try_alternative_processing(const char* filename, ErrorCode error_code) {
     return success;
 }
 
-void handle_error(const char* context, ErrorCode error_code, const char* details) {
-    printf("\n ERROR in %s: ", context);
-    
+// recovery menus read stdin, batch runs turn them off
+static int interactive_mode = 1;
+
+void set_interactive_mode(int enabled) {
+    interactive_mode = enabled;
+}
+
+static const char* get_error_description(ErrorCode error_code) {
     switch(error_code) {
-        case ERROR_FILE_NOT_FOUND:
-            printf("File not found");
-            break;
-        case ERROR_FILE_EMPTY:
-            printf("File is empty");
-            break;
-        case ERROR_FILE_CORRUPTED:
-            printf("File appears corrupted");
-            break;
-        case ERROR_FILE_ENCODING:
-            printf("Unsupported file encoding");
-            break;
-        case ERROR_FILE_PERMISSION:
-            printf("Permission denied");
-            break;
-        case ERROR_FILE_TOO_LARGE:
-            printf("File too large");
-            break;
-        case ERROR_MEMORY_ALLOCATION:
-            printf("Memory allocation failed");
-            break;
-        case ERROR_CSV_FORMAT:
-            printf("Invalid CSV format");
-            break;
-        default:
-            printf("Unknown error");
-    }
-    
-    if (details) {
-        printf(" - %s", details);
+        case ERROR_FILE_NOT_FOUND: return "File not found";
+        case ERROR_FILE_EMPTY: return "File is empty";
+        case ERROR_FILE_CORRUPTED: return "File appears corrupted";
+        case ERROR_FILE_ENCODING: return "Unsupported file encoding";
+        case ERROR_FILE_PERMISSION: return "Permission denied";
+        case ERROR_FILE_TOO_LARGE: return "File too large";
+        case ERROR_MEMORY_ALLOCATION: return "Memory allocation failed";
+        case ERROR_CSV_FORMAT: return "Invalid CSV format";
+        default: return "Unknown error";
     }
-    printf("\n");
+}
+
+void handle_error(const char* context, ErrorCode error_code, const char* details) {
+    log_message(LOG_LEVEL_ERROR, "\n ERROR in %s: %s%s%s\n", context, get_error_description(error_code),
+                details ? " - " : "", details ? details : "");
     
     // Show recovery options
-    if (context && strstr(context, "file")) {
+    if (interactive_mode && context && strstr(context, "file")) {
         show_error_recovery_options(details ? details : context, error_code);
     }
 }
@@ -15,8 +15,24 @@ typedef enum {
     ERROR_UNKNOWN
 } ErrorCode;
 
+// message severity passed to the log callback
+typedef enum {
+    LOG_LEVEL_INFO = 0,
+    LOG_LEVEL_WARNING,
+    LOG_LEVEL_ERROR
+} LogLevel;
+
+// receives every status line of the analysis core, text ends with its newline
+typedef void (*LogCallback)(LogLevel level, const char* message, void* data);
+
+// Messages go to stdout until a callback is set, NULL silences them.
+// Set it before starting analyses, it is not locked
+void set_log_callback(LogCallback callback, void* data);
+void log_message(LogLevel level, const char* format, ...);
+
 // Handle errors when they happen
 void handle_error(const char* context, ErrorCode error_code, const char* details);
+void set_interactive_mode(int enabled);
 void show_error_recovery_options(const char* filename, ErrorCode error_code);
 int try_alternative_processing(const char* filename, ErrorCode error_code);
 
@@ -4,6 +4,14 @@
 #include "file.h"
 #include "error.h"
 #include "tool.h"
+#include "reader.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#include <io.h>
+#else
+#include <sys/stat.h>
+#endif
 
 // Check if file exists
 int file_exists(const char* filename) {
@@ -39,11 +47,75 @@ long get_file_size(const char* filename) {
     return size;
 }
 
+// File size that also works past 2 GB (long is 32 bits on Windows)
+long long get_large_file_size(const char* filename) {
+    FILE* file = fopen(filename, "rb");
+    if (file == NULL) 
+        return -1;
+#ifdef _WIN32
+    _fseeki64(file, 0, SEEK_END);
+    long long size = _ftelli64(file);
+#else
+    fseeko(file, 0, SEEK_END);
+    long long size = (long long)ftello(file);
+#endif
+    fclose(file);
+    return size;
+}
+
+// Seek to an absolute 64-bit offset, returns 0 on success
+int seek_file(FILE* file, long long offset) {
+#ifdef _WIN32
+    return _fseeki64(file, offset, SEEK_SET);
+#else
+    return fseeko(file, (off_t)offset, SEEK_SET);
+#endif
+}
+
+#ifdef _WIN32
+static int handle_identity(HANDLE handle, unsigned long long* identity) {
+    BY_HANDLE_FILE_INFORMATION info;
+    if (handle == INVALID_HANDLE_VALUE || !GetFileInformationByHandle(handle, &info)) return 0;
+    *identity = (((unsigned long long)info.nFileIndexHigh << 32) | info.nFileIndexLow) * 31 +
+                info.dwVolumeSerialNumber;
+    return 1;
+}
+#endif
+
+// Which file a path names right now, the same value until the file is
+// replaced (a rename keeps it). Returns 0 if the path cannot be read
+int get_file_identity(const char* filename, unsigned long long* identity) {
+#ifdef _WIN32
+    HANDLE handle = CreateFileA(filename, 0, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                                NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    int ok = handle_identity(handle, identity);
+    if (handle != INVALID_HANDLE_VALUE) CloseHandle(handle);
+    return ok;
+#else
+    struct stat info;
+    if (stat(filename, &info) != 0) return 0;
+    *identity = (unsigned long long)info.st_ino * 31 + (unsigned long long)info.st_dev;
+    return 1;
+#endif
+}
+
+// Identity of the file an open stream reads, see get_file_identity
+int get_open_file_identity(FILE* file, unsigned long long* identity) {
+#ifdef _WIN32
+    return handle_identity((HANDLE)_get_osfhandle(_fileno(file)), identity);
+#else
+    struct stat info;
+    if (fstat(fileno(file), &info) != 0) return 0;
+    *identity = (unsigned long long)info.st_ino * 31 + (unsigned long long)info.st_dev;
+    return 1;
+#endif
+}
+
 // Read a text file and return its content
 char* read_text_file(const char* fname) {
     FILE* f = fopen(fname, "r");
     if (!f) {
-        printf("Can't open %s\n", fname);  
+        log_message(LOG_LEVEL_ERROR, "Can't open %s\n", fname);  
         return NULL;
     }
 
@@ -52,20 +124,20 @@ char* read_text_file(const char* fname) {
     fseek(f, 0, SEEK_SET);
 
     if (sz <= 0) {
-        printf("File %s is empty\n", fname); 
+        log_message(LOG_LEVEL_WARNING, "File %s is empty\n", fname); 
         fclose(f);
         return NULL;
     }
 
     // check if readable
     if (is_file_corrupted(fname)) {
-        printf("File %s might be corrupted\n", fname);  
+        log_message(LOG_LEVEL_WARNING, "File %s might be corrupted\n", fname);  
         fclose(f);
         return NULL;
     }    
     int enc = detect_file_encoding(fname);
     if (enc == 2) { 
-        printf("UTF-16 not supported for %s\n", fname); 
+        log_message(LOG_LEVEL_WARNING, "UTF-16 not supported for %s\n", fname); 
         fclose(f);
         return NULL;
     }
@@ -82,15 +154,53 @@ char* read_text_file(const char* fname) {
     size_t bytes_read = fread(content, 1, sz, f);
     content[bytes_read] = '\0';
     fclose(f);    
-    printf("File %s loaded successfully (%ld bytes)\n", fname, bytes_read);
+    log_message(LOG_LEVEL_INFO, "File %s loaded successfully (%ld bytes)\n", fname, bytes_read);
     return content;
 }
 
+// Read from the current position until EOF, one chunk at a time.
+// Returns the number of bytes handed to the callback
+long long read_file_chunks(FILE* file, char* buffer, size_t chunk_size, ChunkCallback callback, void* data) {
+    long long total_read = 0;
+    size_t bytes_read;
+    
+    while ((bytes_read = fread(buffer, 1, chunk_size, file)) > 0) {
+        callback(buffer, bytes_read, data);
+        total_read += bytes_read;
+    }
+    return total_read;
+}
+
+// where read_large_file copies each chunk
+typedef struct {
+    char* content;
+    size_t total_read;
+    size_t file_size;
+} LargeFileBuffer;
+
+static void copy_large_file_chunk(const char* chunk, size_t len, void* data) {
+    LargeFileBuffer* target = (LargeFileBuffer*)data;
+    
+    // file may have grown since its size was taken
+    if (len > target->file_size - target->total_read) {
+        len = target->file_size - target->total_read;
+    }
+    memcpy(target->content + target->total_read, chunk, len);
+    target->total_read += len;
+    
+    // show process for big file
+    if (target->file_size > 10 * 1024 * 1024) {
+        int progress = (int)((target->total_read * 100) / target->file_size);
+        log_message(LOG_LEVEL_INFO, "\rReading file: %d%% complete", progress);
+        fflush(stdout);
+    }
+}
+
 // chunk by chunk read large files
 char* read_large_file(const char* filename) {
     FILE* file = fopen(filename, "r");
     if (file == NULL) {
-        printf("Error: Cannot open file %s\n", filename);
+        log_message(LOG_LEVEL_ERROR, "Error: Cannot open file %s\n", filename);
         return NULL;
     }
     // Get file size
@@ -98,67 +208,65 @@ char* read_large_file(const char* filename) {
     long file_size = ftell(file);
     fseek(file, 0, SEEK_SET);
     if (file_size <= 0) {
-        printf("Error: File is empty\n");
+        log_message(LOG_LEVEL_ERROR, "Error: File is empty\n");
         fclose(file);
         return NULL;
     }
 
     // Warn if file is huge (over 100MB)
     if (file_size > 100 * 1024 * 1024) {
-        printf("Warning: File is very large (%ld MB). Processing may take time.\n", file_size / (1024 * 1024));
+        log_message(LOG_LEVEL_WARNING, "Warning: File is very large (%ld MB). Processing may take time.\n", file_size / (1024 * 1024));
     }
 
     // Allocate memory
     char* content = (char*)malloc(file_size + 1);
     if (content == NULL) {
-        printf("Error: Memory allocation failed for large file\n");
+        log_message(LOG_LEVEL_ERROR, "Error: Memory allocation failed for large file\n");
         fclose(file);
         return NULL;
     }
 
-    // read file in chunk
-    size_t total_read = 0;
-    size_t chunk_size = 8192; // 8KB 
-
-    while (total_read < file_size) {
-        size_t to_read = (file_size - total_read < chunk_size) ? 
-                        (file_size - total_read) : chunk_size;
-        
-        size_t bytes_read = fread(content + total_read, 1, to_read, file);
-        if (bytes_read == 0) {
-            break; // error or EOF
-        }
-        total_read += bytes_read;
-        
-        // show process for big file
-        if (file_size > 10 * 1024 * 1024) {
-            int progress = (int)((total_read * 100) / file_size);
-            printf("\rReading file: %d%% complete", progress);
-            fflush(stdout);
-        }
-    }
+    // read file in chunk, the reader thread loads ahead while we copy
+    LargeFileBuffer target = {content, 0, (size_t)file_size};
+    read_file_ahead(file, copy_large_file_chunk, &target);
 
     if (file_size > 10 * 1024 * 1024) {
-        printf("\n"); // show done process
+        log_message(LOG_LEVEL_INFO, "\n"); // show done process
     }
-    content[total_read] = '\0';
+    content[target.total_read] = '\0';
     fclose(file);
-    printf("File %s loaded successfully (%ld bytes)\n", filename, total_read);
+    log_message(LOG_LEVEL_INFO, "File %s loaded successfully (%ld bytes)\n", filename, (long)target.total_read);
     return content;
 }
 
+// Load a file as plain text, CSV cells are joined, archives decompressed and
+// big files read in chunks
+char* load_file_text(const char* filename) {
+    const char* extension = get_file_extension(filename);
+    if (is_compressed_file(filename)) {
+        return read_compressed_text(filename);
+    }
+    if (strcmp(extension, ".csv") == 0) {
+        return csv_all_columns_to_text(filename);
+    }
+    if (get_file_size(filename) > 5 * 1024 * 1024) { // Use large file handler for >5MB
+        return read_large_file(filename);
+    }
+    return read_text_file(filename);
+}
+
 // Extract specific column from CSV and convert to text
 char* csv_column_to_text(const char* filename, int column_index) {
     FILE* file = fopen(filename, "r");
     if (file == NULL) {
-        printf("Error: Cannot open CSV file %s\n", filename);
+        log_message(LOG_LEVEL_ERROR, "Error: Cannot open CSV file %s\n", filename);
         return NULL;
     }
 
     char line[2048];
     char* result_text = malloc(1);
     if (result_text == NULL) {
-        printf("Error: Memory allocation failed\n");
+        log_message(LOG_LEVEL_ERROR, "Error: Memory allocation failed\n");
         fclose(file);
         return NULL;
     }
@@ -167,7 +275,7 @@ char* csv_column_to_text(const char* filename, int column_index) {
     int line_count = 0;
     int valid_columns = 0;
 
-    printf("Processing CSV file column %d...\n", column_index);
+    log_message(LOG_LEVEL_INFO, "Processing CSV file column %d...\n", column_index);
     
     while (fgets(line, sizeof(line), file)) {
         line_count++;
@@ -187,13 +295,12 @@ char* csv_column_to_text(const char* filename, int column_index) {
         char* column_content = NULL;
         
         // Split by comma and find target column
-        while ((token = strtok(rest, ",")) != NULL) {
+        while ((token = next_token(&rest, ",")) != NULL) {
             if (current_column == column_index) {
                 column_content = token;
                 break;
             }
             current_column++;
-            rest = NULL;
         }
         
         if (column_content != NULL && strlen(column_content) > 0) {
@@ -216,13 +323,13 @@ char* csv_column_to_text(const char* filename, int column_index) {
     fclose(file);
     
     if (valid_columns == 0) {
-        printf("Warning: No valid data found in column %d\n", column_index);
+        log_message(LOG_LEVEL_WARNING, "Warning: No valid data found in column %d\n", column_index);
         free(result_text);
         return NULL;
     }
     
-    printf("CSV column %d processed successfully: %d lines, %d valid entries\n", 
-           column_index, line_count, valid_columns);
+    log_message(LOG_LEVEL_INFO, "CSV column %d processed successfully: %d lines, %d valid entries\n",
+                column_index, line_count, valid_columns);
     return result_text;
 }
 
@@ -230,14 +337,14 @@ char* csv_column_to_text(const char* filename, int column_index) {
 char* csv_all_columns_to_text(const char* filename) {
     FILE* file = fopen(filename, "r");
     if (file == NULL) {
-        printf("Error: Cannot open CSV file %s\n", filename);
+        log_message(LOG_LEVEL_ERROR, "Error: Cannot open CSV file %s\n", filename);
         return NULL;
     }
 
     char line[2048];
     char* result_text = malloc(1);
     if (result_text == NULL) {
-        printf("Error: Memory allocation failed\n");
+        log_message(LOG_LEVEL_ERROR, "Error: Memory allocation failed\n");
         fclose(file);
         return NULL;
     }
@@ -246,7 +353,7 @@ char* csv_all_columns_to_text(const char* filename) {
     int line_count = 0;
     int total_columns = 0;
 
-    printf("Processing entire CSV file (all columns)...\n");
+    log_message(LOG_LEVEL_INFO, "Processing entire CSV file (all columns)...\n");
     
     while (fgets(line, sizeof(line), file)) {
         line_count++;
@@ -265,7 +372,7 @@ char* csv_all_columns_to_text(const char* filename) {
         int columns_in_line = 0;
         
         // Process all columns
-        while ((token = strtok(rest, ",")) != NULL) {
+        while ((token = next_token(&rest, ",")) != NULL) {
             char cleaned_content[1024];
             strcpy(cleaned_content, token);
             
@@ -282,7 +389,6 @@ char* csv_all_columns_to_text(const char* filename) {
                 total_columns++;
                 columns_in_line++;
             }
-            rest = NULL;
         }
         
         // Add newline after each row (maintain paragraph structure)
@@ -291,8 +397,8 @@ char* csv_all_columns_to_text(const char* filename) {
     
     fclose(file);
     
-    printf("CSV file processed successfully: %d lines, %d total text entries\n", 
-           line_count, total_columns);
+    log_message(LOG_LEVEL_INFO, "CSV file processed successfully: %d lines, %d total text entries\n",
+                line_count, total_columns);
     return result_text;
 }
 
@@ -319,10 +425,9 @@ void preview_csv_columns(const char* filename) {
             char* rest = line;
             int col_index = 0;
             
-            while ((token = strtok(rest, ",")) != NULL) {
+            while ((token = next_token(&rest, ",")) != NULL) {
                 printf("  Column %d: %s\n", col_index, token);
                 col_index++;
-                rest = NULL;
             }
             printf("\nData Preview:\n");
         } else {
@@ -340,11 +445,11 @@ int extract_csv_column_to_file(const char* csv_filename, int column_index, const
     FILE* txt_file = fopen(output_txt_filename, "w");
     
     if (csv_file == NULL) {
-        printf("Error: Cannot open CSV file %s\n", csv_filename);
+        log_message(LOG_LEVEL_ERROR, "Error: Cannot open CSV file %s\n", csv_filename);
         return 0;
     }
     if (txt_file == NULL) {
-        printf("Error: Cannot create output file %s\n", output_txt_filename);
+        log_message(LOG_LEVEL_ERROR, "Error: Cannot create output file %s\n", output_txt_filename);
         fclose(csv_file);
         return 0;
     }
@@ -353,7 +458,7 @@ int extract_csv_column_to_file(const char* csv_filename, int column_index, const
     int line_count = 0;
     int saved_entries = 0;
 
-    printf("Extracting column %d from %s to %s...\n", column_index, csv_filename, output_txt_filename);
+    log_message(LOG_LEVEL_INFO, "Extracting column %d from %s to %s...\n", column_index, csv_filename, output_txt_filename);
     
     while (fgets(line, sizeof(line), csv_file)) {
         line_count++;
@@ -373,13 +478,12 @@ int extract_csv_column_to_file(const char* csv_filename, int column_index, const
         char* column_content = NULL;
         
         // Split by comma and find target column
-        while ((token = strtok(rest, ",")) != NULL) {
+        while ((token = next_token(&rest, ",")) != NULL) {
             if (current_column == column_index) {
                 column_content = token;
                 break;
             }
             current_column++;
-            rest = NULL;
         }
         
         if (column_content != NULL && strlen(column_content) > 0) {
@@ -401,7 +505,7 @@ int extract_csv_column_to_file(const char* csv_filename, int column_index, const
     fclose(csv_file);
     fclose(txt_file);
     
-    printf("Extraction completed: %d lines processed, %d entries saved\n", line_count, saved_entries);
+    log_message(LOG_LEVEL_INFO, "Extraction completed: %d lines processed, %d entries saved\n", line_count, saved_entries);
     return 1;
 }
 
@@ -411,11 +515,11 @@ int extract_csv_all_to_file(const char* csv_filename, const char* output_txt_fil
     FILE* txt_file = fopen(output_txt_filename, "w");
     
     if (csv_file == NULL) {
-        printf("Error: Cannot open CSV file %s\n", csv_filename);
+        log_message(LOG_LEVEL_ERROR, "Error: Cannot open CSV file %s\n", csv_filename);
         return 0;
     }
     if (txt_file == NULL) {
-        printf("Error: Cannot create output file %s\n", output_txt_filename);
+        log_message(LOG_LEVEL_ERROR, "Error: Cannot create output file %s\n", output_txt_filename);
         fclose(csv_file);
         return 0;
     }
@@ -424,7 +528,7 @@ int extract_csv_all_to_file(const char* csv_filename, const char* output_txt_fil
     int line_count = 0;
     int total_entries = 0;
 
-    printf("Extracting text from %s to %s...\n", csv_filename, output_txt_filename);
+    log_message(LOG_LEVEL_INFO, "Extracting text from %s to %s...\n", csv_filename, output_txt_filename);
     
     while (fgets(line, sizeof(line), csv_file)) {
         line_count++;
@@ -449,7 +553,7 @@ int extract_csv_all_to_file(const char* csv_filename, const char* output_txt_fil
             char row_text[2048] = "";
             
             // Process all columns
-            while ((token = strtok(rest, ",")) != NULL) {
+            while ((token = next_token(&rest, ",")) != NULL) {
                 char cleaned_content[1024];
                 strcpy(cleaned_content, token);
                 
@@ -475,7 +579,6 @@ int extract_csv_all_to_file(const char* csv_filename, const char* output_txt_fil
                     strcat(row_text, trimmed_content);
                     columns_in_line++;
                 }
-                rest = NULL;
             }
             
             // Write the combined row text to file
@@ -489,20 +592,20 @@ int extract_csv_all_to_file(const char* csv_filename, const char* output_txt_fil
     fclose(csv_file);
     fclose(txt_file);
     
-    printf("Extraction completed: %d lines processed, %d text entries saved\n", line_count, total_entries);
+    log_message(LOG_LEVEL_INFO, "Extraction completed: %d lines processed, %d text entries saved\n", line_count, total_entries);
     return 1;
 }
 
 // Process multiple files
 char* process_multiple_files(const char** filenames, int file_count) {
     if (filenames == NULL || file_count <= 0) {
-        printf("Error: No files specified\n");
+        log_message(LOG_LEVEL_ERROR, "Error: No files specified\n");
         return NULL;
     }
 
     char* combined_text = malloc(1);
     if (combined_text == NULL) {
-        printf("Error: Memory allocation failed\n");
+        log_message(LOG_LEVEL_ERROR, "Error: Memory allocation failed\n");
         return NULL;
     }
     combined_text[0] = '\0';
@@ -510,50 +613,39 @@ char* process_multiple_files(const char** filenames, int file_count) {
     int successful_files = 0;
     long total_size = 0;
 
-    printf("Processing %d files...\n", file_count);
+    log_message(LOG_LEVEL_INFO, "Processing %d files...\n", file_count);
 
     for (int i = 0; i < file_count; i++) {
         const char* filename = filenames[i];
         
-        printf("\nFile %d/%d: %s\n", i + 1, file_count, filename);
+        log_message(LOG_LEVEL_INFO, "\nFile %d/%d: %s\n", i + 1, file_count, filename);
         
        // Check if file exists
         if (!file_exists(filename)) {
-            printf("  Warning: File does not exist, skipping\n");
+            log_message(LOG_LEVEL_WARNING, "  Warning: File does not exist, skipping\n");
             continue;
         }
 
         // Check if file is empty
         if (is_file_empty(filename)) {
-            printf("  Warning: File is empty, skipping\n");
+            log_message(LOG_LEVEL_WARNING, "  Warning: File is empty, skipping\n");
             continue;
         }
 
         // Get file size
         long size = get_file_size(filename);
         if (size > 0) {
-            printf("  Size: %ld bytes\n", size);
+            log_message(LOG_LEVEL_INFO, "  Size: %ld bytes\n", size);
             total_size += size;
         }
 
         // Handle based on file type
         const char* extension = get_file_extension(filename);
-        char* file_content = NULL;
-
-        if (strcmp(extension, ".csv") == 0) {
-            // Handle CSV file
-            file_content = csv_all_columns_to_text(filename);
-        } else if (strcmp(extension, ".txt") == 0) {
-            // Handle text file
-            if (size > 5 * 1024 * 1024) { // Use large file handler for >5MB
-                file_content = read_large_file(filename);
-            } else {
-                file_content = read_text_file(filename);
-            }
-        } else {
-            printf("  Warning: Unsupported file type '%s', skipping\n", extension);
+        if (strcmp(extension, ".csv") != 0 && strcmp(extension, ".txt") != 0 && !is_compressed_file(filename)) {
+            log_message(LOG_LEVEL_WARNING, "  Warning: Unsupported file type '%s', skipping\n", extension);
             continue;
         }
+        char* file_content = load_file_text(filename);
 
         if (file_content != NULL) {
             
@@ -566,20 +658,20 @@ char* process_multiple_files(const char** filenames, int file_count) {
             
             free(file_content);
             successful_files++;
-            printf("   Processed successfully\n");
+            log_message(LOG_LEVEL_INFO, "   Processed successfully\n");
         } else {
-            printf("   Failed to process file\n");
+            log_message(LOG_LEVEL_ERROR, "   Failed to process file\n");
         }
     }
 
     if (successful_files == 0) {
-        printf("\nError: No files were successfully processed\n");
+        log_message(LOG_LEVEL_ERROR, "\nError: No files were successfully processed\n");
         free(combined_text);
         return NULL;
     }
 
-    printf("\nProcessing completed: %d/%d files successful, total size: %ld bytes\n", 
-           successful_files, file_count, total_size);
+    log_message(LOG_LEVEL_INFO, "\nProcessing completed: %d/%d files successful, total size: %ld bytes\n",
+                successful_files, file_count, total_size);
     
     return combined_text;
 }
\ No newline at end of file
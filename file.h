@@ -1,6 +1,10 @@
 #ifndef FILE_PROCESSOR_H
 #define FILE_PROCESSOR_H
 
+#include <stdio.h>
+
+// called for each chunk read by read_file_chunks
+typedef void (*ChunkCallback)(const char* chunk, size_t len, void* data);
 
 char* read_text_file(const char* filename);
 char* csv_column_to_text(const char* filename, int column_index);
@@ -13,7 +17,13 @@ int extract_csv_all_to_file(const char* csv_filename, const char* output_txt_fil
 
 char* process_multiple_files(const char** filenames, int file_count);
 char* read_large_file(const char* filename);
+char* load_file_text(const char* filename);
 int is_file_empty(const char* filename);
 long get_file_size(const char* filename);
+long long get_large_file_size(const char* filename);
+int seek_file(FILE* file, long long offset);
+int get_file_identity(const char* filename, unsigned long long* identity);
+int get_open_file_identity(FILE* file, unsigned long long* identity);
+long long read_file_chunks(FILE* file, char* buffer, size_t chunk_size, ChunkCallback callback, void* data);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,315 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include "follow.h"
+#include "content.h"
+#include "file.h"
+#include "dict.h"
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <poll.h>
+#include <unistd.h>
+#include <errno.h>
+#define USE_INOTIFY 1
+#elif defined(_WIN32)
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+#define FOLLOW_CHUNK_SIZE 65536
+#ifdef USE_INOTIFY
+// a rotated log is renamed or deleted, the watch then has to move to the new file
+#define FOLLOW_EVENTS (IN_MODIFY | IN_ATTRIB | IN_MOVE_SELF | IN_DELETE_SELF)
+#endif
+
+// word and hit counts of one line in the sliding window
+typedef struct {
+    int words;
+    int severity[MAX_SEVERITY_LEVELS];
+} WindowLine;
+
+// one watched file
+typedef struct {
+    const char* filename;
+    FILE* file;
+    long long offset;
+    unsigned long long identity;    // file being read, see get_file_identity
+    int watch;
+    unsigned long long watched;     // identity the inotify watch was added for
+    AnalysisStream stream;
+
+    // ring of the last window_size lines with running sums
+    WindowLine* window;
+    int window_size;
+    int window_pos;
+    int window_filled;
+    int window_words;
+    int window_severity[MAX_SEVERITY_LEVELS];
+
+    long long line_number;
+    int alerting;
+    int threshold;
+} FollowedFile;
+
+static volatile sig_atomic_t follow_stop = 0;
+
+static void handle_stop_signal(int sig) {
+    (void)sig;
+    follow_stop = 1;
+}
+
+// Called by the stream after every complete line. The window score uses the
+// same formula as calculate_toxicity_score with hits counted per severity
+static void follow_line(AnalysisStream* stream, void* data) {
+    FollowedFile* followed = (FollowedFile*)data;
+    WindowLine* slot = &followed->window[followed->window_pos];
+
+    followed->line_number++;
+
+    // drop the oldest line once the window is full
+    if (followed->window_filled == followed->window_size) {
+        followed->window_words -= slot->words;
+        for (int i = 0; i < MAX_SEVERITY_LEVELS; i++) {
+            followed->window_severity[i] -= slot->severity[i];
+        }
+    } else {
+        followed->window_filled++;
+    }
+
+    slot->words = stream->line_words;
+    followed->window_words += slot->words;
+    int hits = 0;
+    for (int i = 0; i < MAX_SEVERITY_LEVELS; i++) {
+        slot->severity[i] = stream->line_severity[i];
+        followed->window_severity[i] += slot->severity[i];
+        hits += followed->window_severity[i];
+    }
+    followed->window_pos = (followed->window_pos + 1) % followed->window_size;
+
+    int score = score_toxicity_counts(followed->window_words, hits, followed->window_severity);
+
+    if (!followed->alerting && score >= followed->threshold) {
+        followed->alerting = 1;
+        printf("[ALERT] %s line %lld: toxicity score %d/100 (%s) over last %d lines\n",
+               followed->filename, followed->line_number, score, get_toxicity_level(score),
+               followed->window_filled);
+        fflush(stdout);
+    } else if (followed->alerting && score < followed->threshold) {
+        followed->alerting = 0;
+        printf("[CLEAR] %s line %lld: toxicity score back to %d/100\n",
+               followed->filename, followed->line_number, score);
+        fflush(stdout);
+    }
+}
+
+static void feed_followed_chunk(const char* chunk, size_t len, void* data) {
+    FollowedFile* followed = (FollowedFile*)data;
+    analysis_stream_feed(&followed->stream, chunk, len);
+}
+
+// The path names another file than the one being read, e.g. after log rotation
+static int followed_file_replaced(const FollowedFile* followed) {
+    unsigned long long identity;
+    return get_file_identity(followed->filename, &identity) && identity != followed->identity;
+}
+
+// Finish the old file and continue with the one now at the path
+static void reopen_followed_file(FollowedFile* followed, char* buffer) {
+    FILE* next = fopen(followed->filename, "rb");
+    if (next == NULL) return;
+
+    clearerr(followed->file);
+    followed->offset += read_file_chunks(followed->file, buffer, FOLLOW_CHUNK_SIZE,
+                                         feed_followed_chunk, followed);
+    // the old file's last line ends here, not on the new file's first line
+    if (followed->stream.line_len > 0) {
+        analysis_stream_feed(&followed->stream, "\n", 1);
+    }
+    fclose(followed->file);
+    followed->file = next;
+    followed->offset = 0;
+    get_open_file_identity(next, &followed->identity);
+    printf("[INFO] %s was replaced (rotated), following the new file\n", followed->filename);
+    fflush(stdout);
+}
+
+// Feed everything appended since the last read
+static void read_new_data(FollowedFile* followed, char* buffer) {
+    if (followed_file_replaced(followed)) {
+        reopen_followed_file(followed, buffer);
+    }
+    long long size = get_large_file_size(followed->filename);
+    if (size >= 0 && size < followed->offset) {
+        printf("[INFO] %s was truncated, following from the start\n", followed->filename);
+        seek_file(followed->file, 0);
+        followed->offset = 0;
+    }
+
+    // new lines use the latest dictionaries once a reload has been published
+    analysis_stream_refresh_dictionaries(&followed->stream);
+    clearerr(followed->file);
+    followed->offset += read_file_chunks(followed->file, buffer, FOLLOW_CHUNK_SIZE,
+                                         feed_followed_chunk, followed);
+}
+
+static void sleep_ms(int ms) {
+#ifdef _WIN32
+    Sleep(ms);
+#else
+    usleep(ms * 1000);
+#endif
+}
+
+int follow_files(const char** filenames, int file_count, int window_lines, int threshold) {
+    if (filenames == NULL || file_count <= 0) {
+        printf("Error: No files to follow\n");
+        return 1;
+    }
+    if (window_lines <= 0) window_lines = FOLLOW_DEFAULT_WINDOW;
+
+    FollowedFile* files = (FollowedFile*)calloc(file_count, sizeof(FollowedFile));
+    char* buffer = (char*)malloc(FOLLOW_CHUNK_SIZE);
+    if (files == NULL || buffer == NULL) {
+        printf("Error: Memory allocation failed\n");
+        free(files);
+        free(buffer);
+        return 1;
+    }
+
+    int opened = 0;
+    for (int i = 0; i < file_count; i++) {
+        FollowedFile* followed = &files[i];
+        followed->filename = filenames[i];
+        followed->watch = -1;
+        followed->file = fopen(filenames[i], "rb");
+        if (followed->file == NULL) {
+            printf("  Warning: Cannot open %s, not following it\n", filenames[i]);
+            continue;
+        }
+
+        // like tail -f, only new lines are analyzed
+        followed->offset = get_large_file_size(filenames[i]);
+        if (followed->offset < 0) followed->offset = 0;
+        seek_file(followed->file, followed->offset);
+        get_open_file_identity(followed->file, &followed->identity);
+
+        followed->window = (WindowLine*)calloc(window_lines, sizeof(WindowLine));
+        if (followed->window == NULL) {
+            printf("  Warning: Not enough memory to follow %s\n", filenames[i]);
+            fclose(followed->file);
+            followed->file = NULL;
+            continue;
+        }
+        followed->window_size = window_lines;
+        followed->threshold = threshold;
+        analysis_stream_init(&followed->stream);
+        followed->stream.on_line = follow_line;
+        followed->stream.callback_data = followed;
+        opened++;
+    }
+
+    if (opened == 0) {
+        printf("Error: No files could be opened\n");
+        free(files);
+        free(buffer);
+        return 1;
+    }
+
+    printf("Following %d file(s), window %d lines, alert threshold %d. Press Ctrl+C to stop.\n",
+           opened, window_lines, threshold);
+    fflush(stdout);
+
+#ifdef USE_INOTIFY
+    // no SA_RESTART so Ctrl+C interrupts the blocking read
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = handle_stop_signal;
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+
+    int notify_fd = inotify_init();
+    if (notify_fd < 0) {
+        printf("  Warning: inotify unavailable, polling every %d ms\n", FOLLOW_POLL_MS);
+    }
+    for (int i = 0; i < file_count && notify_fd >= 0; i++) {
+        if (files[i].file) {
+            files[i].watch = inotify_add_watch(notify_fd, files[i].filename, FOLLOW_EVENTS);
+            files[i].watched = files[i].identity;
+        }
+    }
+
+    // sleeps until one of the files changes, waking up now and then to
+    // notice edited dictionaries
+    char events[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    struct pollfd waiter = {notify_fd, POLLIN, 0};
+    while (!follow_stop && notify_fd >= 0) {
+        int ready = poll(&waiter, 1, DICT_RELOAD_CHECK_MS);
+        dictionaries_reload_if_changed();
+        if (ready < 0 && errno != EINTR) break;
+
+        ssize_t len = (ready > 0) ? read(notify_fd, events, sizeof(events)) : 0;
+        if (len < 0 && errno != EINTR) break;
+        for (char* ptr = events; ptr < events + len; ) {
+            struct inotify_event* event = (struct inotify_event*)ptr;
+            for (int i = 0; i < file_count; i++) {
+                if (files[i].file && files[i].watch == event->wd) {
+                    read_new_data(&files[i], buffer);
+                    if (event->mask & IN_IGNORED) files[i].watch = -1;
+                }
+            }
+            ptr += sizeof(struct inotify_event) + event->len;
+        }
+
+        // a file replaced at the path sends nothing to the old watch, so the
+        // path is checked on every wake and the watch moves with the file
+        for (int i = 0; i < file_count; i++) {
+            if (files[i].file == NULL) continue;
+            if (followed_file_replaced(&files[i])) {
+                read_new_data(&files[i], buffer);
+            }
+            if (files[i].watch < 0 || files[i].watched != files[i].identity) {
+                if (files[i].watch >= 0) inotify_rm_watch(notify_fd, files[i].watch);
+                files[i].watch = inotify_add_watch(notify_fd, files[i].filename, FOLLOW_EVENTS);
+                files[i].watched = files[i].identity;
+            }
+        }
+    }
+    if (notify_fd >= 0) {
+        close(notify_fd);
+    }
+#else
+    signal(SIGINT, handle_stop_signal);
+    signal(SIGTERM, handle_stop_signal);
+#endif
+
+    // polling fallback
+    while (!follow_stop) {
+        dictionaries_reload_if_changed();
+        for (int i = 0; i < file_count; i++) {
+            if (files[i].file) {
+                read_new_data(&files[i], buffer);
+            }
+        }
+        sleep_ms(FOLLOW_POLL_MS);
+    }
+
+    printf("\nStopped following.\n");
+    for (int i = 0; i < file_count; i++) {
+        FollowedFile* followed = &files[i];
+        if (followed->file == NULL) continue;
+
+        AnalysisResult total = analysis_stream_finish(&followed->stream);
+        printf("  %s: %lld new lines, %lld words, %d toxic hits\n", followed->filename,
+               followed->line_number, total.word_count, total.toxic_word_count);
+        cleanup_analyzer(&total);
+        fclose(followed->file);
+        free(followed->window);
+    }
+
+    free(files);
+    free(buffer);
+    return 0;
+}
@@ -0,0 +1,11 @@
+#ifndef FOLLOW_H
+#define FOLLOW_H
+
+#define FOLLOW_DEFAULT_WINDOW 50      // lines in the sliding window
+#define FOLLOW_DEFAULT_THRESHOLD 50   // toxicity score that raises an alert
+#define FOLLOW_POLL_MS 250            // poll interval without inotify
+
+// Watch growing files and alert when the windowed toxicity score crosses threshold
+int follow_files(const char** filenames, int file_count, int window_lines, int threshold);
+
+#endif
@@ -0,0 +1,283 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include "hits.h"
+#include "error.h"
+#include "file.h"
+#include "tool.h"
+
+static const char HITS_MAGIC_BYTES[8] = HITS_MAGIC;
+
+#define HITS_HEADER_BYTES 16
+#define HITS_BYTES_PER_HIT 17
+
+void hit_list_init(HitList* list) {
+    memset(list, 0, sizeof(HitList));
+}
+
+void hit_list_free(HitList* list) {
+    free(list->phrase_ids);
+    free(list->offsets);
+    free(list->lines);
+    free(list->severities);
+    free(list->line.ids);
+    free(list->line.starts);
+    dictionaries_release(list->dict);
+    hit_list_init(list);
+}
+
+void hit_list_attach(HitList* list, AnalysisStream* stream) {
+    stream->hit_list = list;
+    if (list->dict == NULL) {
+        list->dict = dictionaries_retain(stream->dict);
+    }
+}
+
+static int hit_list_reserve(HitList* list) {
+    if (list->count < list->capacity) return 1;
+    long long capacity = list->capacity ? list->capacity * 2 : 1024;
+    int* ids = (int*)realloc(list->phrase_ids, capacity * sizeof(int));
+    if (ids != NULL) list->phrase_ids = ids;
+    long long* offsets = (long long*)realloc(list->offsets, capacity * sizeof(long long));
+    if (offsets != NULL) list->offsets = offsets;
+    unsigned int* lines = (unsigned int*)realloc(list->lines, capacity * sizeof(unsigned int));
+    if (lines != NULL) list->lines = lines;
+    unsigned char* severities = (unsigned char*)realloc(list->severities, capacity);
+    if (severities != NULL) list->severities = severities;
+    if (ids == NULL || offsets == NULL || lines == NULL || severities == NULL) {
+        list->failed = 1;
+        return 0;
+    }
+    list->capacity = capacity;
+    return 1;
+}
+
+void hit_list_add_line(HitList* list, const ToxicDictionary* dict, const PhraseIdList* matched,
+                       long long line_offset, long long line_number) {
+    for (int i = 0; i < matched->count; i++) {
+        if (!hit_list_reserve(list)) return;
+        int id = matched->ids[i];
+        list->phrase_ids[list->count] = id;
+        list->offsets[list->count] = line_offset + matched->starts[i];
+        list->lines[list->count] = (unsigned int)line_number;
+        list->severities[list->count] = dict->severity[id];
+        list->count++;
+    }
+}
+
+// Hits are appended line by line, so the lines column is sorted
+long long hit_list_find_line(const HitList* list, long long line) {
+    long long low = 0, high = list->count;
+    while (low < high) {
+        long long mid = low + (high - low) / 2;
+        if (list->lines[mid] < line) low = mid + 1;
+        else high = mid;
+    }
+    return low;
+}
+
+//  WRITING
+
+static void put_le(unsigned char* out, unsigned long long value, int bytes) {
+    for (int i = 0; i < bytes; i++) {
+        out[i] = (unsigned char)(value >> (8 * i));
+    }
+}
+
+// one column through a block buffer, values of bytes width each
+static int write_column(FILE* file, const HitList* list, int column, int bytes) {
+    unsigned char block[65536];
+    size_t len = 0;
+    for (long long i = 0; i < list->count; i++) {
+        unsigned long long value = 0;
+        switch (column) {
+            case 0: value = (unsigned int)list->phrase_ids[i]; break;
+            case 1: value = (unsigned long long)list->offsets[i]; break;
+            case 2: value = list->lines[i]; break;
+            default: value = list->severities[i]; break;
+        }
+        if (len + bytes > sizeof(block)) {
+            if (fwrite(block, 1, len, file) != len) return 0;
+            len = 0;
+        }
+        put_le(block + len, value, bytes);
+        len += bytes;
+    }
+    return fwrite(block, 1, len, file) == len;
+}
+
+int save_hit_index(const char* filename, const HitList* list) {
+    if (list->failed) {
+        log_message(LOG_LEVEL_ERROR, "Error: Not enough memory to record every hit, %s not written\n", filename);
+        return 0;
+    }
+    FILE* file = fopen(filename, "wb");
+    if (file == NULL) {
+        log_message(LOG_LEVEL_ERROR, "Error: Cannot create hit index %s\n", filename);
+        return 0;
+    }
+
+    // the texts of the phrases that occur, so the file reads without the dictionary
+    const ToxicDictionary* dict = list->dict ? &list->dict->toxic : NULL;
+    int slots = dict ? dict->count : 0;
+    unsigned char* used = (unsigned char*)calloc(slots + 1, 1);
+    int phrases = 0;
+    for (long long i = 0; i < list->count && used != NULL; i++) {
+        if (!used[list->phrase_ids[i]]) {
+            used[list->phrase_ids[i]] = 1;
+            phrases++;
+        }
+    }
+
+    unsigned char header[HITS_HEADER_BYTES + 4];
+    memcpy(header, HITS_MAGIC_BYTES, 8);
+    put_le(header + 8, list->count, 8);
+    put_le(header + 16, phrases, 4);
+    int ok = (used != NULL) && fwrite(header, 1, sizeof(header), file) == sizeof(header);
+    for (int id = 0; id < slots && ok; id++) {
+        if (!used[id]) continue;
+        unsigned char entry[6];
+        size_t len = strlen(dict->text[id]);
+        if (len > 255) len = 255;
+        put_le(entry, id, 4);
+        entry[4] = dict->severity[id];
+        entry[5] = (unsigned char)len;
+        ok = fwrite(entry, 1, 6, file) == 6 && fwrite(dict->text[id], 1, len, file) == len;
+    }
+    ok = ok && write_column(file, list, 0, 4) && write_column(file, list, 1, 8) &&
+         write_column(file, list, 2, 4) && write_column(file, list, 3, 1);
+    if (fclose(file) != 0) ok = 0;
+    free(used);
+
+    if (!ok) {
+        log_message(LOG_LEVEL_ERROR, "Error: Cannot write hit index %s\n", filename);
+        return 0;
+    }
+    log_message(LOG_LEVEL_INFO, " Hit index saved to: %s (%lld hits)\n", filename, list->count);
+    return 1;
+}
+
+//  READING
+
+static unsigned long long get_le(const unsigned char* p, int bytes) {
+    unsigned long long value = 0;
+    for (int i = bytes - 1; i >= 0; i--) {
+        value = (value << 8) | p[i];
+    }
+    return value;
+}
+
+typedef struct {
+    int id;
+    int wanted;                 // passes the phrase filter
+    char text[256];
+} HitPhrase;
+
+// Phrases are stored in ascending id order, -1 if id is not among them
+static int find_phrase(const HitPhrase* phrases, int count, long long id) {
+    int low = 0, high = count;
+    while (low < high) {
+        int mid = low + (high - low) / 2;
+        if (phrases[mid].id < id) low = mid + 1;
+        else high = mid;
+    }
+    return (low < count && phrases[low].id == id) ? low : -1;
+}
+
+long long query_hit_index(const char* filename, const HitQuery* query, FILE* out) {
+    long long size = get_large_file_size(filename);
+    FILE* file = fopen(filename, "rb");
+    if (file == NULL || size < HITS_HEADER_BYTES + 4) {
+        log_message(LOG_LEVEL_ERROR, "Error: Cannot open hit index %s\n", filename);
+        if (file) fclose(file);
+        return -1;
+    }
+    unsigned char* data = (unsigned char*)malloc(size);
+    size_t got = (data != NULL) ? fread(data, 1, size, file) : 0;
+    fclose(file);
+    if (data == NULL || got != (size_t)size || memcmp(data, HITS_MAGIC_BYTES, 8) != 0) {
+        log_message(LOG_LEVEL_ERROR, "Error: %s is not a hit index\n", filename);
+        free(data);
+        return -1;
+    }
+
+    // counts are checked against the file size before anything is sized from them
+    unsigned long long body = (unsigned long long)(size - HITS_HEADER_BYTES - 4);
+    unsigned long long count = get_le(data + 8, 8);
+    unsigned long long phrase_count = get_le(data + 16, 4);
+    int damaged = (count > body / HITS_BYTES_PER_HIT || phrase_count > body / 6);
+    HitPhrase* phrases = damaged ? NULL : (HitPhrase*)calloc(phrase_count + 1, sizeof(HitPhrase));
+    const unsigned char* p = data + HITS_HEADER_BYTES + 4;
+    const unsigned char* end = data + size;
+    char wanted[256] = "";
+    if (query->phrase != NULL) {
+        strncpy(wanted, query->phrase, sizeof(wanted) - 1);
+        to_lower_case(wanted);
+    }
+    if (phrases == NULL) damaged = 1;
+    for (int i = 0; i < (int)phrase_count && !damaged; i++) {
+        if (end - p < 6 || end - p < 6 + p[5]) {
+            damaged = 1;
+            break;
+        }
+        // ids are dictionary positions written in ascending order
+        long long id = (long long)get_le(p, 4);
+        if (id > INT_MAX || (i > 0 && id <= phrases[i - 1].id)) {
+            damaged = 1;
+            break;
+        }
+        char lower[256];
+        phrases[i].id = (int)id;
+        memcpy(phrases[i].text, p + 6, p[5]);
+        memcpy(lower, phrases[i].text, sizeof(lower));
+        to_lower_case(lower);
+        phrases[i].wanted = (query->phrase == NULL || strcmp(lower, wanted) == 0);
+        p += 6 + p[5];
+    }
+    if (!damaged && (unsigned long long)(end - p) != count * HITS_BYTES_PER_HIT) {
+        damaged = 1;
+    }
+    const unsigned char* ids = p;
+    const unsigned char* offsets = ids + count * 4;
+    const unsigned char* lines = offsets + count * 8;
+    const unsigned char* severities = lines + count * 4;
+    for (unsigned long long i = 0; i < count && !damaged; i++) {
+        if (severities[i] >= MAX_SEVERITY_LEVELS) damaged = 1;
+    }
+    if (damaged) {
+        log_message(LOG_LEVEL_ERROR, "Error: Hit index %s is damaged\n", filename);
+        free(phrases);
+        free(data);
+        return -1;
+    }
+
+    // jump to the first line asked for
+    long long first = 0, high = (long long)count;
+    if (query->first_line > 0) {
+        while (first < high) {
+            long long mid = first + (high - first) / 2;
+            if ((long long)get_le(lines + mid * 4, 4) < query->first_line) first = mid + 1;
+            else high = mid;
+        }
+    }
+
+    long long printed = 0;
+    fprintf(out, "Offset,Line,Severity,Phrase\n");
+    for (long long i = first; i < (long long)count; i++) {
+        if (query->limit >= 0 && printed >= query->limit) break;
+        long long line = (long long)get_le(lines + i * 4, 4);
+        if (query->last_line > 0 && line > query->last_line) break;
+        int severity = severities[i];
+        if (query->severity >= 0 && severity != query->severity) continue;
+        int index = find_phrase(phrases, (int)phrase_count, (long long)get_le(ids + i * 4, 4));
+        if (index < 0 || !phrases[index].wanted) continue;
+        const char* text = phrases[index].text;
+        fprintf(out, "%lld,%lld,%s,%s\n", (long long)get_le(offsets + i * 8, 8), line,
+                get_severity_name((ToxicitySeverity)severity), text);
+        printed++;
+    }
+    free(phrases);
+    free(data);
+    return printed;
+}
@@ -0,0 +1,59 @@
+#ifndef HITS_H
+#define HITS_H
+
+#include <stdio.h>
+#include "content.h"
+#include "dict.h"
+
+// Every toxic phrase match of a text in a hit index file (.thit):
+//
+//   "TOXHIT1\0", u64 hit count,
+//   u32 phrase count, per phrase u32 id + u8 severity + u8 length + text,
+//   then the columns one after another: u32 phrase id, u64 byte offset,
+//   u32 line number, u8 severity, each hit count entries long
+//
+// Fixed-width little endian columns in file order, so hits are sorted by
+// offset and line and a line range is found by binary search
+#define HITS_MAGIC "TOXHIT1"
+
+// Growable struct-of-arrays list of matches, 17 bytes per hit
+typedef struct HitList {
+    int* phrase_ids;            // position in the dictionary
+    long long* offsets;         // byte where the match starts
+    unsigned int* lines;        // 1-based line number
+    unsigned char* severities;
+    long long count;
+    long long capacity;
+    int failed;
+    PhraseIdList line;          // matches of the line being recorded
+    AnalyzerDictionaries* dict; // phrase texts for the ids, held until freed
+} HitList;
+
+// options for analyzer --hits-query
+typedef struct {
+    const char* phrase;         // only this phrase, NULL for all
+    int severity;               // only this severity, -1 for all
+    long long first_line;       // line range, 0 for no bound
+    long long last_line;
+    long long limit;            // hits printed at most, < 0 for all
+} HitQuery;
+
+void hit_list_init(HitList* list);
+void hit_list_free(HitList* list);
+
+// Record every match of the stream from now on
+void hit_list_attach(HitList* list, AnalysisStream* stream);
+
+// called by the stream for each finished line
+void hit_list_add_line(HitList* list, const ToxicDictionary* dict, const PhraseIdList* matched,
+                       long long line_offset, long long line_number);
+
+// first hit on line or later, count if there is none
+long long hit_list_find_line(const HitList* list, long long line);
+
+int save_hit_index(const char* filename, const HitList* list);
+
+// Print the hits of a .thit file that match the query as CSV. Returns hits printed or -1
+long long query_hit_index(const char* filename, const HitQuery* query, FILE* out);
+
+#endif
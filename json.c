@@ -0,0 +1,308 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "json.h"
+#include "error.h"
+#include "spill.h"
+#include "sketch.h"
+
+static const long long decimal_scales[] = {
+    1LL, 10LL, 100LL, 1000LL, 10000LL, 100000LL, 1000000LL, 10000000LL, 100000000LL, 1000000000LL
+};
+
+int json_writer_init(JsonWriter* writer, FILE* file) {
+    memset(writer, 0, sizeof(JsonWriter));
+    writer->file = file;
+    // memory writers start small and grow to the largest record they hold
+    writer->cap = file ? JSON_BUFFER_SIZE : JSON_BUFFER_SIZE / 64;
+    writer->data = (char*)malloc(writer->cap);
+    if (writer->data == NULL) {
+        writer->cap = 0;
+        writer->failed = 1;
+        return 0;
+    }
+    return 1;
+}
+
+// Forget buffered output and nesting but keep the buffer for the next record
+void json_writer_reset(JsonWriter* writer) {
+    writer->len = 0;
+    writer->failed = (writer->data == NULL);
+    writer->depth = 0;
+    writer->after_key = 0;
+    memset(writer->has_items, 0, sizeof(writer->has_items));
+}
+
+int json_writer_flush(JsonWriter* writer) {
+    if (writer->file != NULL && writer->len > 0) {
+        if (fwrite(writer->data, 1, writer->len, writer->file) != writer->len) {
+            writer->failed = 1;
+        }
+        writer->len = 0;
+    }
+    return !writer->failed;
+}
+
+void json_writer_free(JsonWriter* writer) {
+    json_writer_flush(writer);
+    free(writer->data);
+    writer->data = NULL;
+    writer->cap = 0;
+    writer->len = 0;
+}
+
+// Make room for extra bytes: file writers drain the buffer, memory writers grow it
+static int json_reserve(JsonWriter* writer, size_t extra) {
+    if (writer->failed) return 0;
+    if (writer->len + extra <= writer->cap) return 1;
+
+    if (writer->file != NULL) {
+        json_writer_flush(writer);
+        if (extra <= writer->cap) return !writer->failed;
+    }
+    size_t cap = writer->cap ? writer->cap : JSON_BUFFER_SIZE;
+    while (cap < writer->len + extra) cap *= 2;
+    char* data = (char*)realloc(writer->data, cap);
+    if (data == NULL) {
+        writer->failed = 1;
+        return 0;
+    }
+    writer->data = data;
+    writer->cap = cap;
+    return 1;
+}
+
+static void json_raw(JsonWriter* writer, const char* text, size_t len) {
+    if (!json_reserve(writer, len)) return;
+    memcpy(writer->data + writer->len, text, len);
+    writer->len += len;
+}
+
+static void json_char(JsonWriter* writer, char c) {
+    if (!json_reserve(writer, 1)) return;
+    writer->data[writer->len++] = c;
+}
+
+// comma between values, nothing after a key
+static void json_before_value(JsonWriter* writer) {
+    if (writer->after_key) {
+        writer->after_key = 0;
+        return;
+    }
+    if (writer->has_items[writer->depth]) {
+        json_char(writer, ',');
+    }
+    writer->has_items[writer->depth] = 1;
+}
+
+static void json_open(JsonWriter* writer, char bracket) {
+    json_before_value(writer);
+    json_char(writer, bracket);
+    if (writer->depth + 1 < JSON_MAX_DEPTH) {
+        writer->depth++;
+        writer->has_items[writer->depth] = 0;
+    } else {
+        writer->failed = 1;
+    }
+}
+
+static void json_close(JsonWriter* writer, char bracket) {
+    json_char(writer, bracket);
+    if (writer->depth > 0) writer->depth--;
+}
+
+void json_begin_object(JsonWriter* writer) { json_open(writer, '{'); }
+void json_end_object(JsonWriter* writer) { json_close(writer, '}'); }
+void json_begin_array(JsonWriter* writer) { json_open(writer, '['); }
+void json_end_array(JsonWriter* writer) { json_close(writer, ']'); }
+
+static void json_quoted(JsonWriter* writer, const char* text) {
+    static const char hex[] = "0123456789abcdef";
+    json_char(writer, '"');
+
+    const char* run = text;
+    for (const char* p = text; ; p++) {
+        unsigned char c = (unsigned char)*p;
+        if (c != 0 && c != '"' && c != '\\' && c >= 0x20) continue;
+
+        // copy the plain run in one go, then the escape
+        json_raw(writer, run, p - run);
+        if (c == 0) break;
+        if (c == '"' || c == '\\') {
+            char escaped[2] = {'\\', (char)c};
+            json_raw(writer, escaped, 2);
+        } else {
+            char escaped[6] = {'\\', 'u', '0', '0', hex[c >> 4], hex[c & 15]};
+            json_raw(writer, escaped, 6);
+        }
+        run = p + 1;
+    }
+    json_char(writer, '"');
+}
+
+void json_key(JsonWriter* writer, const char* key) {
+    json_before_value(writer);
+    json_quoted(writer, key);
+    json_char(writer, ':');
+    writer->after_key = 1;
+}
+
+void json_string(JsonWriter* writer, const char* value) {
+    json_before_value(writer);
+    json_quoted(writer, value ? value : "");
+}
+
+static void json_digits(JsonWriter* writer, unsigned long long value, int min_digits) {
+    char digits[24];
+    int n = 0;
+    do {
+        digits[n++] = (char)('0' + value % 10);
+        value /= 10;
+    } while (value != 0 || n < min_digits);
+
+    if (!json_reserve(writer, n)) return;
+    while (n > 0) {
+        writer->data[writer->len++] = digits[--n];
+    }
+}
+
+void json_int(JsonWriter* writer, long long value) {
+    json_before_value(writer);
+    if (value < 0) {
+        json_char(writer, '-');
+        json_digits(writer, 0ULL - (unsigned long long)value, 1);
+    } else {
+        json_digits(writer, (unsigned long long)value, 1);
+    }
+}
+
+void json_null(JsonWriter* writer) {
+    json_before_value(writer);
+    json_raw(writer, "null", 4);
+}
+
+// Fixed decimals without printf, values too large for that fall back to it
+void json_double(JsonWriter* writer, double value, int decimals) {
+    if (value != value || value - value != 0) {
+        json_null(writer);          // NaN and infinity are not JSON
+        return;
+    }
+    if (decimals < 0) decimals = 0;
+    if (decimals > 9) decimals = 9;
+    if (value > 1e9 || value < -1e9) {
+        char text[64];
+        int len = snprintf(text, sizeof(text), "%.*f", decimals, value);
+        json_before_value(writer);
+        json_raw(writer, text, len);
+        return;
+    }
+
+    long long scale = decimal_scales[decimals];
+    int negative = value < 0;
+    unsigned long long scaled = (unsigned long long)((negative ? -value : value) * scale + 0.5);
+    json_before_value(writer);
+    if (negative && scaled != 0) json_char(writer, '-');
+    json_digits(writer, scaled / scale, 1);
+    if (decimals > 0) {
+        json_char(writer, '.');
+        json_digits(writer, scaled % scale, decimals);
+    }
+}
+
+void json_end_record(JsonWriter* writer) {
+    json_char(writer, '\n');
+    writer->has_items[0] = 0;
+}
+
+//  ANALYSIS RESULTS
+
+typedef struct {
+    JsonWriter* writer;
+    int left;
+} JsonWords;
+
+static void json_add_word(const char* word, int frequency, void* data) {
+    JsonWords* words = (JsonWords*)data;
+    if (words->left <= 0) return;
+    words->left--;
+    json_begin_object(words->writer);
+    json_key(words->writer, "word"); json_string(words->writer, word);
+    json_key(words->writer, "frequency"); json_int(words->writer, frequency);
+    json_end_object(words->writer);
+}
+
+void json_write_result(JsonWriter* w, const char* source, const AnalysisResult* result, int top_n) {
+    const AdvancedStats* stats = &result->advanced_stats;
+    int score = calculate_toxicity_score(result);
+
+    json_begin_object(w);
+    if (source != NULL) {
+        json_key(w, "source"); json_string(w, source);
+    }
+    json_key(w, "word_count"); json_int(w, result->word_count);
+    json_key(w, "char_count"); json_int(w, result->char_count);
+    json_key(w, "line_count"); json_int(w, result->line_count);
+    json_key(w, "sentence_count"); json_int(w, result->sentence_count);
+    json_key(w, "unique_words"); json_int(w, result->unique_words);
+    json_key(w, "avg_word_length"); json_double(w, result->avg_word_length, 4);
+    json_key(w, "reading_level"); json_double(w, result->reading_level, 4);
+
+    json_key(w, "advanced_stats");
+    json_begin_object(w);
+    json_key(w, "total_paragraphs"); json_int(w, stats->total_paragraphs);
+    json_key(w, "longest_sentence"); json_int(w, stats->longest_sentence);
+    json_key(w, "shortest_sentence"); json_int(w, stats->total_sentences > 0 ? stats->shortest_sentence : 0);
+    json_key(w, "avg_sentence_length"); json_double(w, stats->avg_sentence_length, 4);
+    json_key(w, "lexical_diversity"); json_double(w, stats->lexical_diversity, 4);
+    json_key(w, "toxic_ratio"); json_double(w, stats->toxic_ratio, 4);
+    json_key(w, "clean_ratio"); json_double(w, stats->clean_ratio, 4);
+    json_end_object(w);
+
+    json_key(w, "toxic_phrase_count"); json_int(w, result->toxic_phrase_count);
+    json_key(w, "toxic_word_count"); json_int(w, result->toxic_word_count);
+    json_key(w, "severity_counts");
+    json_begin_object(w);
+    json_key(w, "mild"); json_int(w, result->severity_counts[SEVERITY_MILD]);
+    json_key(w, "moderate"); json_int(w, result->severity_counts[SEVERITY_MODERATE]);
+    json_key(w, "severe"); json_int(w, result->severity_counts[SEVERITY_SEVERE]);
+    json_end_object(w);
+    json_key(w, "toxicity_score"); json_int(w, score);
+    json_key(w, "toxicity_level"); json_string(w, get_toxicity_level(score));
+
+    json_key(w, "detected_toxic_phrases");
+    json_begin_array(w);
+    for (int i = 0; i < result->toxic_phrase_count; i++) {
+        json_begin_object(w);
+        json_key(w, "text"); json_string(w, detected_phrase_text(result, i));
+        json_key(w, "severity"); json_string(w, get_severity_name(detected_phrase_severity(result, i)));
+        json_key(w, "count"); json_int(w, result->detected_phrases[i].count);
+        json_end_object(w);
+    }
+    json_end_array(w);
+
+    if (result->sketch != NULL) {
+        // top_words holds estimates
+        json_key(w, "approximate");
+        json_begin_object(w);
+        json_key(w, "error"); json_double(w, result->sketch->error, 6);
+        json_key(w, "delta"); json_double(w, result->sketch->delta, 6);
+        json_key(w, "error_bound"); json_int(w, word_sketch_error_bound(result->sketch));
+        json_key(w, "heavy_hitters"); json_int(w, result->sketch->capacity);
+        json_key(w, "unique_words_error"); json_double(w, word_sketch_distinct_error(), 4);
+        json_end_object(w);
+    }
+
+    json_key(w, "top_words");
+    json_begin_array(w);
+    JsonWords words = {w, top_n};
+    if (top_n > result->ranked_words && result->spill != NULL && result->spill->finished) {
+        // the rest of a spilled vocabulary is ranked on disk
+        word_spill_each_ranked(result->spill, json_add_word, &words);
+    } else {
+        for (int i = 0; i < result->ranked_words && words.left > 0 && result->word_freq != NULL; i++) {
+            json_add_word(result->word_freq[i]->word, result->word_freq[i]->frequency, &words);
+        }
+    }
+    json_end_array(w);
+    json_end_object(w);
+}
@@ -0,0 +1,43 @@
+#ifndef JSON_H
+#define JSON_H
+
+#include <stdio.h>
+#include "content.h"
+
+#define JSON_BUFFER_SIZE (1024 * 1024)   // output is written to the file in blocks this big
+#define JSON_MAX_DEPTH 16
+
+// JSON emitter over one reusable buffer. Numbers are formatted by hand and
+// text goes out in large blocks, so millions of records cost little stdio work.
+// With file NULL everything stays in data (for sockets and shared files)
+typedef struct {
+    FILE* file;
+    char* data;
+    size_t len;
+    size_t cap;
+    int failed;
+    int depth;
+    int after_key;
+    unsigned char has_items[JSON_MAX_DEPTH];
+} JsonWriter;
+
+int json_writer_init(JsonWriter* writer, FILE* file);
+void json_writer_reset(JsonWriter* writer);
+int json_writer_flush(JsonWriter* writer);
+void json_writer_free(JsonWriter* writer);
+
+void json_begin_object(JsonWriter* writer);
+void json_end_object(JsonWriter* writer);
+void json_begin_array(JsonWriter* writer);
+void json_end_array(JsonWriter* writer);
+void json_key(JsonWriter* writer, const char* key);
+void json_string(JsonWriter* writer, const char* value);
+void json_int(JsonWriter* writer, long long value);
+void json_double(JsonWriter* writer, double value, int decimals);
+void json_null(JsonWriter* writer);
+void json_end_record(JsonWriter* writer);   // newline after an NDJSON record
+
+// one analysis as an object, source is added as "source" when not NULL
+void json_write_result(JsonWriter* writer, const char* source, const AnalysisResult* result, int top_n);
+
+#endif
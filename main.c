@@ -5,6 +5,16 @@
 #include "file.h"
 #include "tool.h"
 #include "error.h"
+#include "cache.h"
+#include "follow.h"
+#include "batch.h"
+#include "reader.h"
+#include "corpus.h"
+#include "server.h"
+#include "columnar.h"
+#include "hits.h"
+#include "report.h"
+#include "dict.h"
 
 // App configuration settings
 typedef struct {
@@ -13,9 +23,10 @@ typedef struct {
     int compare_mode;
     int maxwords;
     char report_format[10];
+    int incremental;
 } Config;
 
-Config app_config = {1, 0, 0, 20, "both"};
+Config app_config = {1, 0, 0, 20, "both", 0};
 
 // Store analysis results here
 char* global_text = NULL;
@@ -47,7 +58,8 @@ void show_config_menu() {
     printf("2. %s Auto-save Reports\n", app_config.autosave ? "Disable" : "Enable");
     printf("3. Set Max Words Display (Current: %d)\n", app_config.maxwords);
     printf("4. Toggle Report Format (Current: %s)\n", app_config.report_format);
-    printf("5. Back to Main Menu\n");
+    printf("5. %s Incremental Mode (append-only .txt logs)\n", app_config.incremental ? "Disable" : "Enable");
+    printf("6. Back to Main Menu\n");
     printf("Choose option: ");
 }
 
@@ -91,6 +103,10 @@ void handle_config_menu() {
                 printf(" Report format set to: %s\n", app_config.report_format);
                 break;
             case 5:
+                app_config.incremental = !app_config.incremental;
+                printf(" Incremental Mode %s\n", app_config.incremental ? "Enabled" : "Disabled");
+                break;
+            case 6:
                 return;
             default:
                 printf(" Invalid option\n");
@@ -98,11 +114,25 @@ void handle_config_menu() {
     }
 }
 
+// Print the analyzable files in the current folder, without a shell
+static void list_input_files(void) {
+    const char* patterns[] = {"*.txt", "*.csv", "*.gz", "*.zst"};
+    FileList files = {0};
+    for (int i = 0; i < (int)(sizeof(patterns) / sizeof(patterns[0])); i++) {
+        collect_input_files(patterns[i], &files);
+    }
+    for (int i = 0; i < files.count; i++) {
+        if (is_supported_input(files.paths[i])) {
+            printf("  %-30s %lld bytes\n", files.paths[i], get_large_file_size(files.paths[i]));
+        }
+    }
+    free_file_list(&files);
+}
+
 // List txt and csv files in current folder
 void check_current_files() {
     printf("Available text files in current directory:\n");
-    system("dir *.txt 2>nul");
-    system("dir *.csv 2>nul");
+    list_input_files();
 }
 
 // Split space-separated filenames into array
@@ -111,7 +141,7 @@ int parse_filenames(const char* input, char*** filenames) {
         return 0;
     }
 
-    char input_copy[1024];
+    char input_copy[4096];
     strcpy(input_copy, input);
     
     int count = 0;
@@ -163,7 +193,6 @@ void show_toxicity_summary(const AnalysisResult* result) {
 // File comparison feature
 void compare_files() {
     char filename1[100], filename2[100];
-    char* text1 = NULL, *text2 = NULL;
     AnalysisResult result1, result2;
     
     printf("Enter first filename: ");
@@ -179,29 +208,34 @@ void compare_files() {
         printf(" Error: File '%s' does not exist!\n", filename1);
         return;
     }
-    text1 = read_text_file(filename1);
-    if (!text1) return;
-    result1 = analyze_text(text1);
+    int cached1 = 0, cached2 = 0;
+    result1 = analyze_file_cached(filename1, &cached1);
+    if (result1.char_count == 0) {
+        cleanup_analyzer(&result1);
+        return;
+    }
     
     // Second file
     if (!file_exists(filename2)) {
         printf(" Error: File '%s' does not exist!\n", filename2);
-        free(text1);
+        cleanup_analyzer(&result1);
         return;
     }
-    text2 = read_text_file(filename2);
-    if (!text2) {
-        free(text1);
+    result2 = analyze_file_cached(filename2, &cached2);
+    if (result2.char_count == 0) {
+        cleanup_analyzer(&result1);
+        cleanup_analyzer(&result2);
         return;
     }
-    result2 = analyze_text(text2);
+    cache_flush();
+    if (cached1 || cached2) {
+        printf(" Reused cached analysis for unchanged file(s)\n");
+    }
     
     // Show diff
     compare_results(&result1, &result2, filename1, filename2);
     
     // Cleanup
-    free(text1);
-    free(text2);
     cleanup_analyzer(&result1);
     cleanup_analyzer(&result2);
 }
@@ -239,12 +273,12 @@ int get_valid_filename(char* filename, int max_size) {
                 int choice = atoi(option);
                 switch(choice) {
                     case 1:
-                        printf(" Tip: Make sure the filename is spelled correctly and includes the extension (.txt, .csv)\n");
+                        printf(" Tip: Make sure the filename is spelled correctly and includes the extension (.txt, .csv, .gz, .zst)\n");
                         printf("Current input: \"%s\"\n", filename);
                         break;
                     case 2:
                         printf("\n Files in current directory:\n");
-                        system("dir *.txt *.csv 2>nul");
+                        list_input_files();
                         break;
                     case 3:
                         // Let user try again
@@ -308,6 +342,30 @@ if (strcmp(extension, ".csv") == 0) {
             
         }
     }
+} else if (strcmp(extension, ".txt") == 0 && app_config.incremental) {
+    // only the part appended since the last run is analyzed
+    long long new_bytes = 0;
+    AnalysisResult result = analyze_file_incremental(filename, &new_bytes);
+    if (result.char_count == 0) {
+        cleanup_analyzer(&result);
+        printf(" Failed to load file content\n");
+        return;
+    }
+    if (global_text) {
+        free(global_text);
+        global_text = NULL;
+    }
+    if (global_result.word_count > 0) {
+        cleanup_analyzer(&global_result);
+    }
+    global_result = result;
+    analysis_done = 1;
+    printf(" Incremental analysis completed!\n");
+    show_toxicity_summary(&global_result);
+    return;
+} else if (is_compressed_file(filename)) {
+    // decompressed in memory, no temporary file
+    text = load_file_text(filename);
 } else if (strcmp(extension, ".txt") == 0) {
      // handle TXT files differently based on size
     long size = get_file_size(filename);
@@ -346,10 +404,10 @@ if (strcmp(extension, ".csv") == 0) {
          // Basic stats
         printf("\n BASIC STATISTICS:\n");
         printf("----------------------------------------\n");
-        printf("Total words:       %d\n", global_result.word_count);
+        printf("Total words:       %lld\n", global_result.word_count);
         printf("Unique words:      %d\n", global_result.unique_words);
         printf("Sentences:         %d\n", global_result.sentence_count);
-        printf("Characters:        %d\n", global_result.char_count);
+        printf("Characters:        %lld\n", global_result.char_count);
         printf("Avg word length:   %.1f\n", global_result.avg_word_length);
         if (global_result.word_count > 0) {
             double toxic_percentage = (double)global_result.toxic_phrase_count / global_result.word_count * 100;
@@ -371,35 +429,38 @@ if (strcmp(extension, ".csv") == 0) {
 
 // Handle multiple files at once
 void handle_multiple_file_analysis() {
-    char input[1024];
-    printf("Enter filenames (separated by spaces): ");
+    char input[4096];
+    printf("Enter filenames, directories or patterns like logs/*.txt (separated by spaces): ");
     fgets(input, sizeof(input), stdin);
     input[strcspn(input, "\n")] = '\0';
     
-    char** filenames = NULL;
-    int file_count = parse_filenames(input, &filenames);
-    
-    if (file_count > 0) {
-        char* text = process_multiple_files((const char**)filenames, file_count);
-        
-        for (int i = 0; i < file_count; i++) {
-            free(filenames[i]);
+    char** patterns = NULL;
+    int pattern_count = parse_filenames(input, &patterns);
+    FileList files = {0};
+    for (int i = 0; i < pattern_count; i++) {
+        if (collect_input_files(patterns[i], &files) == 0) {
+            printf("  Warning: No input files match %s\n", patterns[i]);
         }
-        free(filenames);
+        free(patterns[i]);
+    }
+    free(patterns);
+    
+    if (files.count > 0) {
+        AnalysisResult merged;
+        int processed = analyze_files_cached((const char**)files.paths, files.count, &merged);
+        free_file_list(&files);
         
-        if (text) {
-            printf(" Analyzing multiple files for toxic content...\n");
-            
+        if (processed > 0) {
             // Clean up previous results
             if (global_text) {
                 free(global_text);
+                global_text = NULL;
             }
             if (global_result.word_count > 0) {
                 cleanup_analyzer(&global_result);
             }
             
-            global_result = analyze_text(text);
-            global_text = text;
+            global_result = merged;
             analysis_done = 1;
             
             printf(" Multi-file analysis completed!\n");
@@ -410,25 +471,275 @@ void handle_multiple_file_analysis() {
             //  stats
             printf("\n BASIC STATISTICS:\n");
             printf("----------------------------------------\n");
-            printf("Total words:       %d\n", global_result.word_count);
+            printf("Total words:       %lld\n", global_result.word_count);
             printf("Unique words:      %d\n", global_result.unique_words);
             printf("Sentences:         %d\n", global_result.sentence_count);
-            printf("Files processed:   %d\n", file_count);
+            printf("Files processed:   %d\n", processed);
             printf("Lexical diversity: %.2f%%\n", global_result.advanced_stats.lexical_diversity * 100);
             
             if (app_config.autosave) {
                 save_comprehensive_report("multi_file", &global_result);
                 printf(" Reports auto-saved to files\n");
             }
+        } else {
+            cleanup_analyzer(&merged);
+            printf("\nError: No files were successfully processed\n");
         }
     } else {
         printf(" Error: No valid files specified\n");
     }
 }
 
-int main() {
+// analyzer --follow [--window N] [--threshold N] file...
+int run_follow_mode(int argc, char** argv) {
+    int window = FOLLOW_DEFAULT_WINDOW;
+    int threshold = FOLLOW_DEFAULT_THRESHOLD;
+    const char** files = malloc(argc * sizeof(char*));
+    int file_count = 0;
+    
+    for (int i = 2; i < argc; i++) {
+        if (strcmp(argv[i], "--window") == 0 && i + 1 < argc) {
+            window = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--threshold") == 0 && i + 1 < argc) {
+            threshold = atoi(argv[++i]);
+        } else {
+            files[file_count++] = argv[i];
+        }
+    }
+    
+    int status = follow_files(files, file_count, window, threshold);
+    free(files);
+    return status;
+}
+
+// analyzer --corpus [-o DIR] [-j N] [--shard-mb N] [--memory-mb N] [--approx] [--all-words] [--min-freq N] path|dir|pattern...
+int run_corpus_mode(int argc, char** argv) {
+    CorpusOptions options = {".", 0, CORPUS_SHARD_SIZE, 0, 1, 0, SKETCH_OPTIONS_OFF};
+    FileList files = {0};
+    
+    for (int i = 2; i < argc; i++) {
+        if ((strcmp(argv[i], "-o") == 0 || strcmp(argv[i], "--output") == 0) && i + 1 < argc) {
+            options.output_dir = argv[++i];
+        } else if ((strcmp(argv[i], "-j") == 0 || strcmp(argv[i], "--threads") == 0) && i + 1 < argc) {
+            options.threads = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--shard-mb") == 0 && i + 1 < argc) {
+            options.shard_size = atoll(argv[++i]) * 1024 * 1024;
+        } else if (strcmp(argv[i], "--all-words") == 0) {
+            options.all_words = 1;
+        } else if (strcmp(argv[i], "--min-freq") == 0 && i + 1 < argc) {
+            options.min_frequency = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--memory-mb") == 0 && i + 1 < argc) {
+            options.memory_mb = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--approx") == 0) {
+            options.approx.enabled = 1;
+        } else if (strcmp(argv[i], "--approx-error") == 0 && i + 1 < argc) {
+            options.approx.enabled = 1;
+            options.approx.error = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--approx-delta") == 0 && i + 1 < argc) {
+            options.approx.enabled = 1;
+            options.approx.delta = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--approx-k") == 0 && i + 1 < argc) {
+            options.approx.enabled = 1;
+            options.approx.k = atoi(argv[++i]);
+        } else if (collect_input_files(argv[i], &files) == 0) {
+            printf("  Warning: No input files match %s\n", argv[i]);
+        }
+    }
+    
+    int failed = run_corpus(&files, &options);
+    free_file_list(&files);
+    if (failed < 0) return BATCH_USAGE_ERROR;
+    return (failed > 0) ? BATCH_FILES_FAILED : BATCH_OK;
+}
+
+// analyzer --serve [--port N | --socket PATH] [-j N]
+int run_server_mode(int argc, char** argv) {
+    ServerOptions options = {SERVER_DEFAULT_PORT, NULL, 0};
+    
+    for (int i = 2; i < argc; i++) {
+        if (strcmp(argv[i], "--port") == 0 && i + 1 < argc) {
+            options.port = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--socket") == 0 && i + 1 < argc) {
+            options.socket_path = argv[++i];
+        } else if ((strcmp(argv[i], "-j") == 0 || strcmp(argv[i], "--threads") == 0) && i + 1 < argc) {
+            options.threads = atoi(argv[++i]);
+        } else {
+            printf("Error: Unknown or incomplete option '%s'\n", argv[i]);
+            print_usage(argv[0]);
+            return BATCH_USAGE_ERROR;
+        }
+    }
+    return (run_server(&options) == 0) ? BATCH_OK : BATCH_USAGE_ERROR;
+}
+
+// analyzer --rows [-o FILE] [--column N] [--header | --no-header] file
+int run_rows_mode(int argc, char** argv) {
+    RowExportOptions options = {NULL, NULL, -1, -1};
+    char output[512];
+    
+    for (int i = 2; i < argc; i++) {
+        if ((strcmp(argv[i], "-o") == 0 || strcmp(argv[i], "--output") == 0) && i + 1 < argc) {
+            options.output = argv[++i];
+        } else if (strcmp(argv[i], "--column") == 0 && i + 1 < argc) {
+            options.column = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--header") == 0) {
+            options.has_header = 1;
+        } else if (strcmp(argv[i], "--no-header") == 0) {
+            options.has_header = 0;
+        } else if (argv[i][0] != '-' && options.input == NULL) {
+            options.input = argv[i];
+        } else {
+            printf("Error: Unknown or incomplete option '%s'\n", argv[i]);
+            print_usage(argv[0]);
+            return BATCH_USAGE_ERROR;
+        }
+    }
+    if (options.input == NULL) {
+        printf("Error: --rows needs an input file\n");
+        print_usage(argv[0]);
+        return BATCH_USAGE_ERROR;
+    }
+    
+    // CSV files start with a header unless told otherwise
+    const char* ext = strrchr(options.input, '.');
+    if (options.has_header < 0) {
+        options.has_header = (ext != NULL && strcmp(ext, ".csv") == 0);
+    }
+    if (options.output == NULL) {
+        int stem = (ext != NULL && strpbrk(ext, "/\\") == NULL) ? (int)(ext - options.input) : (int)strlen(options.input);
+        snprintf(output, sizeof(output), "%.*s_rows.tcol", stem, options.input);
+        options.output = output;
+    }
+    return (export_rows_columnar(&options) >= 0) ? BATCH_OK : BATCH_FILES_FAILED;
+}
+
+// analyzer --rows-dump FILE [--limit N]
+int run_rows_dump_mode(int argc, char** argv) {
+    const char* filename = NULL;
+    long long limit = -1;
+    
+    for (int i = 2; i < argc; i++) {
+        if (strcmp(argv[i], "--limit") == 0 && i + 1 < argc) {
+            limit = atoll(argv[++i]);
+        } else if (argv[i][0] != '-' && filename == NULL) {
+            filename = argv[i];
+        } else {
+            printf("Error: Unknown or incomplete option '%s'\n", argv[i]);
+            print_usage(argv[0]);
+            return BATCH_USAGE_ERROR;
+        }
+    }
+    if (filename == NULL) {
+        print_usage(argv[0]);
+        return BATCH_USAGE_ERROR;
+    }
+    return (dump_rows_columnar(filename, stdout, limit) >= 0) ? BATCH_OK : BATCH_FILES_FAILED;
+}
+
+// analyzer --hits-query FILE [--phrase P] [--severity S] [--lines A-B] [--limit N]
+int run_hits_query_mode(int argc, char** argv) {
+    const char* filename = NULL;
+    HitQuery query = {NULL, -1, 0, 0, -1};
+    
+    for (int i = 2; i < argc; i++) {
+        if (strcmp(argv[i], "--phrase") == 0 && i + 1 < argc) {
+            query.phrase = argv[++i];
+        } else if (strcmp(argv[i], "--severity") == 0 && i + 1 < argc) {
+            const char* name = argv[++i];
+            if (strcmp(name, "mild") == 0) query.severity = SEVERITY_MILD;
+            else if (strcmp(name, "moderate") == 0) query.severity = SEVERITY_MODERATE;
+            else if (strcmp(name, "severe") == 0) query.severity = SEVERITY_SEVERE;
+            else {
+                printf("Error: Severity must be mild, moderate or severe\n");
+                return BATCH_USAGE_ERROR;
+            }
+        } else if (strcmp(argv[i], "--lines") == 0 && i + 1 < argc) {
+            // A-B, A- or a single line
+            const char* range = argv[++i];
+            const char* dash = strchr(range, '-');
+            query.first_line = atoll(range);
+            query.last_line = (dash == NULL) ? query.first_line : atoll(dash + 1);
+        } else if (strcmp(argv[i], "--limit") == 0 && i + 1 < argc) {
+            query.limit = atoll(argv[++i]);
+        } else if (argv[i][0] != '-' && filename == NULL) {
+            filename = argv[i];
+        } else {
+            printf("Error: Unknown or incomplete option '%s'\n", argv[i]);
+            print_usage(argv[0]);
+            return BATCH_USAGE_ERROR;
+        }
+    }
+    if (filename == NULL) {
+        print_usage(argv[0]);
+        return BATCH_USAGE_ERROR;
+    }
+    return (query_hit_index(filename, &query, stdout) >= 0) ? BATCH_OK : BATCH_FILES_FAILED;
+}
+
+// analyzer [options] file... runs without any prompt
+int run_batch_mode(int argc, char** argv) {
+    double start = get_time_ms();
+    BatchOptions options;
+    
+    if (strcmp(argv[1], "-h") == 0 || strcmp(argv[1], "--help") == 0) {
+        print_usage(argv[0]);
+        return BATCH_OK;
+    }
+    if (!parse_batch_options(argc, argv, &options)) {
+        print_usage(argv[0]);
+        free_batch_options(&options);
+        return BATCH_USAGE_ERROR;
+    }
+    options.start_ms = start;
+    
+    set_interactive_mode(0);
+    init_analyzer();
+    int status = run_batch(&options);
+    free_batch_options(&options);
+    return status;
+}
+
+int main(int argc, char** argv) {
     init_console_encoding();
-    init_stopwords(); 
+    
+    if (argc > 1 && strcmp(argv[1], "--follow") == 0) {
+        set_interactive_mode(0);
+        init_analyzer();
+        return run_follow_mode(argc, argv);
+    }
+    if (argc > 1 && strcmp(argv[1], "compile-dictionary") == 0) {
+        // analyzer compile-dictionary [toxicwords.txt] [toxicwords.bin]
+        const char* source = (argc > 2) ? argv[2] : "toxicwords.txt";
+        const char* output = (argc > 3) ? argv[3] : COMPILED_DICT_FILE;
+        return compile_toxic_dictionary(source, output) ? BATCH_OK : BATCH_USAGE_ERROR;
+    }
+    if (argc > 1 && strcmp(argv[1], "--serve") == 0) {
+        set_interactive_mode(0);
+        init_analyzer();
+        return run_server_mode(argc, argv);
+    }
+    if (argc > 1 && strcmp(argv[1], "--corpus") == 0) {
+        set_interactive_mode(0);
+        init_analyzer();
+        return run_corpus_mode(argc, argv);
+    }
+    if (argc > 1 && strcmp(argv[1], "--rows") == 0) {
+        set_interactive_mode(0);
+        init_analyzer();
+        return run_rows_mode(argc, argv);
+    }
+    if (argc > 1 && strcmp(argv[1], "--rows-dump") == 0) {
+        set_interactive_mode(0);
+        return run_rows_dump_mode(argc, argv);
+    }
+    if (argc > 1 && strcmp(argv[1], "--hits-query") == 0) {
+        set_interactive_mode(0);
+        return run_hits_query_mode(argc, argv);
+    }
+    if (argc > 1) {
+        return run_batch_mode(argc, argv);
+    }
+    
     printf("=== Cyberbullying Text Analyzer ===\n");
     printf("Supports: Single files, Multiple files, Large files\n");
     printf("Toxicity detection with multi-word phrase support\n");
@@ -439,6 +750,7 @@ int main() {
     int choice;
     
     while (1) {
+        dictionaries_reload_if_changed();
         show_menu();
         if (scanf("%d", &choice) != 1) {
             printf(" Invalid input, please try again!\n");
@@ -543,7 +855,7 @@ int main() {
                 return 0;
             case 13: //compare sort
     if (analysis_done && global_result.word_count > 0) {
-        compare_sorting_algorithms(global_result.word_freq, global_result.unique_words);
+        compare_sorting_algorithms(global_result.word_freq, global_result.ranked_words);
     } else {
         printf("Please load and analyze files first!\n");
     }
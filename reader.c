@@ -0,0 +1,347 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "reader.h"
+#include "tool.h"
+#include "error.h"
+
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+// ring of chunk buffers shared by the producer and the consumer
+typedef struct {
+    char* buffers[READER_RING_SLOTS];
+    size_t lengths[READER_RING_SLOTS];
+    int head;       // next chunk to consume
+    int count;      // filled chunks waiting
+    int done;
+    int failed;
+    ReaderFill fill;
+    void* source;
+    double fill_ms;             // producer time in fill, read after the join
+    pthread_mutex_t lock;
+    pthread_cond_t not_empty;
+    pthread_cond_t not_full;
+} ChunkRing;
+
+static int reader_timing = 0;
+
+void set_reader_timing(int enabled) {
+    reader_timing = enabled;
+}
+
+static void* reader_thread(void* arg) {
+    ChunkRing* ring = (ChunkRing*)arg;
+    int tail = 0;
+
+    while (1) {
+        pthread_mutex_lock(&ring->lock);
+        while (ring->count == READER_RING_SLOTS) {
+            pthread_cond_wait(&ring->not_full, &ring->lock);
+        }
+        pthread_mutex_unlock(&ring->lock);
+
+        // the tail slot is not counted yet, so it is ours to fill unlocked
+        double start = get_time_ms();
+        long len = ring->fill(ring->source, ring->buffers[tail], READER_CHUNK_SIZE);
+        ring->fill_ms += get_time_ms() - start;
+
+        pthread_mutex_lock(&ring->lock);
+        if (len <= 0) {
+            ring->failed = (len < 0);
+            ring->done = 1;
+            pthread_cond_signal(&ring->not_empty);
+            pthread_mutex_unlock(&ring->lock);
+            break;
+        }
+        ring->lengths[tail] = (size_t)len;
+        ring->count++;
+        pthread_cond_signal(&ring->not_empty);
+        pthread_mutex_unlock(&ring->lock);
+        tail = (tail + 1) % READER_RING_SLOTS;
+    }
+    return NULL;
+}
+
+// Hand every chunk from fill to callback, filling the next ones meanwhile.
+// Returns the bytes handed to the callback, or -1 if fill failed
+long long run_reader_pipeline(ReaderFill fill, void* source, ChunkCallback callback, void* data) {
+    ChunkRing ring;
+    memset(&ring, 0, sizeof(ring));
+    ring.fill = fill;
+    ring.source = source;
+
+    for (int i = 0; i < READER_RING_SLOTS; i++) {
+        ring.buffers[i] = (char*)malloc(READER_CHUNK_SIZE);
+        if (ring.buffers[i] == NULL) {
+            log_message(LOG_LEVEL_ERROR, "Error: Memory allocation failed\n");
+            for (int j = 0; j < i; j++) free(ring.buffers[j]);
+            return -1;
+        }
+    }
+    pthread_mutex_init(&ring.lock, NULL);
+    pthread_cond_init(&ring.not_empty, NULL);
+    pthread_cond_init(&ring.not_full, NULL);
+
+    pthread_t thread;
+    long long total = 0;
+    double started = get_time_ms();
+    double callback_ms = 0;
+    if (pthread_create(&thread, NULL, reader_thread, &ring) != 0) {
+        // no thread, read and analyze in turn
+        long len;
+        while ((len = fill(source, ring.buffers[0], READER_CHUNK_SIZE)) > 0) {
+            callback(ring.buffers[0], (size_t)len, data);
+            total += len;
+        }
+        ring.failed = (len < 0);
+    } else {
+        while (1) {
+            pthread_mutex_lock(&ring.lock);
+            while (ring.count == 0 && !ring.done) {
+                pthread_cond_wait(&ring.not_empty, &ring.lock);
+            }
+            if (ring.count == 0) {
+                pthread_mutex_unlock(&ring.lock);
+                break;
+            }
+            int slot = ring.head;
+            pthread_mutex_unlock(&ring.lock);
+
+            // the slot stays counted while we use it, so it is not refilled
+            double start = get_time_ms();
+            callback(ring.buffers[slot], ring.lengths[slot], data);
+            callback_ms += get_time_ms() - start;
+            total += ring.lengths[slot];
+
+            pthread_mutex_lock(&ring.lock);
+            ring.head = (ring.head + 1) % READER_RING_SLOTS;
+            ring.count--;
+            pthread_cond_signal(&ring.not_full);
+            pthread_mutex_unlock(&ring.lock);
+        }
+        pthread_join(thread, NULL);
+        if (reader_timing) {
+            log_message(LOG_LEVEL_INFO, " Read ahead %lld bytes in %.1f ms: reading %.1f ms, analyzing %.1f ms\n",
+                        total, get_time_ms() - started, ring.fill_ms, callback_ms);
+        }
+    }
+
+    pthread_mutex_destroy(&ring.lock);
+    pthread_cond_destroy(&ring.not_empty);
+    pthread_cond_destroy(&ring.not_full);
+    for (int i = 0; i < READER_RING_SLOTS; i++) {
+        free(ring.buffers[i]);
+    }
+    return ring.failed ? -1 : total;
+}
+
+static long fill_from_file(void* source, char* buffer, size_t size) {
+    FILE* file = (FILE*)source;
+    size_t len = fread(buffer, 1, size, file);
+    if (len == 0 && ferror(file)) {
+        return -1;
+    }
+    return (long)len;
+}
+
+// Like read_file_chunks, but the next chunks are read while the callback runs
+long long read_file_ahead(FILE* file, ChunkCallback callback, void* data) {
+    return run_reader_pipeline(fill_from_file, file, callback, data);
+}
+
+//  DECOMPRESSION
+
+#ifdef HAVE_ZLIB
+static long fill_from_gzip(void* source, char* buffer, size_t size) {
+    return gzread((gzFile)source, buffer, (unsigned)size);
+}
+#endif
+
+#ifdef HAVE_ZSTD
+// compressed input is read in ZSTD_DStreamInSize() pieces
+typedef struct {
+    FILE* file;
+    ZSTD_DStream* stream;
+    char* input;
+    size_t input_cap;
+    ZSTD_inBuffer in;
+    int eof;
+} ZstdSource;
+
+static long fill_from_zstd(void* source, char* buffer, size_t size) {
+    ZstdSource* zst = (ZstdSource*)source;
+    ZSTD_outBuffer out = {buffer, size, 0};
+
+    while (out.pos < out.size) {
+        if (zst->in.pos == zst->in.size) {
+            if (zst->eof) break;
+            zst->in.size = fread(zst->input, 1, zst->input_cap, zst->file);
+            zst->in.pos = 0;
+            if (zst->in.size == 0) {
+                zst->eof = 1;
+                break;
+            }
+        }
+        size_t ret = ZSTD_decompressStream(zst->stream, &out, &zst->in);
+        if (ZSTD_isError(ret)) {
+            log_message(LOG_LEVEL_ERROR, "Error: %s\n", ZSTD_getErrorName(ret));
+            return -1;
+        }
+    }
+    return (long)out.pos;
+}
+#endif
+
+int is_compressed_file(const char* filename) {
+    const char* extension = get_file_extension(filename);
+    return strcmp(extension, ".gz") == 0 || strcmp(extension, ".zst") == 0;
+}
+
+// Decompress in a reader thread, the callback gets the plain text chunks
+long long read_compressed_file(const char* filename, ChunkCallback callback, void* data) {
+    const char* extension = get_file_extension(filename);
+    long long total = -1;
+#if !defined(HAVE_ZLIB) && !defined(HAVE_ZSTD)
+    // the default build has no decompressor to hand them to
+    (void)callback;
+    (void)data;
+#endif
+
+    if (strcmp(extension, ".gz") == 0) {
+#ifdef HAVE_ZLIB
+        gzFile file = gzopen(filename, "rb");
+        if (file == NULL) {
+            log_message(LOG_LEVEL_ERROR, "Error: Cannot open file %s\n", filename);
+            return -1;
+        }
+        gzbuffer(file, READER_CHUNK_SIZE);
+        total = run_reader_pipeline(fill_from_gzip, file, callback, data);
+        if (total < 0) log_message(LOG_LEVEL_ERROR, "Error: Failed to decompress %s\n", filename);
+        gzclose(file);
+#else
+        log_message(LOG_LEVEL_ERROR, "Error: gzip support was not compiled in (build with -DHAVE_ZLIB -lz)\n");
+#endif
+    } else if (strcmp(extension, ".zst") == 0) {
+#ifdef HAVE_ZSTD
+        ZstdSource zst;
+        memset(&zst, 0, sizeof(zst));
+        zst.file = fopen(filename, "rb");
+        if (zst.file == NULL) {
+            log_message(LOG_LEVEL_ERROR, "Error: Cannot open file %s\n", filename);
+            return -1;
+        }
+        zst.stream = ZSTD_createDStream();
+        zst.input_cap = ZSTD_DStreamInSize();
+        zst.input = (char*)malloc(zst.input_cap);
+        if (zst.stream != NULL && zst.input != NULL) {
+            ZSTD_initDStream(zst.stream);
+            zst.in.src = zst.input;
+            total = run_reader_pipeline(fill_from_zstd, &zst, callback, data);
+            if (total < 0) log_message(LOG_LEVEL_ERROR, "Error: Failed to decompress %s\n", filename);
+        } else {
+            log_message(LOG_LEVEL_ERROR, "Error: Memory allocation failed\n");
+        }
+        ZSTD_freeDStream(zst.stream);
+        free(zst.input);
+        fclose(zst.file);
+#else
+        log_message(LOG_LEVEL_ERROR, "Error: zstd support was not compiled in (build with -DHAVE_ZSTD -lzstd)\n");
+#endif
+    } else {
+        log_message(LOG_LEVEL_ERROR, "Error: %s is not a compressed file\n", filename);
+    }
+
+    return total;
+}
+
+// where read_compressed_text collects the chunks
+typedef struct {
+    char* content;
+    size_t length;
+    size_t capacity;
+    int failed;
+} TextBuffer;
+
+static void append_text_chunk(const char* chunk, size_t len, void* data) {
+    TextBuffer* text = (TextBuffer*)data;
+    if (text->failed) return;
+
+    if (text->length + len + 1 > text->capacity) {
+        size_t new_capacity = text->capacity * 2;
+        while (new_capacity < text->length + len + 1) new_capacity *= 2;
+        char* grown = realloc(text->content, new_capacity);
+        if (grown == NULL) {
+            text->failed = 1;
+            return;
+        }
+        text->content = grown;
+        text->capacity = new_capacity;
+    }
+    memcpy(text->content + text->length, chunk, len);
+    text->length += len;
+}
+
+// Decompress the whole file into memory, for callers that need all the text
+char* read_compressed_text(const char* filename) {
+    TextBuffer text = {malloc(READER_CHUNK_SIZE), 0, READER_CHUNK_SIZE, 0};
+    if (text.content == NULL) {
+        log_message(LOG_LEVEL_ERROR, "Error: Memory allocation failed\n");
+        return NULL;
+    }
+
+    long long total = read_compressed_file(filename, append_text_chunk, &text);
+    if (total < 0 || text.failed) {
+        if (text.failed) log_message(LOG_LEVEL_ERROR, "Error: Memory allocation failed for %s\n", filename);
+        free(text.content);
+        return NULL;
+    }
+    text.content[text.length] = '\0';
+    log_message(LOG_LEVEL_INFO, "File %s decompressed successfully (%lld bytes)\n", filename, total);
+    return text.content;
+}
+
+static void feed_stream_chunk(const char* chunk, size_t len, void* data) {
+    analysis_stream_feed((AnalysisStream*)data, chunk, len);
+}
+
+AnalysisResult analyze_file_streamed(const char* filename) {
+    AnalysisStream stream;
+    analysis_stream_init(&stream);
+    return analyze_file_into_stream(filename, &stream);
+}
+
+AnalysisResult analyze_file_into_stream(const char* filename, AnalysisStream* stream) {
+    if (is_compressed_file(filename)) {
+        // chunks go to the tokenizer as they are decompressed
+        if (read_compressed_file(filename, feed_stream_chunk, stream) < 0) {
+            AnalysisResult partial = analysis_stream_finish(stream);
+            cleanup_analyzer(&partial);
+            AnalysisResult empty = {0};
+            return empty;
+        }
+    } else if (strcmp(get_file_extension(filename), ".csv") == 0) {
+        char* text = load_file_text(filename);
+        if (text != NULL) {
+            analysis_stream_feed(stream, text, strlen(text));
+            free(text);
+        }
+    } else {
+        FILE* file = fopen(filename, "rb");
+        if (file == NULL) {
+            log_message(LOG_LEVEL_ERROR, "Error: Cannot open file %s\n", filename);
+        } else {
+            long long total = read_file_ahead(file, feed_stream_chunk, stream);
+            fclose(file);
+            if (total >= 0) {
+                log_message(LOG_LEVEL_INFO, "File %s loaded successfully (%lld bytes)\n", filename, total);
+            }
+        }
+    }
+    return analysis_stream_finish(stream);
+}
@@ -0,0 +1,32 @@
+#ifndef READER_H
+#define READER_H
+
+#include "file.h"
+#include "content.h"
+
+// A producer thread fills a ring of chunks while the caller analyzes the
+// previous ones, so reading/decompressing overlaps with tokenizing
+#define READER_CHUNK_SIZE (256 * 1024)
+#define READER_RING_SLOTS 4
+
+// fills buffer with up to size bytes, returns 0 at the end and -1 on error
+typedef long (*ReaderFill)(void* source, char* buffer, size_t size);
+
+long long run_reader_pipeline(ReaderFill fill, void* source, ChunkCallback callback, void* data);
+
+// Print for every read-ahead how long reading and analyzing took. With the
+// two overlapped the total stays close to the larger of them (--timing)
+void set_reader_timing(int enabled);
+long long read_file_ahead(FILE* file, ChunkCallback callback, void* data);
+
+// .gz needs HAVE_ZLIB (-lz), .zst needs HAVE_ZSTD (-lzstd)
+int is_compressed_file(const char* filename);
+long long read_compressed_file(const char* filename, ChunkCallback callback, void* data);
+char* read_compressed_text(const char* filename);
+
+// Analyze a file straight from disk, compressed files are decompressed on the fly
+AnalysisResult analyze_file_streamed(const char* filename);
+// same through a stream the caller set up, e.g. with an on_line hook
+AnalysisResult analyze_file_into_stream(const char* filename, AnalysisStream* stream);
+
+#endif
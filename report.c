@@ -0,0 +1,438 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "report.h"
+#include "content.h"
+#include "json.h"
+#include "spill.h"
+#include "sketch.h"
+#include "tool.h"
+#include "error.h"
+
+typedef void (*ReportRenderer)(FILE* file, const ReportSnapshot* snapshot);
+
+typedef struct {
+    const char* suffix;
+    const char* label;              // for the saved message
+    const char* mode;
+    ReportRenderer render;
+} ReportFormat;
+
+typedef struct {
+    const ReportSnapshot* snapshot;
+    ReportJob* job;
+} ReportTask;
+
+void report_snapshot_init(ReportSnapshot* snapshot, const AnalysisResult* result, const char* base) {
+    memset(snapshot, 0, sizeof(ReportSnapshot));
+    snapshot->result = result;
+    snapshot->base = base ? base : "";
+    snapshot->score = calculate_toxicity_score(result);
+    snapshot->level = get_toxicity_level(snapshot->score);
+    snapshot->toxicity_density = (double)result->toxic_phrase_count / result->word_count * 100;
+    if (result->sketch != NULL) {
+        snapshot->total_occurrences = result->sketch->total;
+    } else if (result->spill != NULL && result->spill->finished) {
+        snapshot->total_occurrences = result->spill->occurrences;
+    } else {
+        for (int i = 0; i < result->ranked_words && result->word_freq != NULL; i++) {
+            snapshot->total_occurrences += result->word_freq[i]->frequency;
+        }
+    }
+    snapshot->word_limit = REPORT_TOP_WORDS;
+    snapshot->min_frequency = 1;
+    format_timestamp(snapshot->timestamp, sizeof(snapshot->timestamp));
+}
+
+//  RENDERERS
+
+static void render_toxicity_report(FILE* file, const ReportSnapshot* snapshot) {
+    const AnalysisResult* result = snapshot->result;
+
+    fprintf(file, "TOXICITY ANALYSIS REPORT\n");
+    fprintf(file, "Generated on: %s", snapshot->timestamp);
+    fprintf(file, "============================================\n\n");
+
+    fprintf(file, "TEXT STATISTICS:\n");
+    fprintf(file, "Total words:        %lld\n", result->word_count);
+    fprintf(file, "Total sentences:    %d\n", result->sentence_count);
+    fprintf(file, "Text length:        %lld characters\n\n", result->char_count);
+
+    fprintf(file, "TOXICITY FINDINGS:\n");
+    fprintf(file, "Total toxic phrases: %d\n", result->toxic_phrase_count);
+    fprintf(file, "Severe: %d, Moderate: %d, Mild: %d\n",
+            result->severity_counts[SEVERITY_SEVERE],
+            result->severity_counts[SEVERITY_MODERATE],
+            result->severity_counts[SEVERITY_MILD]);
+    fprintf(file, "Toxicity density:    %.2f%%\n\n", snapshot->toxicity_density);
+
+    fprintf(file, "DETECTED TOXIC PHRASES:\n");
+    for (int i = 0; i < result->toxic_phrase_count; i++) {
+        fprintf(file, "%2d. %s [%s]\n",
+                i + 1,
+                detected_phrase_text(result, i),
+                get_severity_name(detected_phrase_severity(result, i)));
+    }
+}
+
+static void render_analysis_report(FILE* file, const ReportSnapshot* snapshot) {
+    const AnalysisResult* result = snapshot->result;
+
+    fprintf(file, "TEXT ANALYSIS REPORT\n");
+    fprintf(file, "====================\n\n");
+
+    fprintf(file, "BASIC STATISTICS:\n");
+    fprintf(file, "Total characters: %lld\n", result->char_count);
+    fprintf(file, "Total words:      %lld\n", result->word_count);
+    fprintf(file, "Total sentences:  %d\n", result->sentence_count);
+    if (result->sketch != NULL) {
+        fprintf(file, "Unique words:     %d (estimate, +/-%.1f%%)\n", result->unique_words,
+                word_sketch_distinct_error() * 100);
+    } else {
+        fprintf(file, "Unique words:     %d\n", result->unique_words);
+    }
+    fprintf(file, "Reading level:    %.2f\n\n", result->reading_level);
+
+    fprintf(file, "TOXICITY RATIO ANALYSIS:\n");
+    fprintf(file, "Toxic words:      %d (%.1f%%)\n",
+            result->toxic_word_count, result->advanced_stats.toxic_ratio);
+    fprintf(file, "Clean words:      %lld (%.1f%%)\n",
+            result->advanced_stats.clean_word_count, result->advanced_stats.clean_ratio);
+    fprintf(file, "Total words:      %lld\n\n", result->word_count);
+
+    fprintf(file, "TOP 10 WORDS:\n");
+    if (result->sketch != NULL) {
+        fprintf(file, "(approximate, each count at most %lld too high with %.0f%% confidence)\n",
+                word_sketch_error_bound(result->sketch), (1 - result->sketch->delta) * 100);
+    }
+    int top_n = (result->ranked_words < 10) ? result->ranked_words : 10;
+    for (int i = 0; i < top_n; i++) {
+        fprintf(file, "%2d. %-15s (%d)\n", i+1, result->word_freq[i]->word, result->word_freq[i]->frequency);
+    }
+}
+
+static void render_analysis_csv(FILE* file, const ReportSnapshot* snapshot) {
+    const AnalysisResult* result = snapshot->result;
+
+    fprintf(file, "Metric,Value\n");
+    fprintf(file, "Total Characters,%lld\n", result->char_count);
+    fprintf(file, "Total Words,%lld\n", result->word_count);
+    fprintf(file, "Total Sentences,%d\n", result->sentence_count);
+    fprintf(file, "Total Lines,%d\n", result->line_count);
+    fprintf(file, "Unique Words,%d\n", result->unique_words);
+    fprintf(file, "Average Word Length,%.2f\n", result->avg_word_length);
+    fprintf(file, "Reading Level,%.2f\n", result->reading_level);
+    fprintf(file, "Lexical Diversity,%.3f\n", result->advanced_stats.lexical_diversity);
+    fprintf(file, "Average Sentence Length,%.1f\n", result->advanced_stats.avg_sentence_length);
+    fprintf(file, "Paragraph Count,%d\n", result->advanced_stats.total_paragraphs);
+    if (result->sketch != NULL) {
+        fprintf(file, "Word Count Error Bound,%lld\n", word_sketch_error_bound(result->sketch));
+        fprintf(file, "Word Count Confidence,%.4f\n", 1 - result->sketch->delta);
+        fprintf(file, "Unique Words Error,%.4f\n", word_sketch_distinct_error());
+    }
+
+    if (result->toxic_phrase_count > 0) {
+        fprintf(file, "Total Toxic Phrases,%d\n", result->toxic_phrase_count);
+        fprintf(file, "Severe Toxic Phrases,%d\n", result->severity_counts[SEVERITY_SEVERE]);
+        fprintf(file, "Moderate Toxic Phrases,%d\n", result->severity_counts[SEVERITY_MODERATE]);
+        fprintf(file, "Mild Toxic Phrases,%d\n", result->severity_counts[SEVERITY_MILD]);
+        fprintf(file, "Toxicity Score,%d\n", snapshot->score);
+        fprintf(file, "Toxicity Density,%.2f%%\n", snapshot->toxicity_density);
+    }
+}
+
+static char* append_number(char* out, unsigned long long value) {
+    char digits[24];
+    int n = 0;
+    do {
+        digits[n++] = (char)('0' + value % 10);
+        value /= 10;
+    } while (value != 0);
+    while (n > 0) {
+        *out++ = digits[--n];
+    }
+    return out;
+}
+
+// rows of _words.csv being formatted
+typedef struct {
+    FILE* file;
+    const ReportSnapshot* snapshot;
+    char block[REPORT_BLOCK_SIZE];
+    size_t len;
+    long long rank;
+    int done;
+    int percentage_frequency;
+    char percentage[32];
+} WordRows;
+
+// Words arrive in rank order, formatted by hand into blocks so a vocabulary
+// of millions costs a few thousand writes. The percentage is only formatted
+// again when the frequency changes
+static void add_word_row(const char* word, int frequency, void* data) {
+    WordRows* rows = (WordRows*)data;
+    const ReportSnapshot* snapshot = rows->snapshot;
+    if (rows->done) return;
+    if ((snapshot->word_limit > 0 && rows->rank >= snapshot->word_limit) || frequency < snapshot->min_frequency) {
+        rows->done = 1;
+        return;
+    }
+
+    if (frequency != rows->percentage_frequency) {
+        rows->percentage_frequency = frequency;
+        snprintf(rows->percentage, sizeof(rows->percentage), "%.2f%%\n",
+                 (double)frequency / snapshot->total_occurrences * 100);
+    }
+    if (rows->len > sizeof(rows->block) - (MAX_WORD_LEN + 64)) {
+        fwrite(rows->block, 1, rows->len, rows->file);
+        rows->len = 0;
+    }
+    char* out = rows->block + rows->len;
+    out = append_number(out, ++rows->rank);
+    *out++ = ',';
+    for (const char* c = word; *c; c++) {
+        *out++ = *c;
+    }
+    *out++ = ',';
+    out = append_number(out, frequency);
+    *out++ = ',';
+    for (const char* c = rows->percentage; *c; c++) {
+        *out++ = *c;
+    }
+    rows->len = out - rows->block;
+}
+
+// Ranked words down to min_frequency. A spilled vocabulary is ranked on disk
+// when more words are asked for than stayed in memory
+static void render_word_frequency_csv(FILE* file, const ReportSnapshot* snapshot) {
+    const AnalysisResult* result = snapshot->result;
+    WordRows* rows = (WordRows*)calloc(1, sizeof(WordRows));
+    if (rows == NULL) return;
+    rows->file = file;
+    rows->snapshot = snapshot;
+    rows->percentage_frequency = -1;
+
+    fprintf(file, "Rank,Word,Frequency,Percentage\n");
+    int limit = snapshot->word_limit;
+    if (result->ranked_words < result->unique_words && result->spill != NULL &&
+        (limit == 0 || limit > result->ranked_words)) {
+        word_spill_each_ranked(result->spill, add_word_row, rows);
+    } else {
+        for (int i = 0; i < result->ranked_words && !rows->done; i++) {
+            add_word_row(result->word_freq[i]->word, result->word_freq[i]->frequency, rows);
+        }
+    }
+    fwrite(rows->block, 1, rows->len, file);
+    // say what the limit cut off, so a short list is not taken for the whole vocabulary
+    if (limit > 0 && rows->rank >= limit && result->unique_words > rows->rank) {
+        fprintf(file, ",... %lld more words not listed,,\n",
+                result->unique_words - rows->rank);
+    }
+    free(rows);
+}
+
+static void render_toxicity_csv(FILE* file, const ReportSnapshot* snapshot) {
+    const AnalysisResult* result = snapshot->result;
+
+    fprintf(file, "Rank,Toxic Phrase,Severity\n");
+    for (int i = 0; i < result->toxic_phrase_count; i++) {
+        fprintf(file, "%d,%s,%s\n",
+                i + 1,
+                detected_phrase_text(result, i),
+                get_severity_name(detected_phrase_severity(result, i)));
+    }
+}
+
+// The whole result with every word, for machine-readable reports
+static void render_analysis_json(FILE* file, const ReportSnapshot* snapshot) {
+    JsonWriter writer;
+    json_writer_init(&writer, file);
+    json_write_result(&writer, NULL, snapshot->result, snapshot->result->unique_words);
+    json_end_record(&writer);
+    json_writer_free(&writer);
+}
+
+static void render_full_report(FILE* file, const ReportSnapshot* snapshot) {
+    const AnalysisResult* result = snapshot->result;
+    const char* base = snapshot->base;
+
+    fprintf(file, "COMPREHENSIVE TEXT ANALYSIS REPORT\n");
+    fprintf(file, "Generated on: %s", snapshot->timestamp);
+    fprintf(file, "Analysis ID: %s\n\n", base);
+
+    fprintf(file, "Output Files:\n");
+    fprintf(file, "- Analysis CSV: %s_analysis.csv\n", base);
+    fprintf(file, "- Word Frequency CSV: %s_words.csv\n", base);
+    if (result->toxic_phrase_count > 0) {
+        fprintf(file, "- Toxicity CSV: %s_toxicity.csv\n", base);
+    }
+    fprintf(file, "\n");
+
+    // Basic stats
+    fprintf(file, "BASIC STATISTICS:\n");
+    fprintf(file, "Total characters: %lld\n", result->char_count);
+    fprintf(file, "Total words: %lld\n", result->word_count);
+    fprintf(file, "Total sentences: %d\n", result->sentence_count);
+    fprintf(file, "Unique words: %d\n", result->unique_words);
+    fprintf(file, "Average word length: %.2f\n", result->avg_word_length);
+    fprintf(file, "Reading level: %.2f\n\n", result->reading_level);
+
+    // Advanced stats
+    fprintf(file, "ADVANCED STATISTICS:\n");
+    fprintf(file, "Lexical diversity: %.1f%%\n", result->advanced_stats.lexical_diversity * 100);
+    fprintf(file, "Average sentence length: %.1f\n", result->advanced_stats.avg_sentence_length);
+    fprintf(file, "Paragraph count: %d\n\n", result->advanced_stats.total_paragraphs);
+
+    // Word frequency
+    fprintf(file, "TOP 20 WORDS:\n");
+    int top_n = (result->ranked_words < 20) ? result->ranked_words : 20;
+    for (int i = 0; i < top_n; i++) {
+        fprintf(file, "%2d. %-15s (%d occurrences)\n",
+                i + 1, result->word_freq[i]->word, result->word_freq[i]->frequency);
+    }
+    fprintf(file, "\n");
+
+    // Toxicity stats
+    if (result->toxic_phrase_count > 0) {
+        fprintf(file, "TOXICITY ANALYSIS:\n");
+        fprintf(file, "Total toxic phrases: %d\n", result->toxic_phrase_count);
+        fprintf(file, "Severe: %d, Moderate: %d, Mild: %d\n",
+                result->severity_counts[SEVERITY_SEVERE],
+                result->severity_counts[SEVERITY_MODERATE],
+                result->severity_counts[SEVERITY_MILD]);
+        fprintf(file, "Toxicity score: %d/100\n\n", snapshot->score);
+
+        fprintf(file, "DETECTED TOXIC PHRASES:\n");
+        for (int i = 0; i < result->toxic_phrase_count; i++) {
+            fprintf(file, "%2d. %s [%s]\n",
+                    i + 1,
+                    detected_phrase_text(result, i),
+                    get_severity_name(detected_phrase_severity(result, i)));
+        }
+    } else {
+        fprintf(file, "TOXICITY ANALYSIS: No toxic content detected\n");
+    }
+}
+
+static const ReportFormat report_formats[REPORT_FILE_KINDS] = {
+    {"_analysis.txt", "Analysis report", "w", render_analysis_report},
+    {"_toxicity.txt", "Toxicity report", "w", render_toxicity_report},
+    {"_analysis.csv", "Analysis CSV", "w", render_analysis_csv},
+    {"_words.csv", "Word frequency CSV", "w", render_word_frequency_csv},
+    {"_toxicity.csv", "Toxicity CSV", "w", render_toxicity_csv},
+    {"_analysis.json", "Analysis JSON", "wb", render_analysis_json},
+    {"_full.txt", "Comprehensive report", "w", render_full_report}
+};
+
+//  WRITING
+
+void add_report_job(ReportJob* jobs, int* count, ReportFile kind, const char* base) {
+    if (*count >= REPORT_MAX_JOBS) return;
+    ReportJob* job = &jobs[(*count)++];
+    job->kind = kind;
+    job->ok = 0;
+    snprintf(job->path, sizeof(job->path), "%s%s", base, report_formats[kind].suffix);
+}
+
+static void* run_report_job(void* arg) {
+    ReportTask* task = (ReportTask*)arg;
+    ReportJob* job = task->job;
+    const ReportFormat* format = &report_formats[job->kind];
+
+    FILE* file = fopen(job->path, format->mode);
+    if (file == NULL) {
+        job->ok = 0;
+        return NULL;
+    }
+    format->render(file, task->snapshot);
+    job->ok = !ferror(file);
+    if (fclose(file) != 0) job->ok = 0;
+    return NULL;
+}
+
+int write_reports(const ReportSnapshot* snapshot, ReportJob* jobs, int count) {
+    ReportTask tasks[REPORT_MAX_JOBS];
+    pthread_t threads[REPORT_MAX_JOBS];
+    int started[REPORT_MAX_JOBS] = {0};
+    if (count > REPORT_MAX_JOBS) count = REPORT_MAX_JOBS;
+
+    // the first file is written here while the others run on their own threads
+    for (int i = 0; i < count; i++) {
+        tasks[i].snapshot = snapshot;
+        tasks[i].job = &jobs[i];
+        if (i > 0) {
+            started[i] = (pthread_create(&threads[i], NULL, run_report_job, &tasks[i]) == 0);
+        }
+    }
+    for (int i = 0; i < count; i++) {
+        if (started[i]) {
+            pthread_join(threads[i], NULL);
+        } else {
+            run_report_job(&tasks[i]);
+        }
+    }
+
+    int written = 0;
+    for (int i = 0; i < count; i++) {
+        const char* label = report_formats[jobs[i].kind].label;
+        if (jobs[i].ok) {
+            log_message(LOG_LEVEL_INFO, " %s saved to: %s\n", label, jobs[i].path);
+            written++;
+        } else {
+            log_message(LOG_LEVEL_ERROR, " Error: Cannot write %s: %s\n", label, jobs[i].path);
+        }
+    }
+    return written;
+}
+
+int save_report_file(ReportFile kind, const char* filename, const AnalysisResult* result) {
+    ReportSnapshot snapshot;
+    ReportJob job;
+    report_snapshot_init(&snapshot, result, NULL);
+    job.kind = kind;
+    snprintf(job.path, sizeof(job.path), "%s", filename);
+    return write_reports(&snapshot, &job, 1);
+}
+
+void save_analysis_report(const char* filename, const AnalysisResult* result) {
+    save_report_file(REPORT_FILE_ANALYSIS_TXT, filename, result);
+}
+
+void save_toxicity_report(const char* filename, const AnalysisResult* result) {
+    save_report_file(REPORT_FILE_TOXICITY_TXT, filename, result);
+}
+
+void save_analysis_csv(const char* filename, const AnalysisResult* result) {
+    save_report_file(REPORT_FILE_ANALYSIS_CSV, filename, result);
+}
+
+void save_toxicity_csv(const char* filename, const AnalysisResult* result) {
+    save_report_file(REPORT_FILE_TOXICITY_CSV, filename, result);
+}
+
+void save_word_frequency_csv(const char* filename, const AnalysisResult* result) {
+    save_report_file(REPORT_FILE_WORDS_CSV, filename, result);
+}
+
+void save_comprehensive_report(const char* base_filename, const AnalysisResult* result) {
+    ReportSnapshot snapshot;
+    ReportJob jobs[REPORT_MAX_JOBS];
+    int count = 0;
+
+    report_snapshot_init(&snapshot, result, base_filename);
+    add_report_job(jobs, &count, REPORT_FILE_ANALYSIS_CSV, base_filename);
+    add_report_job(jobs, &count, REPORT_FILE_WORDS_CSV, base_filename);
+    if (result->toxic_phrase_count > 0) {
+        add_report_job(jobs, &count, REPORT_FILE_TOXICITY_CSV, base_filename);
+    }
+    add_report_job(jobs, &count, REPORT_FILE_FULL_TXT, base_filename);
+    write_reports(&snapshot, jobs, count);
+
+    printf("\n Generated structured outputs:\n");
+    for (int i = 0; i < count; i++) {
+        if (jobs[i].ok) {
+            printf("   - %s (%s)\n", jobs[i].path, report_formats[jobs[i].kind].label);
+        }
+    }
+}
@@ -0,0 +1,60 @@
+#ifndef REPORT_H
+#define REPORT_H
+
+#include "content.h"
+
+#define REPORT_PATH_LEN 1024
+#define REPORT_MAX_JOBS 8
+#define REPORT_TOP_WORDS 100        // default rows in _words.csv
+#define REPORT_BLOCK_SIZE 65536     // word lists are written in blocks this big
+
+// the files a report set can contain, named <base><suffix>
+typedef enum {
+    REPORT_FILE_ANALYSIS_TXT,       // _analysis.txt
+    REPORT_FILE_TOXICITY_TXT,       // _toxicity.txt
+    REPORT_FILE_ANALYSIS_CSV,       // _analysis.csv
+    REPORT_FILE_WORDS_CSV,          // _words.csv
+    REPORT_FILE_TOXICITY_CSV,       // _toxicity.csv, only written when something was detected
+    REPORT_FILE_ANALYSIS_JSON,      // _analysis.json
+    REPORT_FILE_FULL_TXT,           // _full.txt, lists the other files of the set
+    REPORT_FILE_KINDS
+} ReportFile;
+
+// Figures the formats share, worked out once per result before any file is written
+typedef struct {
+    const AnalysisResult* result;
+    const char* base;               // report set name, used by the full report
+    int score;
+    const char* level;
+    long long total_occurrences;    // sum of all word frequencies
+    double toxicity_density;        // toxic phrases per 100 words
+    int word_limit;                 // rows in _words.csv, 0 for the whole vocabulary
+    int min_frequency;              // words seen less often are left out
+    char timestamp[64];
+} ReportSnapshot;
+
+typedef struct {
+    ReportFile kind;
+    char path[REPORT_PATH_LEN];
+    int ok;
+} ReportJob;
+
+void report_snapshot_init(ReportSnapshot* snapshot, const AnalysisResult* result, const char* base);
+void add_report_job(ReportJob* jobs, int* count, ReportFile kind, const char* base);
+
+// Render every job from the snapshot, each file on its own thread. The saved
+// messages are logged afterwards in job order. Returns the files written
+int write_reports(const ReportSnapshot* snapshot, ReportJob* jobs, int count);
+
+// single files under any name
+int save_report_file(ReportFile kind, const char* filename, const AnalysisResult* result);
+void save_analysis_report(const char* filename, const AnalysisResult* result);
+void save_toxicity_report(const char* filename, const AnalysisResult* result);
+void save_analysis_csv(const char* filename, const AnalysisResult* result);
+void save_toxicity_csv(const char* filename, const AnalysisResult* result);
+void save_word_frequency_csv(const char* filename, const AnalysisResult* result);
+
+// CSV, word and toxicity files plus a full text report, all written at once
+void save_comprehensive_report(const char* base_filename, const AnalysisResult* result);
+
+#endif
@@ -7,8 +7,18 @@ echo Files in current directory:
 dir *.c *.h *.txt *.csv 2>nul
 echo.
 
-echo Building program...
-gcc -o analyzer.exe main.c file.c content.c tool.c error.c
+rem the analysis core is libanalyzer (analyzer.h), the program only adds the
+rem menu and the command line modes. add -DHAVE_ZLIB / -DHAVE_ZSTD to the
+rem first line and -lz / -lzstd to the last two to read .gz / .zst files
+echo Building libanalyzer...
+gcc -c analyzer.c file.c content.c tool.c error.c cache.c reader.c dict.c json.c columnar.c report.c spill.c sketch.c timeline.c hits.c && ^
+ar rcs libanalyzer.a analyzer.o file.o content.o tool.o error.o cache.o reader.o dict.o json.o columnar.o report.o spill.o sketch.o timeline.o hits.o && ^
+gcc -shared -o analyzer.dll analyzer.o file.o content.o tool.o error.o cache.o reader.o dict.o json.o columnar.o report.o spill.o sketch.o timeline.o hits.o -pthread
+
+if %errorlevel% == 0 (
+    echo Building program...
+    gcc -o analyzer.exe main.c follow.c batch.c corpus.c server.c -L. -lanalyzer -pthread -lws2_32
+)
 
 if %errorlevel% == 0 (
     echo  Compilation successful!
@@ -0,0 +1,744 @@
+#ifdef _WIN32
+// one select set holds every open connection, must come before winsock2.h
+#define FD_SETSIZE 1024
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <pthread.h>
+#include "server.h"
+#include "content.h"
+#include "dict.h"
+#include "tool.h"
+#include "error.h"
+#include "json.h"
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+typedef SOCKET socket_t;
+#define INVALID_SOCK INVALID_SOCKET
+#define close_socket closesocket
+#else
+#include <sys/socket.h>
+#include <sys/select.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+typedef int socket_t;
+#define INVALID_SOCK (-1)
+#define close_socket close
+#endif
+
+// bytes received on one connection, may hold the start of the next request
+typedef struct {
+    socket_t sock;
+    char* data;
+    size_t len;
+    size_t cap;
+    double last_active;         // idle connections are closed after SERVER_IDLE_TIMEOUT_MS
+} Connection;
+
+typedef struct {
+    char method[8];
+    char path[256];
+    char query[256];
+    char content_type[64];
+    long long content_length;
+    int keep_alive;
+    const char* body;
+    size_t consumed;            // header + body bytes
+} HttpRequest;
+
+// connections with a complete request, handed from the listener to the workers
+typedef struct {
+    Connection* slots[SERVER_MAX_CONNECTIONS];
+    int head;
+    int count;
+    int stopping;
+    pthread_mutex_t lock;
+    pthread_cond_t not_empty;
+    pthread_cond_t not_full;
+} ConnectionQueue;
+
+// ring of the latest request latencies plus running totals
+typedef struct {
+    long long requests;
+    long long errors;
+    long long texts;            // analyses, a batch counts each row
+    long long bytes;
+    double latencies[SERVER_LATENCY_SAMPLES];
+    int latency_count;
+    int latency_pos;
+    double started_ms;
+    pthread_mutex_t lock;
+} ServerMetrics;
+
+typedef struct {
+    const ServerOptions* options;
+    ConnectionQueue queue;
+    ServerMetrics metrics;
+    Connection* watched[SERVER_MAX_CONNECTIONS];    // idle or half-read, owned by the listener
+    int watched_count;
+    Connection* returned[SERVER_MAX_CONNECTIONS];   // handed back by the workers
+    int returned_count;
+    int busy;                   // connections queued or held by a worker
+    pthread_mutex_t handoff_lock;
+    socket_t wake;              // loopback datagram socket that wakes the listener
+} Server;
+
+static volatile sig_atomic_t server_stop = 0;
+
+static void handle_stop_signal(int sig) {
+    (void)sig;
+    server_stop = 1;
+}
+
+static AnalysisResult analyze_payload(const char* text, size_t len) {
+    AnalysisStream stream;
+    analysis_stream_init(&stream);
+    analysis_stream_feed(&stream, text, len);
+    return analysis_stream_finish(&stream);
+}
+
+// value of name=N in the query string, or fallback
+static int get_query_int(const char* query, const char* name, int fallback) {
+    size_t name_len = strlen(name);
+    for (const char* p = query; p && *p; ) {
+        if (strncmp(p, name, name_len) == 0 && p[name_len] == '=') {
+            return atoi(p + name_len + 1);
+        }
+        p = strchr(p, '&');
+        if (p) p++;
+    }
+    return fallback;
+}
+
+// One result per row (CSV, header skipped unless header=0) or per line
+static int analyze_batch(JsonWriter* out, const HttpRequest* request, int csv, int top_n) {
+    const char* p = request->body;
+    const char* end = request->body + request->content_length;
+    int skip_header = csv && get_query_int(request->query, "header", 1);
+    int rows = 0;
+
+    json_begin_object(out);
+    json_key(out, "results");
+    json_begin_array(out);
+    while (p < end) {
+        const char* newline = memchr(p, '\n', end - p);
+        const char* line_end = newline ? newline : end;
+        size_t len = line_end - p;
+        if (len > 0 && p[len - 1] == '\r') len--;
+
+        if (skip_header) {
+            skip_header = 0;
+        } else if (len > 0) {
+            AnalysisResult result = analyze_payload(p, len);
+            json_begin_object(out);
+            json_key(out, "row");
+            json_int(out, rows);
+            json_key(out, "result");
+            json_write_result(out, NULL, &result, top_n);
+            json_end_object(out);
+            cleanup_analyzer(&result);
+            rows++;
+        }
+        p = newline ? newline + 1 : end;
+    }
+    json_end_array(out);
+    json_key(out, "count");
+    json_int(out, rows);
+    json_end_object(out);
+    return rows;
+}
+
+//  METRICS
+
+static void record_request(ServerMetrics* metrics, double ms, int texts, long long bytes, int failed) {
+    pthread_mutex_lock(&metrics->lock);
+    metrics->requests++;
+    metrics->texts += texts;
+    metrics->bytes += bytes;
+    if (failed) metrics->errors++;
+    metrics->latencies[metrics->latency_pos] = ms;
+    metrics->latency_pos = (metrics->latency_pos + 1) % SERVER_LATENCY_SAMPLES;
+    if (metrics->latency_count < SERVER_LATENCY_SAMPLES) metrics->latency_count++;
+    pthread_mutex_unlock(&metrics->lock);
+}
+
+static int compare_doubles(const void* a, const void* b) {
+    double x = *(const double*)a;
+    double y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+static void write_metrics_json(JsonWriter* out, ServerMetrics* metrics) {
+    double sorted[SERVER_LATENCY_SAMPLES];
+
+    pthread_mutex_lock(&metrics->lock);
+    int n = metrics->latency_count;
+    memcpy(sorted, metrics->latencies, n * sizeof(double));
+    long long requests = metrics->requests;
+    long long errors = metrics->errors;
+    long long texts = metrics->texts;
+    long long bytes = metrics->bytes;
+    pthread_mutex_unlock(&metrics->lock);
+
+    qsort(sorted, n, sizeof(double), compare_doubles);
+    double p50 = n ? sorted[(int)(0.50 * (n - 1) + 0.5)] : 0;
+    double p99 = n ? sorted[(int)(0.99 * (n - 1) + 0.5)] : 0;
+    double max = n ? sorted[n - 1] : 0;
+
+    AnalyzerDictionaries* dicts = dictionaries_acquire();
+    json_begin_object(out);
+    json_key(out, "requests"); json_int(out, requests);
+    json_key(out, "errors"); json_int(out, errors);
+    json_key(out, "texts"); json_int(out, texts);
+    json_key(out, "bytes"); json_int(out, bytes);
+    json_key(out, "uptime_s"); json_double(out, (get_time_ms() - metrics->started_ms) / 1000.0, 1);
+    json_key(out, "latency_samples"); json_int(out, n);
+    json_key(out, "p50_ms"); json_double(out, p50, 3);
+    json_key(out, "p99_ms"); json_double(out, p99, 3);
+    json_key(out, "max_ms"); json_double(out, max, 3);
+    json_key(out, "toxic_phrases"); json_int(out, dicts ? dicts->toxic.count : 0);
+    json_key(out, "dictionary_generation"); json_int(out, dicts ? dicts->generation : 0);
+    json_end_object(out);
+    dictionaries_release(dicts);
+}
+
+//  HTTP
+
+static int send_all(socket_t sock, const char* data, size_t len) {
+    while (len > 0) {
+        int sent = send(sock, data, (int)len, 0);
+        if (sent <= 0) return 0;
+        data += sent;
+        len -= sent;
+    }
+    return 1;
+}
+
+static int send_response(socket_t sock, int status, const JsonWriter* body, int keep_alive) {
+    const char* reason = "OK";
+    switch (status) {
+        case 400: reason = "Bad Request"; break;
+        case 404: reason = "Not Found"; break;
+        case 405: reason = "Method Not Allowed"; break;
+        case 413: reason = "Payload Too Large"; break;
+        case 414: reason = "URI Too Long"; break;
+        case 500: reason = "Internal Server Error"; break;
+    }
+
+    char header[256];
+    int len = snprintf(header, sizeof(header),
+                       "HTTP/1.1 %d %s\r\nContent-Type: application/json\r\nContent-Length: %lu\r\n"
+                       "Connection: %s\r\n\r\n",
+                       status, reason, (unsigned long)body->len, keep_alive ? "keep-alive" : "close");
+    return send_all(sock, header, len) && send_all(sock, body->data ? body->data : "", body->len);
+}
+
+static int receive_more(Connection* conn, size_t needed) {
+    if (needed + 1 > conn->cap) {
+        size_t cap = conn->cap ? conn->cap : 16384;
+        while (cap < needed + 1) cap *= 2;
+        char* data = (char*)realloc(conn->data, cap);
+        if (data == NULL) return 0;
+        conn->data = data;
+        conn->cap = cap;
+    }
+    int got = recv(conn->sock, conn->data + conn->len, (int)(conn->cap - conn->len - 1), 0);
+    if (got <= 0) return 0;
+    conn->len += got;
+    return 1;
+}
+
+static const char* find_header_end(const Connection* conn) {
+    for (size_t i = 0; i + 3 < conn->len; i++) {
+        if (memcmp(conn->data + i, "\r\n\r\n", 4) == 0) return conn->data + i;
+    }
+    return NULL;
+}
+
+// Parse the buffered bytes. Returns 1 for a complete request, 0 while more
+// bytes are needed, or an HTTP error status for a request that cannot be served
+static int read_request(Connection* conn, HttpRequest* request) {
+    const char* end = find_header_end(conn);
+    if (end == NULL) {
+        return (conn->len >= SERVER_MAX_HEADER) ? 400 : 0;
+    }
+
+    char header[SERVER_MAX_HEADER + 1];
+    size_t header_len = end - conn->data;
+    if (header_len > SERVER_MAX_HEADER) return 400;
+    memcpy(header, conn->data, header_len);
+    header[header_len] = '\0';
+
+    memset(request, 0, sizeof(HttpRequest));
+    request->keep_alive = 1;
+    char* rest = header;
+    char* line = next_token(&rest, "\r\n");
+    char target[SERVER_MAX_HEADER + 1];
+    char version[16];
+    if (line == NULL || sscanf(line, "%7s %8192s %15s", request->method, target, version) != 3) {
+        return 400;
+    }
+    if (strcmp(version, "HTTP/1.0") == 0) request->keep_alive = 0;
+
+    // a long target is refused, never cut to a different path
+    char* question = strchr(target, '?');
+    if (question) *question = '\0';
+    if (snprintf(request->path, sizeof(request->path), "%s", target) >= (int)sizeof(request->path)) {
+        return 414;
+    }
+    if (question && snprintf(request->query, sizeof(request->query), "%s", question + 1) >= (int)sizeof(request->query)) {
+        return 414;
+    }
+
+    while ((line = next_token(&rest, "\r\n")) != NULL) {
+        char* colon = strchr(line, ':');
+        if (colon == NULL) continue;
+        *colon = '\0';
+        char* value = colon + 1;
+        while (*value == ' ') value++;
+        to_lower_case(line);
+
+        if (strcmp(line, "content-length") == 0) {
+            request->content_length = atoll(value);
+        } else if (strcmp(line, "content-type") == 0) {
+            strncpy(request->content_type, value, sizeof(request->content_type) - 1);
+            to_lower_case(request->content_type);
+        } else if (strcmp(line, "connection") == 0) {
+            to_lower_case(value);
+            if (strcmp(value, "close") == 0) request->keep_alive = 0;
+            if (strcmp(value, "keep-alive") == 0) request->keep_alive = 1;
+        }
+    }
+    if (request->content_length < 0) return 400;
+    if (request->content_length > SERVER_MAX_BODY) return 413;
+
+    size_t body_start = header_len + 4;
+    request->consumed = body_start + (size_t)request->content_length;
+    if (conn->len < request->consumed) return 0;
+    request->body = conn->data + body_start;
+    return 1;
+}
+
+// Route one request, returns the HTTP status that was sent back
+static int handle_request(Server* server, const HttpRequest* request, JsonWriter* out, int* texts) {
+    if (strcmp(request->path, "/metrics") == 0 || strcmp(request->path, "/health") == 0) {
+        if (strcmp(request->method, "GET") != 0) return 405;
+        if (strcmp(request->path, "/metrics") == 0) {
+            write_metrics_json(out, &server->metrics);
+        } else {
+            json_begin_object(out);
+            json_key(out, "status");
+            json_string(out, "ok");
+            json_end_object(out);
+        }
+        return 200;
+    }
+    if (strcmp(request->path, "/analyze") != 0) return 404;
+    if (strcmp(request->method, "POST") != 0) return 405;
+
+    int top_n = get_query_int(request->query, "top", SERVER_DEFAULT_TOP);
+    if (top_n < 0) top_n = 0;
+    int csv = strstr(request->content_type, "csv") != NULL;
+    int lines = get_query_int(request->query, "lines", 0);
+
+    // new requests pick up edited dictionaries
+    dictionaries_reload_if_changed();
+    if (csv || lines) {
+        *texts = analyze_batch(out, request, csv, top_n);
+    } else {
+        AnalysisResult result = analyze_payload(request->body, (size_t)request->content_length);
+        json_write_result(out, NULL, &result, top_n);
+        cleanup_analyzer(&result);
+        *texts = 1;
+    }
+    return out->failed ? 500 : 200;
+}
+
+static void close_connection(Connection* conn) {
+    close_socket(conn->sock);
+    free(conn->data);
+    free(conn);
+}
+
+// Serve the requests already buffered on a connection. A keep-alive
+// connection goes back to the listener to wait for its next request, so an
+// idle client never holds a worker
+static void serve_connection(Server* server, Connection* conn, JsonWriter* out) {
+    while (1) {
+        HttpRequest request;
+        memset(&request, 0, sizeof(request));
+        int status = read_request(conn, &request);
+        if (status == 0) {
+            pthread_mutex_lock(&server->handoff_lock);
+            server->returned[server->returned_count++] = conn;
+            server->busy--;
+            pthread_mutex_unlock(&server->handoff_lock);
+            send(server->wake, "w", 1, 0);
+            return;
+        }
+
+        double start = get_time_ms();
+        int texts = 0;
+        json_writer_reset(out);
+        if (status == 1) {
+            status = handle_request(server, &request, out, &texts);
+        } else {
+            request.keep_alive = 0;
+        }
+        if (status != 200) {
+            json_writer_reset(out);
+            json_begin_object(out);
+            json_key(out, "error");
+            json_int(out, status);
+            json_end_object(out);
+        }
+
+        int sent = send_response(conn->sock, status, out, request.keep_alive);
+        record_request(&server->metrics, get_time_ms() - start, texts,
+                       (status == 200) ? request.content_length : 0, status != 200);
+        if (!sent || !request.keep_alive || server_stop) break;
+
+        // keep bytes of a pipelined next request
+        memmove(conn->data, conn->data + request.consumed, conn->len - request.consumed);
+        conn->len -= request.consumed;
+    }
+
+    pthread_mutex_lock(&server->handoff_lock);
+    server->busy--;
+    pthread_mutex_unlock(&server->handoff_lock);
+    close_connection(conn);
+}
+
+//  WORKER POOL
+
+static void* server_worker(void* arg) {
+    Server* server = (Server*)arg;
+    ConnectionQueue* queue = &server->queue;
+    JsonWriter out;
+    json_writer_init(&out, NULL);
+
+    while (1) {
+        pthread_mutex_lock(&queue->lock);
+        while (queue->count == 0 && !queue->stopping) {
+            pthread_cond_wait(&queue->not_empty, &queue->lock);
+        }
+        if (queue->count == 0) {
+            pthread_mutex_unlock(&queue->lock);
+            break;
+        }
+        Connection* conn = queue->slots[queue->head];
+        queue->head = (queue->head + 1) % SERVER_MAX_CONNECTIONS;
+        queue->count--;
+        pthread_cond_signal(&queue->not_full);
+        pthread_mutex_unlock(&queue->lock);
+
+        serve_connection(server, conn, &out);
+    }
+    json_writer_free(&out);
+    return NULL;
+}
+
+static void queue_connection(Server* server, Connection* conn) {
+    ConnectionQueue* queue = &server->queue;
+    pthread_mutex_lock(&server->handoff_lock);
+    server->busy++;
+    pthread_mutex_unlock(&server->handoff_lock);
+
+    pthread_mutex_lock(&queue->lock);
+    while (queue->count == SERVER_MAX_CONNECTIONS) {
+        pthread_cond_wait(&queue->not_full, &queue->lock);
+    }
+    queue->slots[(queue->head + queue->count) % SERVER_MAX_CONNECTIONS] = conn;
+    queue->count++;
+    pthread_cond_signal(&queue->not_empty);
+    pthread_mutex_unlock(&queue->lock);
+}
+
+//  LISTENER
+
+// Loopback datagram socket the workers write to when they hand a connection
+// back, so the listener's select returns at once
+static socket_t open_wake_socket(void) {
+    struct sockaddr_in address;
+    socklen_t len = sizeof(address);
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    socket_t sock = socket(AF_INET, SOCK_DGRAM, 0);
+    if (sock == INVALID_SOCK) return INVALID_SOCK;
+    if (bind(sock, (struct sockaddr*)&address, sizeof(address)) != 0 ||
+        getsockname(sock, (struct sockaddr*)&address, &len) != 0 ||
+        connect(sock, (struct sockaddr*)&address, len) != 0) {
+        close_socket(sock);
+        return INVALID_SOCK;
+    }
+#ifdef _WIN32
+    u_long nonblocking = 1;
+    ioctlsocket(sock, FIONBIO, &nonblocking);
+#else
+    fcntl(sock, F_SETFL, fcntl(sock, F_GETFL, 0) | O_NONBLOCK);
+#endif
+    return sock;
+}
+
+// Read what arrived on each watched connection. Complete requests go to the
+// worker pool, closed and idle connections are dropped
+static void poll_watched(Server* server, fd_set* ready) {
+    double now = get_time_ms();
+    for (int i = server->watched_count - 1; i >= 0; i--) {
+        Connection* conn = server->watched[i];
+        int drop = 0;
+        if (FD_ISSET(conn->sock, ready)) {
+            HttpRequest request;
+            if (!receive_more(conn, conn->len + 4096)) {
+                drop = 1;
+            } else if (read_request(conn, &request) != 0) {
+                queue_connection(server, conn);
+                server->watched[i] = server->watched[--server->watched_count];
+                continue;
+            }
+            conn->last_active = now;
+        } else if (now - conn->last_active >= SERVER_IDLE_TIMEOUT_MS) {
+            drop = 1;
+        }
+        if (drop) {
+            close_connection(conn);
+            server->watched[i] = server->watched[--server->watched_count];
+        }
+    }
+}
+
+static void accept_connection(Server* server, socket_t listener) {
+    socket_t client = accept(listener, NULL, NULL);
+    if (client == INVALID_SOCK) return;
+#ifndef _WIN32
+    if (client >= FD_SETSIZE) {
+        close_socket(client);
+        return;
+    }
+#endif
+    Connection* conn = (Connection*)calloc(1, sizeof(Connection));
+    if (conn == NULL) {
+        close_socket(client);
+        return;
+    }
+    conn->sock = client;
+    conn->last_active = get_time_ms();
+    server->watched[server->watched_count++] = conn;
+}
+
+static socket_t open_listener(const ServerOptions* options) {
+    socket_t sock;
+
+    if (options->socket_path != NULL) {
+#ifdef _WIN32
+        printf("Error: Unix sockets are not supported on Windows, use --port\n");
+        return INVALID_SOCK;
+#else
+        struct sockaddr_un address;
+        memset(&address, 0, sizeof(address));
+        address.sun_family = AF_UNIX;
+        if (strlen(options->socket_path) >= sizeof(address.sun_path)) {
+            printf("Error: Socket path %s is too long\n", options->socket_path);
+            return INVALID_SOCK;
+        }
+        strcpy(address.sun_path, options->socket_path);
+        unlink(options->socket_path);
+
+        sock = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (sock == INVALID_SOCK || bind(sock, (struct sockaddr*)&address, sizeof(address)) != 0) {
+            printf("Error: Cannot listen on %s\n", options->socket_path);
+            if (sock != INVALID_SOCK) close_socket(sock);
+            return INVALID_SOCK;
+        }
+#endif
+    } else {
+        // localhost only, the daemon has no authentication
+        struct sockaddr_in address;
+        memset(&address, 0, sizeof(address));
+        address.sin_family = AF_INET;
+        address.sin_port = htons((unsigned short)options->port);
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+        sock = socket(AF_INET, SOCK_STREAM, 0);
+        int reuse = 1;
+        if (sock != INVALID_SOCK) {
+            setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, (const char*)&reuse, sizeof(reuse));
+        }
+        if (sock == INVALID_SOCK || bind(sock, (struct sockaddr*)&address, sizeof(address)) != 0) {
+            printf("Error: Cannot listen on 127.0.0.1:%d\n", options->port);
+            if (sock != INVALID_SOCK) close_socket(sock);
+            return INVALID_SOCK;
+        }
+    }
+
+    if (listen(sock, SERVER_MAX_CONNECTIONS) != 0) {
+        printf("Error: listen failed\n");
+        close_socket(sock);
+        return INVALID_SOCK;
+    }
+    return sock;
+}
+
+int run_server(const ServerOptions* options) {
+#ifdef _WIN32
+    WSADATA wsa;
+    if (WSAStartup(MAKEWORD(2, 2), &wsa) != 0) {
+        printf("Error: Winsock initialization failed\n");
+        return 1;
+    }
+#else
+    signal(SIGPIPE, SIG_IGN);
+#endif
+
+    socket_t listener = open_listener(options);
+    if (listener == INVALID_SOCK) return 1;
+
+    Server* server = (Server*)calloc(1, sizeof(Server));
+    if (server == NULL) {
+        printf("Error: Memory allocation failed\n");
+        close_socket(listener);
+        return 1;
+    }
+    server->options = options;
+    server->metrics.started_ms = get_time_ms();
+    server->wake = open_wake_socket();
+    if (server->wake == INVALID_SOCK) {
+        printf("Error: Cannot open the listener wake-up socket\n");
+        close_socket(listener);
+        free(server);
+        return 1;
+    }
+    pthread_mutex_init(&server->metrics.lock, NULL);
+    pthread_mutex_init(&server->handoff_lock, NULL);
+    pthread_mutex_init(&server->queue.lock, NULL);
+    pthread_cond_init(&server->queue.not_empty, NULL);
+    pthread_cond_init(&server->queue.not_full, NULL);
+
+    int thread_count = (options->threads > 0) ? options->threads : get_cpu_count();
+    if (thread_count > SERVER_MAX_THREADS) thread_count = SERVER_MAX_THREADS;
+    pthread_t threads[SERVER_MAX_THREADS];
+    int started = 0;
+    for (int i = 0; i < thread_count; i++) {
+        if (pthread_create(&threads[started], NULL, server_worker, server) == 0) started++;
+    }
+    // the listener cannot serve requests itself, so run with the workers that started
+    if (started == 0) {
+        printf("Error: Cannot start worker threads\n");
+        close_socket(listener);
+        close_socket(server->wake);
+        if (options->socket_path) {
+#ifndef _WIN32
+            unlink(options->socket_path);
+#endif
+        }
+        pthread_mutex_destroy(&server->metrics.lock);
+        pthread_mutex_destroy(&server->handoff_lock);
+        pthread_mutex_destroy(&server->queue.lock);
+        pthread_cond_destroy(&server->queue.not_empty);
+        pthread_cond_destroy(&server->queue.not_full);
+        free(server);
+        return 1;
+    }
+    if (started < thread_count) {
+        printf("Warning: Only %d of %d worker threads started\n", started, thread_count);
+        thread_count = started;
+    }
+
+    signal(SIGINT, handle_stop_signal);
+    signal(SIGTERM, handle_stop_signal);
+    if (options->socket_path) {
+        printf("Serving on unix:%s with %d workers. Press Ctrl+C to stop.\n", options->socket_path, thread_count);
+    } else {
+        printf("Serving on http://127.0.0.1:%d with %d workers. Press Ctrl+C to stop.\n", options->port, thread_count);
+    }
+    printf("  POST /analyze[?top=N&lines=1]   text, or text/csv for one result per row\n");
+    printf("  GET  /metrics                   request counts and p50/p99 latency\n");
+    fflush(stdout);
+
+    // The listener watches every connection that is not being served and
+    // wakes up now and then to notice Ctrl+C, idle clients and edited dictionaries
+    while (!server_stop) {
+        pthread_mutex_lock(&server->handoff_lock);
+        double now = get_time_ms();
+        for (int i = 0; i < server->returned_count; i++) {
+            server->returned[i]->last_active = now;
+            server->watched[server->watched_count++] = server->returned[i];
+        }
+        server->returned_count = 0;
+        int open = server->watched_count + server->busy;
+        pthread_mutex_unlock(&server->handoff_lock);
+
+        fd_set ready;
+        FD_ZERO(&ready);
+        FD_SET(server->wake, &ready);
+        socket_t top = server->wake;
+        if (open < SERVER_MAX_CONNECTIONS) {
+            FD_SET(listener, &ready);
+            if (listener > top) top = listener;
+        }
+        for (int i = 0; i < server->watched_count; i++) {
+            FD_SET(server->watched[i]->sock, &ready);
+            if (server->watched[i]->sock > top) top = server->watched[i]->sock;
+        }
+        struct timeval wait = {DICT_RELOAD_CHECK_MS / 1000, (DICT_RELOAD_CHECK_MS % 1000) * 1000};
+        int count = select((int)top + 1, &ready, NULL, NULL, &wait);
+        dictionaries_reload_if_changed();
+        if (count < 0) {
+            FD_ZERO(&ready);
+        }
+
+        if (FD_ISSET(server->wake, &ready)) {
+            char drain[64];
+            while (recv(server->wake, drain, sizeof(drain), 0) > 0) {
+            }
+        }
+        poll_watched(server, &ready);
+        if (FD_ISSET(listener, &ready)) {
+            accept_connection(server, listener);
+        }
+    }
+
+    printf("\nStopping server...\n");
+    close_socket(listener);
+    for (int i = 0; i < server->watched_count; i++) {
+        close_connection(server->watched[i]);
+    }
+    if (options->socket_path) {
+#ifndef _WIN32
+        unlink(options->socket_path);
+#endif
+    }
+    pthread_mutex_lock(&server->queue.lock);
+    server->queue.stopping = 1;
+    pthread_cond_broadcast(&server->queue.not_empty);
+    pthread_mutex_unlock(&server->queue.lock);
+    for (int i = 0; i < thread_count; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    for (int i = 0; i < server->returned_count; i++) {
+        close_connection(server->returned[i]);
+    }
+    close_socket(server->wake);
+
+    printf("Served %lld requests (%lld errors)\n", server->metrics.requests, server->metrics.errors);
+    pthread_mutex_destroy(&server->metrics.lock);
+    pthread_mutex_destroy(&server->handoff_lock);
+    pthread_mutex_destroy(&server->queue.lock);
+    pthread_cond_destroy(&server->queue.not_empty);
+    pthread_cond_destroy(&server->queue.not_full);
+    free(server);
+#ifdef _WIN32
+    WSACleanup();
+#endif
+    return 0;
+}
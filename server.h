@@ -0,0 +1,24 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+#define SERVER_DEFAULT_PORT 8077
+#define SERVER_MAX_THREADS 64
+#define SERVER_MAX_CONNECTIONS 512      // open connections, idle ones wait in the listener
+#define SERVER_MAX_HEADER 8192
+#define SERVER_MAX_BODY (64 * 1024 * 1024)
+#define SERVER_IDLE_TIMEOUT_MS 5000     // idle keep-alive connections are closed after this
+#define SERVER_LATENCY_SAMPLES 4096     // latest requests used for p50/p99
+#define SERVER_DEFAULT_TOP 10
+
+// options for analyzer --serve
+typedef struct {
+    int port;                   // localhost TCP port
+    const char* socket_path;    // listen on a Unix socket instead when set
+    int threads;
+} ServerOptions;
+
+// Answer HTTP analysis requests until Ctrl+C. The dictionaries are loaded
+// once and stay warm, every request runs on a fixed worker pool
+int run_server(const ServerOptions* options);
+
+#endif
@@ -0,0 +1,355 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <math.h>
+#include "sketch.h"
+#include "error.h"
+
+static SketchOptions sketch_options = SKETCH_OPTIONS_OFF;
+
+void set_sketch_options(const SketchOptions* options) {
+    sketch_options = *options;
+    if (sketch_options.error <= 0 || sketch_options.error >= 1) sketch_options.error = SKETCH_DEFAULT_ERROR;
+    if (sketch_options.delta <= 0 || sketch_options.delta >= 1) sketch_options.delta = SKETCH_DEFAULT_DELTA;
+    if (sketch_options.k < 1) sketch_options.k = SKETCH_DEFAULT_K;
+}
+
+const SketchOptions* get_sketch_options(void) {
+    return &sketch_options;
+}
+
+// 64-bit FNV-1a, split in two for the rows and the summary buckets
+static unsigned long long sketch_hash(const char* word) {
+    unsigned long long hash = 14695981039346656037ULL;
+    for (const unsigned char* c = (const unsigned char*)word; *c; c++) {
+        hash ^= *c;
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+// column of the word in a row, from two hashes (h1 + row * h2)
+static int sketch_column(const WordSketch* sketch, unsigned long long hash, int row) {
+    unsigned int h1 = (unsigned int)hash;
+    unsigned int h2 = (unsigned int)(hash >> 32) | 1;
+    return (int)((h1 + (unsigned int)row * h2) % (unsigned int)sketch->width);
+}
+
+static int sketch_bucket(const WordSketch* sketch, unsigned long long hash) {
+    return (int)((hash ^ (hash >> 29)) & (unsigned long long)sketch->bucket_mask);
+}
+
+WordSketch* word_sketch_create(void) {
+    if (!sketch_options.enabled) return NULL;
+
+    WordSketch* sketch = (WordSketch*)calloc(1, sizeof(WordSketch));
+    if (sketch == NULL) return NULL;
+    sketch->error = sketch_options.error;
+    sketch->delta = sketch_options.delta;
+    sketch->width = (int)ceil(exp(1.0) / sketch->error);
+    sketch->depth = (int)ceil(log(1.0 / sketch->delta));
+    if (sketch->depth < 1) sketch->depth = 1;
+    sketch->capacity = sketch_options.k;
+
+    int buckets = 1;
+    while (buckets < sketch->capacity * 2) buckets <<= 1;
+    sketch->bucket_mask = buckets - 1;
+
+    sketch->counters = (unsigned long long*)calloc((size_t)sketch->width * sketch->depth, sizeof(unsigned long long));
+    sketch->entries = (SketchEntry*)malloc(sketch->capacity * sizeof(SketchEntry));
+    sketch->heap = (int*)malloc(sketch->capacity * sizeof(int));
+    sketch->heap_pos = (int*)malloc(sketch->capacity * sizeof(int));
+    sketch->buckets = (int*)malloc(buckets * sizeof(int));
+    if (sketch->counters == NULL || sketch->entries == NULL || sketch->heap == NULL ||
+        sketch->heap_pos == NULL || sketch->buckets == NULL) {
+        log_message(LOG_LEVEL_WARNING, " Warning: Not enough memory for a %dx%d word sketch, counting exactly\n",
+                    sketch->depth, sketch->width);
+        word_sketch_free(sketch);
+        return NULL;
+    }
+    memset(sketch->buckets, -1, buckets * sizeof(int));
+    return sketch;
+}
+
+void word_sketch_free(WordSketch* sketch) {
+    if (sketch == NULL) return;
+    free(sketch->counters);
+    free(sketch->entries);
+    free(sketch->heap);
+    free(sketch->heap_pos);
+    free(sketch->buckets);
+    free(sketch);
+}
+
+//  HYPERLOGLOG
+
+// FNV-1a leaves the high bits poorly mixed, the register index and the run
+// of zeros come from a finalized hash
+static unsigned long long mix_hash(unsigned long long hash) {
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdULL;
+    hash ^= hash >> 33;
+    hash *= 0xc4ceb9fe1a85ec53ULL;
+    hash ^= hash >> 33;
+    return hash;
+}
+
+static void distinct_add(DistinctCounter* counter, unsigned long long hash) {
+    hash = mix_hash(hash);
+    int index = (int)(hash >> (64 - SKETCH_DISTINCT_BITS));
+    unsigned long long rest = hash << SKETCH_DISTINCT_BITS;
+    unsigned char rank = 1;
+    while (rank <= 64 - SKETCH_DISTINCT_BITS && !(rest & 0x8000000000000000ULL)) {
+        rest <<= 1;
+        rank++;
+    }
+    if (rank > counter->registers[index]) {
+        counter->registers[index] = rank;
+    }
+}
+
+// corrections for empty and saturated registers in the estimator below
+static double distinct_sigma(double x) {
+    if (x == 1) return INFINITY;
+    double y = 1, z = x, previous;
+    do {
+        x *= x;
+        previous = z;
+        z += x * y;
+        y += y;
+    } while (z != previous);
+    return z;
+}
+
+static double distinct_tau(double x) {
+    if (x == 0 || x == 1) return 0;
+    double y = 1, z = 1 - x, previous;
+    do {
+        x = sqrt(x);
+        previous = z;
+        y *= 0.5;
+        z -= (1 - x) * (1 - x) * y;
+    } while (z != previous);
+    return z / 3;
+}
+
+// Ertl's improved estimator over the register histogram. Unlike the original
+// HyperLogLog formula it needs no switch to linear counting and has no bias
+// for mid-sized vocabularies
+static double distinct_estimate(const DistinctCounter* counter) {
+    const int registers = 1 << SKETCH_DISTINCT_BITS;
+    const int max_rank = 64 - SKETCH_DISTINCT_BITS + 1;
+    int histogram[64 - SKETCH_DISTINCT_BITS + 2] = {0};
+    for (int i = 0; i < registers; i++) {
+        histogram[counter->registers[i]]++;
+    }
+    double z = registers * distinct_tau(1 - (double)histogram[max_rank] / registers);
+    for (int rank = max_rank - 1; rank >= 1; rank--) {
+        z = 0.5 * (z + histogram[rank]);
+    }
+    z += registers * distinct_sigma((double)histogram[0] / registers);
+    return registers / (2 * log(2.0)) * registers / z;
+}
+
+long long word_sketch_distinct(const WordSketch* sketch) {
+    return llround(distinct_estimate(&sketch->distinct));
+}
+
+double word_sketch_distinct_error(void) {
+    return 1.04 / sqrt((double)(1 << SKETCH_DISTINCT_BITS));
+}
+
+//  SPACE-SAVING SUMMARY
+
+static void heap_swap(WordSketch* sketch, int a, int b) {
+    int entry = sketch->heap[a];
+    sketch->heap[a] = sketch->heap[b];
+    sketch->heap[b] = entry;
+    sketch->heap_pos[sketch->heap[a]] = a;
+    sketch->heap_pos[sketch->heap[b]] = b;
+}
+
+static long long heap_count(const WordSketch* sketch, int pos) {
+    return sketch->entries[sketch->heap[pos]].count;
+}
+
+static void heap_sift_up(WordSketch* sketch, int pos) {
+    while (pos > 0) {
+        int parent = (pos - 1) / 2;
+        if (heap_count(sketch, parent) <= heap_count(sketch, pos)) break;
+        heap_swap(sketch, parent, pos);
+        pos = parent;
+    }
+}
+
+static void heap_sift_down(WordSketch* sketch, int pos) {
+    for (;;) {
+        int smallest = pos;
+        int left = pos * 2 + 1;
+        int right = left + 1;
+        if (left < sketch->size && heap_count(sketch, left) < heap_count(sketch, smallest)) smallest = left;
+        if (right < sketch->size && heap_count(sketch, right) < heap_count(sketch, smallest)) smallest = right;
+        if (smallest == pos) return;
+        heap_swap(sketch, pos, smallest);
+        pos = smallest;
+    }
+}
+
+static int find_entry(const WordSketch* sketch, const char* word, unsigned long long hash) {
+    for (int e = sketch->buckets[sketch_bucket(sketch, hash)]; e >= 0; e = sketch->entries[e].next) {
+        if (strcmp(sketch->entries[e].word, word) == 0) return e;
+    }
+    return -1;
+}
+
+static void link_entry(WordSketch* sketch, int e, const char* word, unsigned long long hash) {
+    SketchEntry* entry = &sketch->entries[e];
+    strncpy(entry->word, word, MAX_WORD_LEN - 1);
+    entry->word[MAX_WORD_LEN - 1] = '\0';
+    int bucket = sketch_bucket(sketch, hash);
+    entry->next = sketch->buckets[bucket];
+    sketch->buckets[bucket] = e;
+}
+
+static void unlink_entry(WordSketch* sketch, int e) {
+    int* link = &sketch->buckets[sketch_bucket(sketch, sketch_hash(sketch->entries[e].word))];
+    while (*link != e) {
+        link = &sketch->entries[*link].next;
+    }
+    *link = sketch->entries[e].next;
+}
+
+// A word that is not tracked takes over the entry with the smallest count,
+// starting from that count, so counts only ever overestimate
+static void summary_add(WordSketch* sketch, const char* word, unsigned long long hash, int count) {
+    int e = find_entry(sketch, word, hash);
+    if (e >= 0) {
+        sketch->entries[e].count += count;
+        heap_sift_down(sketch, sketch->heap_pos[e]);
+    } else if (sketch->size < sketch->capacity) {
+        e = sketch->size++;
+        link_entry(sketch, e, word, hash);
+        sketch->entries[e].count = count;
+        sketch->entries[e].error = 0;
+        sketch->heap[e] = e;
+        sketch->heap_pos[e] = e;
+        heap_sift_up(sketch, e);
+    } else {
+        e = sketch->heap[0];
+        long long smallest = sketch->entries[e].count;
+        unlink_entry(sketch, e);
+        link_entry(sketch, e, word, hash);
+        sketch->entries[e].count = smallest + count;
+        sketch->entries[e].error = smallest;
+        heap_sift_down(sketch, 0);
+    }
+}
+
+// count of a word the summary does not track: at most its smallest count once full
+static long long summary_floor(const WordSketch* sketch) {
+    return (sketch->size < sketch->capacity) ? 0 : sketch->entries[sketch->heap[0]].count;
+}
+
+//  COUNTING
+
+void word_sketch_add(WordSketch* sketch, const char* word, int count) {
+    unsigned long long hash = sketch_hash(word);
+    for (int row = 0; row < sketch->depth; row++) {
+        sketch->counters[(size_t)row * sketch->width + sketch_column(sketch, hash, row)] += count;
+    }
+    sketch->total += count;
+    distinct_add(&sketch->distinct, hash);
+    summary_add(sketch, word, hash, count);
+}
+
+// Both the sketch and a summary count only overestimate, the smaller is kept
+long long word_sketch_estimate(const WordSketch* sketch, const char* word) {
+    unsigned long long hash = sketch_hash(word);
+    unsigned long long estimate = ULLONG_MAX;
+    for (int row = 0; row < sketch->depth; row++) {
+        unsigned long long value = sketch->counters[(size_t)row * sketch->width + sketch_column(sketch, hash, row)];
+        if (value < estimate) estimate = value;
+    }
+    int e = find_entry(sketch, word, hash);
+    if (e >= 0 && (unsigned long long)sketch->entries[e].count < estimate) {
+        estimate = sketch->entries[e].count;
+    }
+    return (estimate > LLONG_MAX) ? LLONG_MAX : (long long)estimate;
+}
+
+static int compare_entries(const void* a, const void* b) {
+    const SketchEntry* x = (const SketchEntry*)a;
+    const SketchEntry* y = (const SketchEntry*)b;
+    if (x->count != y->count) return (x->count > y->count) ? -1 : 1;
+    return strcmp(x->word, y->word);
+}
+
+// Counters add up. In the summaries a word missing on one side counts as
+// that side's floor, then the largest counts are kept
+int word_sketch_merge(WordSketch* total, const WordSketch* part) {
+    if (total->width != part->width || total->depth != part->depth || total->capacity != part->capacity) {
+        return 0;
+    }
+    size_t counters = (size_t)total->width * total->depth;
+    for (size_t i = 0; i < counters; i++) {
+        total->counters[i] += part->counters[i];
+    }
+    total->total += part->total;
+    for (int i = 0; i < (1 << SKETCH_DISTINCT_BITS); i++) {
+        if (part->distinct.registers[i] > total->distinct.registers[i]) {
+            total->distinct.registers[i] = part->distinct.registers[i];
+        }
+    }
+
+    SketchEntry* merged = (SketchEntry*)malloc((total->size + part->size) * sizeof(SketchEntry));
+    if (merged == NULL) return 0;
+    int count = 0;
+    long long total_floor = summary_floor(total);
+    long long part_floor = summary_floor(part);
+    for (int e = 0; e < total->size; e++) {
+        SketchEntry* entry = &merged[count++];
+        *entry = total->entries[e];
+        int other = find_entry(part, entry->word, sketch_hash(entry->word));
+        entry->count += (other >= 0) ? part->entries[other].count : part_floor;
+        entry->error += (other >= 0) ? part->entries[other].error : part_floor;
+    }
+    for (int e = 0; e < part->size; e++) {
+        const SketchEntry* other = &part->entries[e];
+        if (find_entry(total, other->word, sketch_hash(other->word)) >= 0) continue;
+        SketchEntry* entry = &merged[count++];
+        *entry = *other;
+        entry->count += total_floor;
+        entry->error += total_floor;
+    }
+    qsort(merged, count, sizeof(SketchEntry), compare_entries);
+
+    memset(total->buckets, -1, (total->bucket_mask + 1) * sizeof(int));
+    total->size = 0;
+    for (int i = 0; i < count && total->size < total->capacity; i++) {
+        int e = total->size++;
+        link_entry(total, e, merged[i].word, sketch_hash(merged[i].word));
+        total->entries[e].count = merged[i].count;
+        total->entries[e].error = merged[i].error;
+        total->heap[e] = e;
+        total->heap_pos[e] = e;
+    }
+    for (int pos = total->size / 2 - 1; pos >= 0; pos--) {
+        heap_sift_down(total, pos);
+    }
+    free(merged);
+    return 1;
+}
+
+void word_sketch_top(const WordSketch* sketch, HashTable* table) {
+    hash_table_free(table);
+    hash_table_init(table);
+    for (int e = 0; e < sketch->size; e++) {
+        long long estimate = word_sketch_estimate(sketch, sketch->entries[e].word);
+        hash_table_add(table, sketch->entries[e].word, (estimate > INT_MAX) ? INT_MAX : (int)estimate);
+    }
+}
+
+long long word_sketch_error_bound(const WordSketch* sketch) {
+    return (long long)ceil(sketch->error * sketch->total);
+}
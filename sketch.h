@@ -0,0 +1,85 @@
+#ifndef SKETCH_H
+#define SKETCH_H
+
+#include "content.h"
+
+#define SKETCH_DEFAULT_ERROR 0.0001     // overcount at most this share of all words
+#define SKETCH_DEFAULT_DELTA 0.01       // chance that a count is off by more
+#define SKETCH_DEFAULT_K 1000           // heavy hitters kept
+#define SKETCH_DISTINCT_BITS 14         // 2^14 HyperLogLog registers, about 0.8% error
+
+// how approximate counting is set up, the same for every sketch of a run so
+// that they can be merged
+typedef struct {
+    int enabled;
+    double error;
+    double delta;
+    int k;
+} SketchOptions;
+
+#define SKETCH_OPTIONS_OFF {0, SKETCH_DEFAULT_ERROR, SKETCH_DEFAULT_DELTA, SKETCH_DEFAULT_K}
+
+// one tracked word of the Space-Saving summary
+typedef struct {
+    char word[MAX_WORD_LEN];
+    long long count;            // never below the true count
+    long long error;            // count may be this much too high
+    int next;                   // next entry in the same bucket, -1 at the end
+} SketchEntry;
+
+// HyperLogLog estimate of the number of distinct words, one byte per register.
+// Registers keep the longest run of leading zero bits seen in their share of
+// the word hashes, so counters merge by taking the larger register
+typedef struct {
+    unsigned char registers[1 << SKETCH_DISTINCT_BITS];
+} DistinctCounter;
+
+// Fixed-size word counts for inputs whose vocabulary does not matter. A
+// Count-Min Sketch of depth rows by width counters bounds every estimate to
+// the true count plus error * total with probability 1 - delta, and a
+// Space-Saving summary keeps the k most frequent words. Memory does not grow
+// with the input
+typedef struct WordSketch {
+    int width;
+    int depth;
+    unsigned long long* counters; // depth rows of width counters, 64-bit so they never wrap
+    long long total;            // words added
+    SketchEntry* entries;
+    int* heap;                  // entry indexes, smallest count at the root
+    int* heap_pos;              // heap position of each entry
+    int* buckets;               // first entry per word hash, -1 when empty
+    int bucket_mask;
+    int size;
+    int capacity;
+    double error;
+    double delta;
+    DistinctCounter distinct;   // distinct words, for unique_words
+} WordSketch;
+
+// Applies to sketches created afterwards
+void set_sketch_options(const SketchOptions* options);
+const SketchOptions* get_sketch_options(void);
+
+// NULL when approximate counting is off
+WordSketch* word_sketch_create(void);
+void word_sketch_free(WordSketch* sketch);
+
+void word_sketch_add(WordSketch* sketch, const char* word, int count);
+long long word_sketch_estimate(const WordSketch* sketch, const char* word);
+
+// Add part into total, both must have been created with the same options.
+// Returns 0 if they cannot be merged
+int word_sketch_merge(WordSketch* total, const WordSketch* part);
+
+// Empty the table and fill it with the heavy hitters and their estimates.
+// Word table frequencies are int, larger estimates are capped at INT_MAX
+void word_sketch_top(const WordSketch* sketch, HashTable* table);
+
+// most a count can be too high, with probability 1 - delta
+long long word_sketch_error_bound(const WordSketch* sketch);
+
+// estimated distinct words and the standard error of that estimate (relative)
+long long word_sketch_distinct(const WordSketch* sketch);
+double word_sketch_distinct_error(void);
+
+#endif
@@ -0,0 +1,502 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "spill.h"
+#include "error.h"
+
+#ifdef _WIN32
+#include <process.h>
+#define get_process_id _getpid
+#else
+#include <unistd.h>
+#define get_process_id getpid
+#endif
+
+// one word on disk: u8 length, the word, u32 frequency (little endian)
+typedef struct {
+    char word[MAX_WORD_LEN];
+    int frequency;
+} WordRecord;
+
+typedef int (*RecordCompare)(const WordRecord* a, const WordRecord* b);
+
+typedef struct {
+    FILE* file;
+    WordRecord record;
+} RunCursor;
+
+// min-heap of run cursors, ordered by their current record
+typedef struct {
+    RunCursor* cursors;
+    int* heap;
+    int size;
+    RecordCompare compare;
+} RunHeap;
+
+// runs produced while ranking, separate from the spill's own
+typedef struct {
+    char** paths;
+    int count;
+    int capacity;
+} RunList;
+
+typedef struct {
+    WordSpill* spill;
+    WordRecord* records;
+    int count;
+    int capacity;
+    RunList runs;
+    int failed;
+} RankSorter;
+
+typedef struct {
+    WordRecord* heap;           // worst kept word at the root
+    int count;
+    int capacity;
+    long long vocabulary;
+    long long occurrences;
+} TopWords;
+
+static long long word_memory_limit = 0;
+static int spill_file_id = 0;
+static pthread_mutex_t spill_file_lock = PTHREAD_MUTEX_INITIALIZER;
+
+void set_word_memory_limit(long long bytes) {
+    word_memory_limit = (bytes > 0) ? bytes : 0;
+}
+
+long long get_word_memory_limit(void) {
+    return word_memory_limit;
+}
+
+static int compare_by_word(const WordRecord* a, const WordRecord* b) {
+    return strcmp(a->word, b->word);
+}
+
+// same order as the ranked word list: higher frequency first, then by word
+static int compare_by_rank(const WordRecord* a, const WordRecord* b) {
+    if (a->frequency != b->frequency) {
+        return (a->frequency > b->frequency) ? -1 : 1;
+    }
+    return strcmp(a->word, b->word);
+}
+
+static int compare_nodes_by_word(const void* a, const void* b) {
+    return strcmp((*(WordNode* const*)a)->word, (*(WordNode* const*)b)->word);
+}
+
+static int compare_records_by_rank(const void* a, const void* b) {
+    return compare_by_rank((const WordRecord*)a, (const WordRecord*)b);
+}
+
+//  RUN FILES
+
+static const char* spill_directory(void) {
+    const char* names[] = {"TMPDIR", "TEMP", "TMP"};
+    for (int i = 0; i < 3; i++) {
+        const char* dir = getenv(names[i]);
+        if (dir != NULL && dir[0] != '\0') return dir;
+    }
+    return ".";
+}
+
+static char* new_run_path(void) {
+    pthread_mutex_lock(&spill_file_lock);
+    int id = ++spill_file_id;
+    pthread_mutex_unlock(&spill_file_lock);
+
+    char* path = (char*)malloc(1024);
+    if (path != NULL) {
+        snprintf(path, 1024, "%s/analyzer_%d_%d.run", spill_directory(), (int)get_process_id(), id);
+    }
+    return path;
+}
+
+static FILE* open_run(const char* path, const char* mode) {
+    FILE* file = fopen(path, mode);
+    if (file != NULL) {
+        setvbuf(file, NULL, _IOFBF, WORD_SPILL_BUFFER);
+    }
+    return file;
+}
+
+static void write_record(FILE* file, const char* word, int frequency) {
+    size_t len = strlen(word);
+    unsigned char count[4] = {
+        (unsigned char)frequency, (unsigned char)(frequency >> 8),
+        (unsigned char)(frequency >> 16), (unsigned char)(frequency >> 24)
+    };
+    fputc((int)len, file);
+    fwrite(word, 1, len, file);
+    fwrite(count, 1, 4, file);
+}
+
+// Returns 1 for a record, 0 at the end of the run, -1 if it is damaged
+static int read_record(FILE* file, WordRecord* record) {
+    unsigned char count[4];
+    int len = fgetc(file);
+    if (len == EOF) return 0;
+    if (len >= MAX_WORD_LEN || fread(record->word, 1, len, file) != (size_t)len ||
+        fread(count, 1, 4, file) != 4) {
+        return -1;
+    }
+    record->word[len] = '\0';
+    record->frequency = (int)((unsigned int)count[0] | (unsigned int)count[1] << 8 |
+                              (unsigned int)count[2] << 16 | (unsigned int)count[3] << 24);
+    return 1;
+}
+
+static int run_list_add(RunList* list, char* path) {
+    if (list->count == list->capacity) {
+        int capacity = list->capacity ? list->capacity * 2 : 16;
+        char** paths = (char**)realloc(list->paths, capacity * sizeof(char*));
+        if (paths == NULL) return 0;
+        list->paths = paths;
+        list->capacity = capacity;
+    }
+    list->paths[list->count++] = path;
+    return 1;
+}
+
+static void run_list_clear(RunList* list) {
+    for (int i = 0; i < list->count; i++) {
+        remove(list->paths[i]);
+        free(list->paths[i]);
+    }
+    free(list->paths);
+    list->paths = NULL;
+    list->count = 0;
+    list->capacity = 0;
+}
+
+//  K-WAY MERGE
+
+static int heap_before(const RunHeap* heap, int a, int b) {
+    return heap->compare(&heap->cursors[heap->heap[a]].record, &heap->cursors[heap->heap[b]].record) < 0;
+}
+
+static void heap_swap(RunHeap* heap, int a, int b) {
+    int temp = heap->heap[a];
+    heap->heap[a] = heap->heap[b];
+    heap->heap[b] = temp;
+}
+
+static void heap_sift_down(RunHeap* heap, int i) {
+    while (1) {
+        int smallest = i;
+        int left = 2 * i + 1;
+        int right = left + 1;
+        if (left < heap->size && heap_before(heap, left, smallest)) smallest = left;
+        if (right < heap->size && heap_before(heap, right, smallest)) smallest = right;
+        if (smallest == i) return;
+        heap_swap(heap, i, smallest);
+        i = smallest;
+    }
+}
+
+// Merge sorted runs, equal words are added up when combine is set
+static long long merge_runs(char** paths, int count, RecordCompare compare, int combine,
+                            WordCallback callback, void* data) {
+    RunHeap heap = {0};
+    heap.cursors = (RunCursor*)calloc(count + 1, sizeof(RunCursor));
+    heap.heap = (int*)malloc((count + 1) * sizeof(int));
+    heap.compare = compare;
+    if (heap.cursors == NULL || heap.heap == NULL) {
+        free(heap.cursors);
+        free(heap.heap);
+        return -1;
+    }
+
+    int failed = 0;
+    for (int i = 0; i < count; i++) {
+        heap.cursors[i].file = open_run(paths[i], "rb");
+        int status = heap.cursors[i].file ? read_record(heap.cursors[i].file, &heap.cursors[i].record) : -1;
+        if (status == 1) {
+            heap.heap[heap.size++] = i;
+        } else if (status < 0) {
+            failed = 1;
+        }
+    }
+    for (int i = heap.size / 2 - 1; i >= 0; i--) {
+        heap_sift_down(&heap, i);
+    }
+
+    WordRecord current;
+    int has_current = 0;
+    long long words = 0;
+    while (heap.size > 0) {
+        RunCursor* cursor = &heap.cursors[heap.heap[0]];
+        if (combine && has_current && strcmp(current.word, cursor->record.word) == 0) {
+            current.frequency += cursor->record.frequency;
+        } else {
+            if (has_current) {
+                callback(current.word, current.frequency, data);
+                words++;
+            }
+            current = cursor->record;
+            has_current = 1;
+        }
+
+        int status = read_record(cursor->file, &cursor->record);
+        if (status != 1) {
+            if (status < 0) failed = 1;
+            heap.heap[0] = heap.heap[--heap.size];
+        }
+        heap_sift_down(&heap, 0);
+    }
+    if (has_current) {
+        callback(current.word, current.frequency, data);
+        words++;
+    }
+
+    for (int i = 0; i < count; i++) {
+        if (heap.cursors[i].file) fclose(heap.cursors[i].file);
+    }
+    free(heap.cursors);
+    free(heap.heap);
+    if (failed) {
+        log_message(LOG_LEVEL_ERROR, "Error: Cannot read word spill files, word counts are incomplete\n");
+        return -1;
+    }
+    return words;
+}
+
+static void write_merged_record(const char* word, int frequency, void* data) {
+    write_record((FILE*)data, word, frequency);
+}
+
+// Merge all runs into one, so the next merge never opens too many files
+static void compact_runs(RunList* runs, RecordCompare compare, int combine) {
+    char* path = new_run_path();
+    FILE* file = path ? open_run(path, "wb") : NULL;
+    if (file == NULL) {
+        free(path);
+        return;
+    }
+    long long words = merge_runs(runs->paths, runs->count, compare, combine, write_merged_record, file);
+    int ok = !ferror(file);
+    if (fclose(file) != 0) ok = 0;
+    if (words < 0 || !ok) {
+        remove(path);
+        free(path);
+        return;
+    }
+    run_list_clear(runs);
+    run_list_add(runs, path);
+}
+
+//  SPILLING
+
+WordSpill* word_spill_create(void) {
+    if (word_memory_limit <= 0) return NULL;
+    WordSpill* spill = (WordSpill*)calloc(1, sizeof(WordSpill));
+    if (spill != NULL) {
+        spill->max_words = word_memory_limit / WORD_SPILL_NODE_BYTES;
+        if (spill->max_words < 1024) spill->max_words = 1024;
+    }
+    return spill;
+}
+
+void word_spill_free(WordSpill* spill) {
+    if (spill == NULL) return;
+    RunList runs = {spill->runs, spill->run_count, spill->run_capacity};
+    run_list_clear(&runs);
+    free(spill);
+}
+
+int word_spill_flush(WordSpill* spill, HashTable* table) {
+    if (spill == NULL || table->size == 0) return 0;
+
+    WordNode** nodes;
+    int count;
+    hash_table_to_array(table, &nodes, &count);
+    if (nodes == NULL) return 0;
+    qsort(nodes, count, sizeof(WordNode*), compare_nodes_by_word);
+
+    char* path = new_run_path();
+    FILE* file = path ? open_run(path, "wb") : NULL;
+    int ok = (file != NULL);
+    for (int i = 0; i < count && ok; i++) {
+        write_record(file, nodes[i]->word, nodes[i]->frequency);
+    }
+    if (file != NULL) {
+        if (ferror(file)) ok = 0;
+        if (fclose(file) != 0) ok = 0;
+    }
+    free(nodes);
+
+    RunList runs = {spill->runs, spill->run_count, spill->run_capacity};
+    if (ok) ok = run_list_add(&runs, path);
+    if (!ok) {
+        // keep counting in memory, try again once the table is twice as big
+        log_message(LOG_LEVEL_ERROR, "Error: Cannot write word spill file in %s, keeping words in memory\n",
+                    spill_directory());
+        if (path != NULL) remove(path);
+        free(path);
+        spill->max_words *= 2;
+        return 0;
+    }
+    hash_table_free(table);
+    if (runs.count >= WORD_SPILL_MAX_RUNS) {
+        compact_runs(&runs, compare_by_word, 1);
+    }
+    spill->runs = runs.paths;
+    spill->run_count = runs.count;
+    spill->run_capacity = runs.capacity;
+    return 1;
+}
+
+long long word_spill_each(WordSpill* spill, WordCallback callback, void* data) {
+    return merge_runs(spill->runs, spill->run_count, compare_by_word, 1, callback, data);
+}
+
+//  FINISHING
+
+static int top_before(const TopWords* top, int a, int b) {
+    // min-heap on rank: the root is the word that would be dropped first
+    return compare_by_rank(&top->heap[a], &top->heap[b]) > 0;
+}
+
+static void top_sift_down(TopWords* top, int i) {
+    while (1) {
+        int worst = i;
+        int left = 2 * i + 1;
+        int right = left + 1;
+        if (left < top->count && top_before(top, left, worst)) worst = left;
+        if (right < top->count && top_before(top, right, worst)) worst = right;
+        if (worst == i) return;
+        WordRecord temp = top->heap[i];
+        top->heap[i] = top->heap[worst];
+        top->heap[worst] = temp;
+        i = worst;
+    }
+}
+
+static void top_sift_up(TopWords* top, int i) {
+    while (i > 0 && top_before(top, i, (i - 1) / 2)) {
+        WordRecord temp = top->heap[i];
+        top->heap[i] = top->heap[(i - 1) / 2];
+        top->heap[(i - 1) / 2] = temp;
+        i = (i - 1) / 2;
+    }
+}
+
+static void keep_top_word(const char* word, int frequency, void* data) {
+    TopWords* top = (TopWords*)data;
+    WordRecord record;
+    strncpy(record.word, word, MAX_WORD_LEN - 1);
+    record.word[MAX_WORD_LEN - 1] = '\0';
+    record.frequency = frequency;
+    top->vocabulary++;
+    top->occurrences += frequency;
+
+    if (top->count < top->capacity) {
+        top->heap[top->count++] = record;
+        top_sift_up(top, top->count - 1);
+    } else if (top->capacity > 0 && compare_by_rank(&record, &top->heap[0]) < 0) {
+        top->heap[0] = record;
+        top_sift_down(top, 0);
+    }
+}
+
+static void add_to_table(const char* word, int frequency, void* data) {
+    hash_table_add((HashTable*)data, word, frequency);
+}
+
+long long word_spill_finish(WordSpill* spill, HashTable* table, int keep) {
+    if (spill->finished) return spill->vocabulary;
+
+    word_spill_flush(spill, table);
+    if (table->size > 0) {
+        // the last run could not be written: count everything in memory instead
+        word_spill_each(spill, add_to_table, table);
+        RunList runs = {spill->runs, spill->run_count, spill->run_capacity};
+        run_list_clear(&runs);
+        spill->runs = NULL;
+        spill->run_count = 0;
+        spill->run_capacity = 0;
+        return -1;
+    }
+
+    TopWords top = {0};
+    top.heap = (WordRecord*)malloc((keep > 0 ? keep : 1) * sizeof(WordRecord));
+    top.capacity = (top.heap != NULL) ? keep : 0;
+    word_spill_each(spill, keep_top_word, &top);
+    for (int i = 0; i < top.count; i++) {
+        hash_table_add(table, top.heap[i].word, top.heap[i].frequency);
+    }
+    free(top.heap);
+
+    spill->vocabulary = top.vocabulary;
+    spill->occurrences = top.occurrences;
+    spill->finished = 1;
+    return spill->vocabulary;
+}
+
+//  RANKING
+
+static void flush_ranked_records(RankSorter* sorter) {
+    qsort(sorter->records, sorter->count, sizeof(WordRecord), compare_records_by_rank);
+    char* path = new_run_path();
+    FILE* file = path ? open_run(path, "wb") : NULL;
+    int ok = (file != NULL);
+    for (int i = 0; i < sorter->count && ok; i++) {
+        write_record(file, sorter->records[i].word, sorter->records[i].frequency);
+    }
+    if (file != NULL) {
+        if (ferror(file)) ok = 0;
+        if (fclose(file) != 0) ok = 0;
+    }
+    if (!ok || !run_list_add(&sorter->runs, path)) {
+        if (path != NULL) remove(path);
+        free(path);
+        sorter->failed = 1;
+    } else if (sorter->runs.count >= WORD_SPILL_MAX_RUNS) {
+        compact_runs(&sorter->runs, compare_by_rank, 0);
+    }
+    sorter->count = 0;
+}
+
+static void collect_ranked_record(const char* word, int frequency, void* data) {
+    RankSorter* sorter = (RankSorter*)data;
+    if (sorter->failed) return;
+    if (sorter->count == sorter->capacity) {
+        flush_ranked_records(sorter);
+    }
+    WordRecord* record = &sorter->records[sorter->count++];
+    strncpy(record->word, word, MAX_WORD_LEN - 1);
+    record->word[MAX_WORD_LEN - 1] = '\0';
+    record->frequency = frequency;
+}
+
+long long word_spill_each_ranked(WordSpill* spill, WordCallback callback, void* data) {
+    RankSorter sorter = {0};
+    sorter.spill = spill;
+    sorter.capacity = (int)spill->max_words;
+    sorter.records = (WordRecord*)malloc(sorter.capacity * sizeof(WordRecord));
+    if (sorter.records == NULL) return -1;
+
+    long long words = word_spill_each(spill, collect_ranked_record, &sorter);
+    if (words >= 0 && !sorter.failed) {
+        if (sorter.runs.count == 0) {
+            // the whole vocabulary fit in one buffer
+            qsort(sorter.records, sorter.count, sizeof(WordRecord), compare_records_by_rank);
+            for (int i = 0; i < sorter.count; i++) {
+                callback(sorter.records[i].word, sorter.records[i].frequency, data);
+            }
+        } else {
+            if (sorter.count > 0) flush_ranked_records(&sorter);
+            if (!sorter.failed) {
+                words = merge_runs(sorter.runs.paths, sorter.runs.count, compare_by_rank, 0, callback, data);
+            }
+        }
+    }
+    if (sorter.failed) {
+        log_message(LOG_LEVEL_ERROR, "Error: Cannot write word spill file in %s\n", spill_directory());
+        words = -1;
+    }
+    run_list_clear(&sorter.runs);
+    free(sorter.records);
+    return words;
+}
@@ -0,0 +1,49 @@
+#ifndef SPILL_H
+#define SPILL_H
+
+#include "content.h"
+
+#define WORD_SPILL_NODE_BYTES 80    // WordNode plus allocator overhead, for the budget
+#define WORD_SPILL_KEEP 1000        // ranked words kept in memory after a spill
+#define WORD_SPILL_MAX_RUNS 64      // runs are merged into one before more files are opened
+#define WORD_SPILL_BUFFER (256 * 1024)
+
+typedef void (*WordCallback)(const char* word, int frequency, void* data);
+
+// Word counts that did not fit in the memory budget. Every time the word
+// table reaches max_words it is written to disk as a run sorted by word and
+// emptied. The runs are merged when the result is finalized, so frequencies
+// stay exact whatever the vocabulary size
+typedef struct WordSpill {
+    long long max_words;
+    char** runs;                // run file paths, sorted by word
+    int run_count;
+    int run_capacity;
+    int finished;
+    long long vocabulary;       // distinct words over all runs, once finished
+    long long occurrences;      // sum of all frequencies, once finished
+} WordSpill;
+
+// Budget for one analysis's word table in bytes, 0 keeps everything in memory
+void set_word_memory_limit(long long bytes);
+long long get_word_memory_limit(void);
+
+// NULL when no limit is set
+WordSpill* word_spill_create(void);
+void word_spill_free(WordSpill* spill);
+
+// Write the table as a sorted run and empty it. On a write error the words
+// stay in memory. Returns 1 if a run was written
+int word_spill_flush(WordSpill* spill, HashTable* table);
+
+// Merge the runs and what is left in the table. The table keeps the top keep
+// words; returns the number of distinct words
+long long word_spill_finish(WordSpill* spill, HashTable* table, int keep);
+
+// Every word with its exact frequency, in word order or in rank order
+// (frequency, then word). Ranking a vocabulary bigger than the budget is an
+// external sort through more runs. Return the number of words, -1 on error
+long long word_spill_each(WordSpill* spill, WordCallback callback, void* data);
+long long word_spill_each_ranked(WordSpill* spill, WordCallback callback, void* data);
+
+#endif
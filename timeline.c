@@ -0,0 +1,103 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "timeline.h"
+#include "error.h"
+
+void timeline_init(Timeline* timeline, TimelineUnit unit, int size) {
+    memset(timeline, 0, sizeof(Timeline));
+    timeline->unit = unit;
+    timeline->size = (size > 0) ? size : 1;
+    timeline->current.first_line = 1;
+    timeline->peak = -1;
+}
+
+void timeline_free(Timeline* timeline) {
+    free(timeline->windows);
+    timeline->windows = NULL;
+    timeline->count = 0;
+    timeline->capacity = 0;
+}
+
+int timeline_window_score(const TimelineWindow* window) {
+    int phrases = 0;
+    for (int i = 0; i < MAX_SEVERITY_LEVELS; i++) {
+        phrases += window->hits[i];
+    }
+    return score_toxicity_counts(window->words, phrases, window->hits);
+}
+
+static void close_window(Timeline* timeline) {
+    if (timeline->current.lines == 0) return;
+
+    if (timeline->count == timeline->capacity) {
+        int capacity = (timeline->capacity > 0) ? timeline->capacity * 2 : 256;
+        TimelineWindow* grown = (TimelineWindow*)realloc(timeline->windows, capacity * sizeof(TimelineWindow));
+        if (grown == NULL) {
+            timeline->failed = 1;
+            return;
+        }
+        timeline->windows = grown;
+        timeline->capacity = capacity;
+    }
+
+    int score = timeline_window_score(&timeline->current);
+    if (timeline->peak < 0 || score > timeline->peak_score) {
+        timeline->peak = timeline->count;
+        timeline->peak_score = score;
+    }
+    timeline->windows[timeline->count++] = timeline->current;
+
+    memset(&timeline->current, 0, sizeof(TimelineWindow));
+    timeline->current.first_line = timeline->line_number + 1;
+}
+
+// on_line hook: add the finished line to the open window
+static void timeline_line(AnalysisStream* stream, void* data) {
+    Timeline* timeline = (Timeline*)data;
+    TimelineWindow* window = &timeline->current;
+
+    timeline->line_number++;
+    window->lines++;
+    window->words += stream->line_words;
+    for (int i = 0; i < MAX_SEVERITY_LEVELS; i++) {
+        window->hits[i] += stream->line_severity[i];
+    }
+
+    int filled = (timeline->unit == TIMELINE_LINES) ? window->lines : window->words;
+    if (filled >= timeline->size) {
+        close_window(timeline);
+    }
+}
+
+void timeline_attach(Timeline* timeline, AnalysisStream* stream) {
+    stream->on_line = timeline_line;
+    stream->callback_data = timeline;
+}
+
+void timeline_finish(Timeline* timeline) {
+    close_window(timeline);
+}
+
+int save_timeline_csv(const char* filename, const Timeline* timeline, int threshold) {
+    FILE* file = fopen(filename, "w");
+    if (file == NULL) {
+        log_message(LOG_LEVEL_ERROR, "Error: Cannot create timeline file %s\n", filename);
+        return 0;
+    }
+
+    fprintf(file, "Window,First Line,Last Line,Words,Mild,Moderate,Severe,Density,Score,Hot\n");
+    for (int i = 0; i < timeline->count; i++) {
+        const TimelineWindow* window = &timeline->windows[i];
+        int phrases = window->hits[SEVERITY_MILD] + window->hits[SEVERITY_MODERATE] + window->hits[SEVERITY_SEVERE];
+        double density = (window->words > 0) ? (double)phrases / window->words * 100 : 0.0;
+        int score = timeline_window_score(window);
+        fprintf(file, "%d,%lld,%lld,%d,%d,%d,%d,%.2f%%,%d,%s\n",
+                i + 1, window->first_line, window->first_line + window->lines - 1, window->words,
+                window->hits[SEVERITY_MILD], window->hits[SEVERITY_MODERATE], window->hits[SEVERITY_SEVERE],
+                density, score, (score >= threshold) ? "yes" : "no");
+    }
+    fclose(file);
+    log_message(LOG_LEVEL_INFO, " Timeline saved to: %s\n", filename);
+    return 1;
+}
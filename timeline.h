@@ -0,0 +1,51 @@
+#ifndef TIMELINE_H
+#define TIMELINE_H
+
+#include "content.h"
+
+#define TIMELINE_DEFAULT_THRESHOLD 50   // windows scoring this much are hot spots
+
+typedef enum {
+    TIMELINE_LINES,     // a window is N lines
+    TIMELINE_WORDS      // a window ends at the first line end after N words
+} TimelineUnit;
+
+// counts of one window, the score is worked out from them when needed
+typedef struct {
+    long long first_line;
+    int lines;
+    int words;
+    int hits[MAX_SEVERITY_LEVELS];   // phrase matches per severity
+} TimelineWindow;
+
+// Toxicity per window over the whole text, filled by the stream's on_line
+// hook in the same pass as detection. Only the open window is updated per
+// line, closed windows are appended as they end
+typedef struct {
+    TimelineUnit unit;
+    int size;
+    TimelineWindow* windows;
+    int count;
+    int capacity;
+    TimelineWindow current;
+    long long line_number;
+    int peak;                   // highest scoring window, -1 before the first
+    int peak_score;
+    int failed;
+} Timeline;
+
+void timeline_init(Timeline* timeline, TimelineUnit unit, int size);
+void timeline_free(Timeline* timeline);
+
+// Hook the timeline to a stream before anything is fed
+void timeline_attach(Timeline* timeline, AnalysisStream* stream);
+
+// Close the last, partly filled window once the stream is finished
+void timeline_finish(Timeline* timeline);
+
+int timeline_window_score(const TimelineWindow* window);
+
+// One row per window, hot marks windows scoring at least threshold
+int save_timeline_csv(const char* filename, const Timeline* timeline, int threshold);
+
+#endif
@@ -2,7 +2,17 @@
 #include <string.h>
 #include <ctype.h>
 #include <stdlib.h>
+#include <time.h>
 #include "tool.h"
+#include "error.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 #define MAX_WORD_LEN 50
 
@@ -40,7 +50,7 @@ void safe_strcat(char** dest, const char* src) {
     
     char* new_dest = realloc(*dest, dest_len + src_len + 1);
     if (new_dest == NULL) {
-        printf(" Error: Memory reallocation failed in safe_strcat\n");
+        log_message(LOG_LEVEL_ERROR, " Error: Memory reallocation failed in safe_strcat\n");
         return;
     }
     
@@ -54,6 +64,27 @@ const char* get_file_extension(const char* filename) {
     return (dot == NULL) ? "" : dot;
 }
 
+// Reentrant strtok: returns the next non-empty token and advances *rest,
+// so worker threads can split lines at the same time
+char* next_token(char** rest, const char* delimiter) {
+    char* start = *rest;
+    if (start == NULL) return NULL;
+    
+    start += strspn(start, delimiter);
+    if (*start == '\0') {
+        *rest = NULL;
+        return NULL;
+    }
+    char* end = start + strcspn(start, delimiter);
+    if (*end != '\0') {
+        *end = '\0';
+        *rest = end + 1;
+    } else {
+        *rest = NULL;
+    }
+    return start;
+}
+
 // Split string by delimiter
 char** split_string(const char* str, const char* delimiter, int* count) {
     if (str == NULL || delimiter == NULL) {
@@ -66,10 +97,9 @@ char** split_string(const char* str, const char* delimiter, int* count) {
     if (str_copy == NULL) return NULL;
     
     int token_count = 0;
-    char* token = strtok(str_copy, delimiter);
-    while (token != NULL) {
+    char* rest = str_copy;
+    while (next_token(&rest, delimiter) != NULL) {
         token_count++;
-        token = strtok(NULL, delimiter);
     }
     free(str_copy);
     
@@ -84,11 +114,11 @@ char** split_string(const char* str, const char* delimiter, int* count) {
     
     str_copy = strdup(str);
     token_count = 0;
-    token = strtok(str_copy, delimiter);
-    while (token != NULL) {
+    rest = str_copy;
+    char* token;
+    while ((token = next_token(&rest, delimiter)) != NULL) {
         result[token_count] = strdup(token);
         token_count++;
-        token = strtok(NULL, delimiter);
     }
     free(str_copy);
     
@@ -104,4 +134,122 @@ void free_split_string(char** array, int count) {
         free(array[i]);
     }
     free(array);
-}
\ No newline at end of file
+}
+
+// Create a directory, returns 1 if it exists afterwards
+int make_directory(const char* path) {
+#ifdef _WIN32
+    _mkdir(path);
+    DWORD attributes = GetFileAttributesA(path);
+    return attributes != INVALID_FILE_ATTRIBUTES && (attributes & FILE_ATTRIBUTE_DIRECTORY);
+#else
+    mkdir(path, 0755);
+    struct stat info;
+    return stat(path, &info) == 0 && S_ISDIR(info.st_mode);
+#endif
+}
+
+// Monotonic wall clock in milliseconds, for timing runs
+double get_time_ms(void) {
+#ifdef _WIN32
+    LARGE_INTEGER frequency, counter;
+    QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&counter);
+    return (double)counter.QuadPart * 1000.0 / frequency.QuadPart;
+#else
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000.0 + now.tv_nsec / 1000000.0;
+#endif
+}
+
+// Number of online processors, at least 1
+int get_cpu_count(void) {
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    int count = (int)info.dwNumberOfProcessors;
+#else
+    int count = (int)sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+    return (count > 0) ? count : 1;
+}
+
+// Current time as text with a newline like ctime, but safe to call from threads
+void format_timestamp(char* buffer, int size) {
+    time_t now = time(NULL);
+    struct tm local;
+#ifdef _WIN32
+    localtime_s(&local, &now);
+#else
+    localtime_r(&now, &local);
+#endif
+    strftime(buffer, size, "%a %b %d %H:%M:%S %Y\n", &local);
+}
+// STRING INDEX
+
+// Same hash as the word table, kept unreduced so it can be extended a char at a time
+unsigned int hash_string(const char* str, int len) {
+    unsigned int hash = 0;
+    for (int i = 0; i < len; i++) {
+        hash = hash * 31 + (unsigned char)str[i];
+    }
+    return hash;
+}
+
+static int string_index_grow(StringIndex* index, char** keys, int count) {
+    int capacity = (index->capacity == 0) ? 1024 : index->capacity * 2;
+    int* slots = malloc(capacity * sizeof(int));
+    if (slots == NULL) {
+        return 0;
+    }
+    for (int i = 0; i < capacity; i++) {
+        slots[i] = -1;
+    }
+    for (int i = 0; i < count; i++) {
+        unsigned int slot = hash_string(keys[i], strlen(keys[i])) & (capacity - 1);
+        while (slots[slot] >= 0) {
+            slot = (slot + 1) & (capacity - 1);
+        }
+        slots[slot] = i;
+    }
+    free(index->slots);
+    index->slots = slots;
+    index->capacity = capacity;
+    return 1;
+}
+
+// Find the key of length len with a precomputed hash_string, -1 if absent
+int string_index_find(const StringIndex* index, char** keys, const char* key, int len, unsigned int hash) {
+    if (index->capacity == 0) {
+        return -1;
+    }
+    unsigned int slot = hash & (index->capacity - 1);
+    while (index->slots[slot] >= 0) {
+        const char* candidate = keys[index->slots[slot]];
+        if (strncmp(candidate, key, len) == 0 && candidate[len] == '\0') {
+            return index->slots[slot];
+        }
+        slot = (slot + 1) & (index->capacity - 1);
+    }
+    return -1;
+}
+
+// Index keys[count], the keys before it must already be indexed
+int string_index_add(StringIndex* index, char** keys, int count) {
+    if ((count + 1) * 2 > index->capacity && !string_index_grow(index, keys, count)) {
+        return 0;
+    }
+    unsigned int slot = hash_string(keys[count], strlen(keys[count])) & (index->capacity - 1);
+    while (index->slots[slot] >= 0) {
+        slot = (slot + 1) & (index->capacity - 1);
+    }
+    index->slots[slot] = count;
+    return 1;
+}
+
+void string_index_free(StringIndex* index) {
+    free(index->slots);
+    index->slots = NULL;
+    index->capacity = 0;
+}
@@ -15,7 +15,25 @@ void safe_strcat(char** dest, const char* src);
 
 
 const char* get_file_extension(const char* filename);
+char* next_token(char** rest, const char* delimiter);
 char** split_string(const char* str, const char* delimiter, int* count);
 void free_split_string(char** array, int count);
 
+
+int make_directory(const char* path);
+double get_time_ms(void);
+int get_cpu_count(void);
+void format_timestamp(char* buffer, int size);
+
+// open addressing index over an array of strings, slots hold array positions
+typedef struct {
+    int* slots;         // -1 = empty
+    int capacity;       // power of two
+} StringIndex;
+
+unsigned int hash_string(const char* str, int len);
+int string_index_find(const StringIndex* index, char** keys, const char* key, int len, unsigned int hash);
+int string_index_add(StringIndex* index, char** keys, int count);
+void string_index_free(StringIndex* index);
+
 #endif
\ No newline at end of file